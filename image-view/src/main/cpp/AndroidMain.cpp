@@ -17,6 +17,8 @@
 
 #include <android/sensor.h>
 #include <android_native_app_glue.h>
+#include <algorithm>
+#include <mutex>
 #include "ImageViewEngine.h"
 #include "ColorSpace.h"
 #include "math/mat4.h"
@@ -38,8 +40,9 @@ static void engine_handle_cmd(struct android_app* app, int32_t cmd) {
       }
       break;
     case APP_CMD_TERM_WINDOW:
-      // The window is being hidden or closed, clean it up.
-      engine->TerminateDisplay();
+      // The window is being hidden or closed: keep the GL context and
+      // objects around for the next APP_CMD_INIT_WINDOW.
+      engine->ReleaseWindow();
       break;
     case APP_CMD_GAINED_FOCUS:
       // When our app gains focus, we start monitoring the accelerometer.
@@ -64,7 +67,94 @@ static void engine_handle_cmd(struct android_app* app, int32_t cmd) {
       engine->EnableAnimation(false);
       engine->DrawFrame();
       break;
+    case APP_CMD_LOW_MEMORY:
+      // The system is short of memory: keep only what the screen shows.
+      engine->ReleaseMemory(PRESSURE_SOURCES);
+      break;
+  }
+}
+
+/*
+ * ComponentCallbacks2.onTrimMemory() levels, forwarded by WideColorActivity
+ */
+enum TRIM_MEMORY_LEVEL {
+  TRIM_MEMORY_RUNNING_MODERATE = 5,
+  TRIM_MEMORY_RUNNING_LOW = 10,
+  TRIM_MEMORY_RUNNING_CRITICAL = 15,
+  TRIM_MEMORY_UI_HIDDEN = 20,
+  TRIM_MEMORY_BACKGROUND = 40,
+  TRIM_MEMORY_MODERATE = 60,
+  TRIM_MEMORY_COMPLETE = 80,
+};
+
+/*
+ * TrimMemoryPressure()
+ *    Running levels follow how short the system is while we are in front;
+ *    once in the background the cached process is next to go, so what
+ *    cannot be seen goes first and the sources with it when it gets worse.
+ */
+static MEMORY_PRESSURE TrimMemoryPressure(int level) {
+  if (level >= TRIM_MEMORY_MODERATE) {
+    return PRESSURE_SOURCES;
+  }
+  if (level >= TRIM_MEMORY_UI_HIDDEN) {
+    return PRESSURE_OFFSCREEN;
+  }
+  if (level >= TRIM_MEMORY_RUNNING_CRITICAL) {
+    return PRESSURE_SOURCES;
+  }
+  if (level >= TRIM_MEMORY_RUNNING_LOW) {
+    return PRESSURE_OFFSCREEN;
+  }
+  return PRESSURE_PREFETCH;
+}
+
+/*
+ * onTrimMemory() comes on the UI thread: the strongest level since the
+ * last frame is kept for the app thread, woken up to apply it.
+ */
+static std::mutex trimLock;
+static ALooper* trimLooper = NULL;
+static int trimPressure = -1;
+
+static void nativeTrimMemory(JNIEnv*, jobject, jint level) {
+  std::lock_guard<std::mutex> guard(trimLock);
+  if (trimLooper == NULL) {
+    return;
+  }
+  trimPressure = std::max(trimPressure,
+                          static_cast<int>(TrimMemoryPressure(level)));
+  ALooper_wake(trimLooper);
+}
+
+static void RegisterTrimMemory(struct android_app* app) {
+  JNIEnv* jni;
+  app->activity->vm->AttachCurrentThread(&jni, NULL);
+  JNINativeMethod method = {
+      "nativeTrimMemory", "(I)V", reinterpret_cast<void*>(nativeTrimMemory)
+  };
+  jclass clazz = jni->GetObjectClass(app->activity->clazz);
+  if (jni->RegisterNatives(clazz, &method, 1) != JNI_OK) {
+    jni->ExceptionClear();
+    LOGW("onTrimMemory() is not forwarded");
   }
+  app->activity->vm->DetachCurrentThread();
+
+  std::lock_guard<std::mutex> guard(trimLock);
+  trimLooper = app->looper;
+  trimPressure = -1;
+}
+
+static void UnregisterTrimMemory(void) {
+  std::lock_guard<std::mutex> guard(trimLock);
+  trimLooper = NULL;
+}
+
+static int TakeTrimPressure(void) {
+  std::lock_guard<std::mutex> guard(trimLock);
+  int pressure = trimPressure;
+  trimPressure = -1;
+  return pressure;
 }
 
 /*
@@ -102,6 +192,7 @@ void android_main(struct android_app* state) {
                                     engine.sensorManager,
                                     state->looper, LOOPER_ID_USER,
                                     NULL, NULL);
+    RegisterTrimMemory(state);
 
     while (1) {
         // Read all pending events.
@@ -130,11 +221,17 @@ void android_main(struct android_app* state) {
             }
             // Check if we are exiting.
             if (state->destroyRequested != 0) {
+                UnregisterTrimMemory();
                 engine.TerminateDisplay();
                 return;
             }
         }
 
+        int pressure = TakeTrimPressure();
+        if (pressure >= 0) {
+            engine.ReleaseMemory(static_cast<MEMORY_PRESSURE>(pressure));
+        }
+
         if (engine.GetAnimationStatus()) {
             engine.DrawFrame();
         }
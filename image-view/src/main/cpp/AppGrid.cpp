@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include "ImageViewEngine.h"
+
+/*
+ * ShowGrid()
+ *    The grid opens with the image shown in its middle row. Leaving it
+ *    drops the thumbnails still queued; the atlas stays for next time.
+ */
+void ImageViewEngine::ShowGrid(bool enable) {
+  if (enable == gridMode_ || textures_.empty()) {
+    return;
+  }
+  gridMode_ = enable;
+  gridVelocity_ = 0.0f;
+  gridDragging_ = false;
+  gridFrameTime_ = std::chrono::steady_clock::now();
+  if (enable) {
+    float cell = GridCellSize();
+    uint32_t row = textureIdx_ / GridColumns();
+    gridScroll_ = row * cell - (renderTargetHeight_ - cell) * 0.5f;
+    ClampGridScroll();
+    return;
+  }
+  loader_->CancelQueued([](const TEXTURE_JOB&) { return true; },
+                        TEXTURE_STAGE::THUMBNAIL);
+  thumbnails_.StopLoading([](uint32_t) { return true; });
+  gridFrom_ = gridTo_ = 0;
+  UpdateUI();
+}
+
+/*
+ * GridColumns()
+ *    Square cells of about kGridCellPixels across the window
+ */
+uint32_t ImageViewEngine::GridColumns(void) {
+  return std::max(kGridMinColumns, static_cast<uint32_t>(
+      std::max(renderTargetWidth_, 0) / kGridCellPixels));
+}
+
+float ImageViewEngine::GridCellSize(void) {
+  return static_cast<float>(std::max(renderTargetWidth_, 1)) / GridColumns();
+}
+
+// the last row stops at the bottom of the window; a fling stops there too
+void ImageViewEngine::ClampGridScroll(void) {
+  uint32_t columns = GridColumns();
+  uint32_t rows = (static_cast<uint32_t>(textures_.size()) + columns - 1) /
+                  columns;
+  float end = std::max(0.0f, rows * GridCellSize() - renderTargetHeight_);
+  if (gridScroll_ < 0.0f || gridScroll_ > end) {
+    gridScroll_ = std::min(std::max(gridScroll_, 0.0f), end);
+    gridVelocity_ = 0.0f;
+  }
+}
+
+/*
+ * DrawGrid()
+ *    Advances the fling (exponential decay), asks for the thumbnails
+ *    around the rows in view, then draws every visible cell with a
+ *    thumbnail in one glDrawArraysInstanced(): a GRID_CELL per instance
+ *    streamed into gridBuffer_, no per vertex data. The cost per frame
+ *    is that of the rows in view, whatever the number of images.
+ */
+void ImageViewEngine::DrawGrid(void) {
+  if (textures_.empty() || renderTargetWidth_ <= 0 || renderTargetHeight_ <= 0) {
+    return;
+  }
+  if (thumbnails_.Space() != dispColorSpace_ &&
+      !thumbnails_.Create(dispColorSpace_)) {
+    return;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  float elapsed = std::min(50.0f, std::chrono::duration<float, std::milli>(
+      now - gridFrameTime_).count());
+  gridFrameTime_ = now;
+  if (!gridDragging_ && gridVelocity_ != 0.0f) {
+    gridScroll_ += gridVelocity_ * elapsed;
+    gridVelocity_ *= std::exp(-elapsed / kGridFlingDecayMs);
+    if (std::abs(gridVelocity_) < 0.01f) {
+      gridVelocity_ = 0.0f;
+    }
+    ClampGridScroll();
+  }
+
+  uint32_t count = static_cast<uint32_t>(textures_.size());
+  uint32_t columns = GridColumns();
+  float cell = GridCellSize();
+  uint32_t rows = (count + columns - 1) / columns;
+  uint32_t firstRow = static_cast<uint32_t>(std::max(0.0f, gridScroll_ / cell));
+  uint32_t lastRow = std::min(rows, static_cast<uint32_t>(
+      std::ceil((gridScroll_ + renderTargetHeight_) / cell)));
+  thumbnails_.BeginFrame();
+  RequestThumbnails(firstRow, lastRow);
+
+  const float W = static_cast<float>(renderTargetWidth_);
+  const float H = static_cast<float>(renderTargetHeight_);
+  gridCells_.clear();
+  for (uint32_t row = firstRow; row < lastRow; row++) {
+    for (uint32_t column = 0; column < columns; column++) {
+      uint32_t idx = row * columns + column;
+      GRID_CELL instance;
+      bool final;
+      if (idx >= count || !thumbnails_.Find(idx, instance.tex_, &final)) {
+        continue;
+      }
+      float left = column * cell + kGridGapPixels;
+      float top = row * cell - gridScroll_ + kGridGapPixels;
+      float right = (column + 1) * cell - kGridGapPixels;
+      float bottom = (row + 1) * cell - gridScroll_ - kGridGapPixels;
+      instance.screen_[0] = left / W * 2.0f - 1.0f;
+      instance.screen_[1] = 1.0f - top / H * 2.0f;
+      instance.screen_[2] = right / W * 2.0f - 1.0f;
+      instance.screen_[3] = 1.0f - bottom / H * 2.0f;
+      gridCells_.push_back(instance);
+    }
+  }
+  if (gridCells_.empty()) {
+    return;
+  }
+
+  if (!gridVao_) {
+    glGenVertexArrays(1, &gridVao_);
+    glGenBuffers(1, &gridBuffer_);
+    quads_.BindVertexArray(gridVao_);
+    glBindBuffer(GL_ARRAY_BUFFER, gridBuffer_);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GRID_CELL),
+                          reinterpret_cast<const void*>(
+                              offsetof(GRID_CELL, screen_)));
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GRID_CELL),
+                          reinterpret_cast<const void*>(
+                              offsetof(GRID_CELL, tex_)));
+    glVertexAttribDivisor(0, 1);
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+  } else {
+    quads_.BindVertexArray(gridVao_);
+    glBindBuffer(GL_ARRAY_BUFFER, gridBuffer_);
+  }
+  glBufferData(GL_ARRAY_BUFFER, gridCells_.size() * sizeof(GRID_CELL),
+               gridCells_.data(), GL_STREAM_DRAW);
+
+  quads_.UseProgram(gridProgram_.getProgram());
+  // atlas uploads unbind GL_TEXTURE_2D
+  glBindTexture(GL_TEXTURE_2D, thumbnails_.Texture());
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4,
+                        static_cast<GLsizei>(gridCells_.size()));
+}
+
+/*
+ * RequestThumbnails()
+ *    Images of rows firstRow .. lastRow - 1 and kGridPrefetchRows more
+ *    either way: a cell without a thumbnail gets the index thumbnail at
+ *    once, and a THUMBNAIL job unless one is on its way. Jobs go in front
+ *    of the loader queue, the rows in view first. When the range moves,
+ *    queued jobs of images that left it are dropped, so a fast scroll
+ *    does not leave a backlog behind it.
+ */
+void ImageViewEngine::RequestThumbnails(uint32_t firstRow, uint32_t lastRow) {
+  uint32_t count = static_cast<uint32_t>(textures_.size());
+  uint32_t columns = GridColumns();
+  uint32_t from = (firstRow - std::min(firstRow, kGridPrefetchRows)) * columns;
+  uint32_t to = std::min(count, (lastRow + kGridPrefetchRows) * columns);
+  if (from != gridFrom_ || to != gridTo_) {
+    auto outside = [from, to](uint32_t idx) {
+      return idx < from || idx >= to;
+    };
+    loader_->CancelQueued([&outside](const TEXTURE_JOB& job) {
+      return outside(job.index_);
+    }, TEXTURE_STAGE::THUMBNAIL);
+    thumbnails_.StopLoading(outside);
+    gridFrom_ = from;
+    gridTo_ = to;
+  }
+
+  const uint32_t S = IMAGE_RECORD::kThumbnailSize;
+  std::vector<uint8_t> standIn(S * S * 4);
+  std::vector<TEXTURE_JOB> visible, around;
+  for (uint32_t idx = from; idx < to; idx++) {
+    GLfloat rect[4];
+    bool final = false;
+    if (!thumbnails_.Find(idx, rect, &final)) {
+      auto record = imageIndex_.Find(textures_[idx]->Name());
+      if (record) {
+        AssetTexture::TransformPixels(record->thumbnail_.data(),
+                                      standIn.data(), S, S, dispColorSpace_);
+        thumbnails_.Upload(idx, S, standIn.data());
+      }
+    }
+    if (final || thumbnails_.IsLoading(idx)) {
+      continue;
+    }
+    TEXTURE_JOB job { idx, textures_[idx]->Name(), dispColorSpace_ };
+    job.stage_ = TEXTURE_STAGE::THUMBNAIL;
+    job.thumbnailSize_ = ThumbnailAtlas::kCellSize;
+    thumbnails_.Loading(idx, true);
+    bool inView = idx >= firstRow * columns && idx < lastRow * columns;
+    (inView ? visible : around).push_back(job);
+  }
+  // submitted last to first, they run in the order above
+  for (auto it = around.rbegin(); it != around.rend(); ++it) {
+    loader_->Submit(*it, true);
+  }
+  for (auto it = visible.rbegin(); it != visible.rend(); ++it) {
+    loader_->Submit(*it, true);
+  }
+}
+
+void ImageViewEngine::UploadThumbnail(TEXTURE_JOB& job) {
+  thumbnails_.Loading(job.index_, false);
+  if (job.preview_ && thumbnails_.Space() == job.space_) {
+    thumbnails_.Upload(job.index_, job.preview_->width_,
+                       job.preview_->pixels_.data());
+  }
+}
+
+void ImageViewEngine::DeleteGridGeometry(void) {
+  if (gridVao_) {
+    quads_.BindVertexArray(0);
+    glDeleteVertexArrays(1, &gridVao_);
+    glDeleteBuffers(1, &gridBuffer_);
+    gridVao_ = gridBuffer_ = 0;
+  }
+}
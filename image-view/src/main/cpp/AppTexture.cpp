@@ -14,18 +14,37 @@
  * limitations under the License.
  *
  */
+#include <algorithm>
 #include "AssetUtil.h"
 #include "ImageViewEngine.h"
+#include "ImageScaler.h"
 
 /*
  * DeleteTextures()
  *    Release all textures created in engine
  */
 void ImageViewEngine::DeleteTextures(void) {
+  // workers may still be filling mapped buffers: wait for them first
+  loader_->Cancel();
+  imageIndex_.Save();
+  decoded_.clear();
+  uploads_.Clear();
+  pboRing_.Reset();
+  textureCache_.Clear();
+  viewedIdx_ = UINT32_MAX;
+  prefetch_.clear();
+  prefetchDirection_ = 0;
   for (auto& tex : textures_) {
     delete tex;
   }
   textures_.resize(0);
+  imageSizes_.resize(0);
+  pyramids_.clear();
+  failed_.clear();
+  ReleaseTileCache();
+  thumbnails_.Reset();
+  gridFrom_ = gridTo_ = 0;
+  texturePool_.Reset();
 }
 
 /*
@@ -33,6 +52,11 @@ void ImageViewEngine::DeleteTextures(void) {
  *    Create 2 textures in current display_ color space ( P3 or sRGB)
  *    If it is P3 space, image is transformed through sRGB so colors
  *    outside sRGB gamut are removed.
+ *    Reading, decoding and transforming run on the texture loader threads,
+ *    starting with the visible image; UploadReadyTextures() uploads the
+ *    results from DrawFrame().
+ *    Image sizes come from the image index, from the PNG headers for
+ *    images it does not have (or has for an older version of the asset).
  */
 bool ImageViewEngine::CreateTextures(void) {
   std::vector<std::string> files;
@@ -43,13 +67,716 @@ bool ImageViewEngine::CreateTextures(void) {
   DeleteTextures();
 
   for(auto& f : files) {
-    AssetTexture* tex = new AssetTexture(f);
+    AssetTexture* tex = new AssetTexture(
+        f, static_cast<uint32_t>(textures_.size()), texturePool_);
     ASSERT(tex, "OUT OF MEMORY");
     tex->ColorSpace(dispColorSpace_);
-    bool status = tex->CreateGLTextures(app_->activity->assetManager);
-    ASSERT(status, "Failed to create Texture for %s", f.c_str());
     textures_.push_back(tex);
+    uint32_t width = 0, height = 0;
+    auto record = imageIndex_.Find(f);
+    if (record &&
+        record->assetSize_ == AssetFileSize(app_->activity->assetManager, f)) {
+      width = record->width_;
+      height = record->height_;
+    } else {
+      imageIndex_.Remove(f);
+      AssetImageSize(app_->activity->assetManager, f, &width, &height);
+    }
+    imageSizes_.push_back(std::make_pair(width, height));
   }
+  imageIndex_.Retain(files);
+  pyramids_.assign(textures_.size(), nullptr);
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize_);
+  // gray images get single channel textures (ChooseTexelLayout())
+  const char* extensions =
+      reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+  srgbR8_ = extensions &&
+            std::string(extensions).find("GL_EXT_texture_sRGB_R8") !=
+                std::string::npos;
+  PlanTextureArrays();
 
+  // Only the working set is loaded up front, the rest on demand
+  loadStart_ = std::chrono::steady_clock::now();
+  textureIdx_ = textureIdx_ % textures_.size();
+  RequestWorkingSet();
+  IndexImages();
   return true;
 }
+
+/*
+ * TextureLimits()
+ *    Size limits for decoding when textures are scaled: each image is shown
+ *    on one half of the window
+ */
+bool ImageViewEngine::TextureLimits(uint32_t* maxWidth, uint32_t* maxHeight) {
+  if (!scaleTextures_ || renderTargetWidth_ <= 1 || renderTargetHeight_ <= 0) {
+    return false;
+  }
+  *maxWidth = static_cast<uint32_t>(renderTargetWidth_ / 2);
+  *maxHeight = static_cast<uint32_t>(renderTargetHeight_);
+  return true;
+}
+
+/*
+ * PlanTextureArrays()
+ *    Predicts every texture's size from its PNG header and the current
+ *    scaling, so TextureArrayPool can put same sized images into shared
+ *    arrays before any of them is decoded. Tiled images have no array.
+ */
+void ImageViewEngine::PlanTextureArrays(void) {
+  uint32_t maxWidth = 0, maxHeight = 0;
+  TextureLimits(&maxWidth, &maxHeight);
+  std::vector<TEXTURE_LAYOUT> sizes(textures_.size(),
+                                    TEXTURE_LAYOUT { 0, 0, 0, 0 });
+  for (size_t idx = 0; idx < imageSizes_.size(); idx++) {
+    if (!imageSizes_[idx].first || IsTiled(idx)) {
+      continue;
+    }
+    TEXTURE_LAYOUT& size = sizes[idx];
+    SourceImageCache::ScaledSize(imageSizes_[idx].first, imageSizes_[idx].second,
+                                 maxWidth, maxHeight, &size.width_, &size.height_);
+    size.levels_ = scaleTextures_ ? MipLevelCount(size.width_, size.height_) : 1;
+  }
+  texturePool_.Plan(sizes);
+}
+
+/*
+ * InWorkingSet()
+ *    Images within kWorkingSetRadius of the visible one (wrapping around,
+ *    as swiping does) stay resident whatever the texture budget says.
+ */
+bool ImageViewEngine::InWorkingSet(uint32_t idx) {
+  uint32_t count = static_cast<uint32_t>(textures_.size());
+  uint32_t distance = (idx + count - textureIdx_) % count;
+  return std::min(distance, count - distance) <= kWorkingSetRadius;
+}
+
+/*
+ * RequestWorkingSet()
+ *    Queues the visible image (urgent) and its neighbours if they are not
+ *    resident yet.
+ */
+void ImageViewEngine::RequestWorkingSet(void) {
+  uint32_t count = static_cast<uint32_t>(textures_.size());
+  uint32_t current = textureIdx_;
+  UpdateTexture(current);
+  for (uint32_t offset = 1; offset <= kWorkingSetRadius; offset++) {
+    UpdateTexture((current + offset) % count, false);
+    UpdateTexture((current + count - offset) % count, false);
+  }
+}
+
+/*
+ * IndexImages()
+ *    INDEX jobs for the images the index does not have; the loader runs
+ *    them when it has nothing else to do
+ */
+void ImageViewEngine::IndexImages(void) {
+  uint32_t missing = 0;
+  for (uint32_t idx = 0; idx < textures_.size(); idx++) {
+    if (!imageIndex_.Find(textures_[idx]->Name())) {
+      TEXTURE_JOB job { idx, textures_[idx]->Name(), dispColorSpace_ };
+      job.stage_ = TEXTURE_STAGE::INDEX;
+      loader_->Submit(job);
+      missing++;
+    }
+  }
+  if (missing) {
+    LOGI("Image index: %zu images, indexing %u", imageIndex_.Count(), missing);
+  }
+}
+
+/*
+ * ShowThumbnail()
+ *    Uploads the image's index thumbnail right away (one small synchronous
+ *    upload, no loader round trip) as its preview, when it has nothing
+ *    else; a PREVIEW or the texture replaces it.
+ */
+bool ImageViewEngine::ShowThumbnail(uint32_t idx) {
+  AssetTexture* tex = textures_[idx];
+  std::shared_ptr<const IMAGE_RECORD> record = imageIndex_.Find(tex->Name());
+  if (!record || tex->IsValid() || uploads_.IsUploading(idx)) {
+    return false;
+  }
+  const uint32_t size = IMAGE_RECORD::kThumbnailSize;
+  std::vector<uint8_t> pixels(record->thumbnail_.size());
+  AssetTexture::TransformPixels(record->thumbnail_.data(), pixels.data(),
+                                size, size, dispColorSpace_);
+  if (!tex->BeginUpload(size, size, dispColorSpace_, 1, false, TEXEL_RGBA,
+                        true)) {
+    return false;
+  }
+  tex->UploadBand(0, 0, size, pixels.data());
+  tex->EndUpload();
+  textureCache_.Uploaded(idx, tex->GpuBytes());
+  return true;
+}
+
+/*
+ * PrefetchTextures()
+ *    Loads the next images in the swipe direction (+1: next, -1: previous)
+ *    ahead of time: kPrefetchDepth of them, more for fast swipes. When the
+ *    direction reverses, queued loads for the old direction are dropped so
+ *    they do not delay the new one; the image right next to the visible
+ *    one is moved to the front of the loader queue.
+ */
+void ImageViewEngine::PrefetchTextures(int32_t direction, float velocity) {
+  if (textures_.empty()) {
+    return;
+  }
+  int32_t count = static_cast<int32_t>(textures_.size());
+  uint32_t depth = kPrefetchDepth +
+      static_cast<uint32_t>(velocity / kFastSwipeVelocity);
+  depth = std::min(std::min(depth, kMaxPrefetchDepth),
+                   static_cast<uint32_t>(count - 1));
+  uint32_t current = textureIdx_;
+  if (direction == prefetchDirection_ && current == prefetchOrigin_ &&
+      depth <= prefetch_.size()) {
+    return;   // already on its way (move events come in bursts)
+  }
+
+  std::vector<uint32_t> targets;
+  for (int32_t offset = 1; offset <= static_cast<int32_t>(depth); offset++) {
+    targets.push_back(static_cast<uint32_t>(
+        ((static_cast<int32_t>(current) + offset * direction) % count + count) % count));
+  }
+  if (direction != prefetchDirection_) {
+    loader_->CancelQueued([this, &targets](const TEXTURE_JOB& job) {
+      return !InWorkingSet(job.index_) &&
+             std::find(targets.begin(), targets.end(), job.index_) == targets.end();
+    });
+  }
+  prefetch_ = targets;
+  prefetchDirection_ = direction;
+  prefetchOrigin_ = current;
+
+  for (size_t i = 0; i < targets.size(); i++) {
+    if (!UpdateTexture(targets[i], false) && i == 0 &&
+        textures_[current]->IsValid()) {
+      loader_->Promote(targets[i]);
+    }
+  }
+}
+
+/*
+ * TrimTextures()
+ *    Releases the least recently viewed textures above the GPU budget;
+ *    the working set and prefetched images stay.
+ */
+void ImageViewEngine::TrimTextures(void) {
+  auto evicted = textureCache_.Trim([this](uint32_t idx) {
+    return InWorkingSet(idx) ||
+           std::find(prefetch_.begin(), prefetch_.end(), idx) != prefetch_.end();
+  });
+  for (auto idx : evicted) {
+    CancelUploads(idx);
+    textures_[idx]->ReleaseGLTextures();
+  }
+  if (!evicted.empty()) {
+    TEXTURE_CACHE_STATS stats = textureCache_.Stats();
+    LOGI("Texture cache: evicted %zu, %u resident (%zu / %zu bytes), "
+         "hits %llu misses %llu evictions %llu, %u arrays (%zu bytes)",
+         evicted.size(), stats.residentCount_, stats.residentBytes_,
+         stats.budget_, static_cast<unsigned long long>(stats.hits_),
+         static_cast<unsigned long long>(stats.misses_),
+         static_cast<unsigned long long>(stats.evictions_),
+         texturePool_.ArrayCount(), texturePool_.AllocatedBytes());
+  }
+}
+
+TEXTURE_CACHE_STATS ImageViewEngine::GetTextureCacheStats(void) {
+  return textureCache_.Stats();
+}
+
+void ImageViewEngine::SetTextureBudget(size_t bytes) {
+  textureCache_.Budget(bytes);
+  TrimTextures();
+}
+
+/*
+ * ReleaseMemory()
+ *    Tiers, cheapest to rebuild first:
+ *      PRESSURE_PREFETCH:  loads and cache writes queued and textures
+ *                          prefetched beyond the working set, decoded
+ *                          images waiting for a PBO slot, and the idle PBO
+ *                          buffers
+ *      PRESSURE_OFFSCREEN: every texture, load and upload but the visible
+ *                          image's (neighbours and images viewed earlier
+ *                          included), the tile cache unless it is tiled,
+ *                          and the thumbnail atlas unless the grid is shown
+ *      PRESSURE_SOURCES:   the source image cache as well (images still in
+ *                          use by the loader go when it is done with them)
+ *    Nothing is reloaded here: the visible image keeps drawing, others
+ *    come back through UpdateTexture() when they are viewed (the working
+ *    set with the next image shown), prefetching restarts with the next
+ *    swipe and PBO buffers are allocated again by the next upload.
+ */
+size_t ImageViewEngine::ReleaseMemory(MEMORY_PRESSURE level) {
+  MEMORY_STATS before = GetMemoryStats();
+  if (display_ != EGL_NO_DISPLAY && !textures_.empty()) {
+    uint32_t visible = textureIdx_;
+    bool offscreen = (level >= PRESSURE_OFFSCREEN);
+    auto keep = [this, offscreen, visible](uint32_t idx) {
+      return idx == visible || (!offscreen && InWorkingSet(idx));
+    };
+    auto dropped = [&keep](const TEXTURE_JOB& job) {
+      return !keep(job.index_);
+    };
+    loader_->CancelQueued(dropped);
+    // queued cache writes hold their decoded image outside sourceImages_
+    loader_->CancelQueued(dropped, TEXTURE_STAGE::STORE);
+    for (auto it = decoded_.begin(); it != decoded_.end();) {
+      if (keep(it->job_.index_)) {
+        ++it;
+        continue;
+      }
+      loader_->Finished(it->job_.index_);
+      it = decoded_.erase(it);
+    }
+    // images viewed earlier only go with PRESSURE_OFFSCREEN
+    std::vector<uint32_t> targets = prefetch_;
+    if (offscreen) {
+      targets.resize(textures_.size());
+      for (uint32_t idx = 0; idx < targets.size(); idx++) {
+        targets[idx] = idx;
+      }
+    }
+    for (auto idx : targets) {
+      if (keep(idx)) {
+        continue;
+      }
+      CancelUploads(idx);
+      if (textures_[idx]->IsValid()) {
+        textures_[idx]->ReleaseGLTextures();
+        textureCache_.Removed(idx);
+      }
+    }
+    prefetch_.clear();
+    prefetchDirection_ = 0;
+    pboRing_.Trim();
+    if (offscreen && !IsTiled(visible)) {
+      ReleaseTileCache();
+    }
+    if (offscreen && !gridMode_) {
+      thumbnails_.Reset();
+    }
+  }
+  if (level >= PRESSURE_SOURCES) {
+    sourceImages_.Clear();
+  }
+
+  MEMORY_STATS after = GetMemoryStats();
+  size_t freed = (before.cpuLive_ + before.gpuLive_) -
+                 std::min(before.cpuLive_ + before.gpuLive_,
+                          after.cpuLive_ + after.gpuLive_);
+  LOGI("Memory pressure %d: %zu KB released, CPU %zu KB GPU %zu KB left",
+       level, freed / 1024, after.cpuLive_ / 1024, after.gpuLive_ / 1024);
+  return freed;
+}
+
+/*
+ * SetTextureScaling()
+ *    Drops all GPU textures so they come back with the new setting; the
+ *    source image cache decodes again for the changed limits.
+ */
+void ImageViewEngine::SetTextureScaling(bool enable) {
+  if (enable == scaleTextures_) {
+    return;
+  }
+  scaleTextures_ = enable;
+  loader_->Cancel();
+  decoded_.clear();
+  uploads_.Clear();
+  pboRing_.Reset();
+  ReleaseTileCache();   // tiles that were on their way are not anymore
+  thumbnails_.StopLoading([](uint32_t) { return true; });   // thumbnails too
+  gridFrom_ = gridTo_ = 0;
+  failed_.clear();   // the new limits may make them fit
+  textureCache_.Clear();
+  for (auto tex : textures_) {
+    tex->ReleaseGLTextures();
+  }
+  PlanTextureArrays();
+  if (!textures_.empty()) {
+    RequestWorkingSet();
+    IndexImages();   // dropped by Cancel()
+  }
+}
+
+/*
+ * UploadReadyTextures()
+ *    Moves textures through the loader stages, then lets the upload
+ *    scheduler run, so streaming textures in does not stall frames:
+ *      decoded: map a PboRing slot and let a worker fill it (FILL job);
+ *               with every slot in flight, wait in decoded_ for a later frame
+ *      filled:  upload from the unmapped slot; the GL driver copies from
+ *               the buffer asynchronously, the fence keeps the slot until then
+ *      cached:  pixels mapped from the PixelCache instead of decoded:
+ *               uploaded straight from the mapping
+ *      ETC2:    loaded from the disk cache instead of decoded, or encoded in
+ *               the background after the first upload: replaces the textures
+ *      tiled:   the pyramid is opened (DECODE) and tiles come in (TILE) as
+ *               RequestTiles() asks for them: see UploadTile()
+ *      preview: the small version of the visible image (PREVIEW), uploaded
+ *               unless the texture got there first; it replaces the index
+ *               thumbnail (ShowThumbnail())
+ *      grid:    thumbnails (THUMBNAIL) go into the atlas: UploadThumbnail()
+ *    Texture uploads go through uploads_ (StartUpload()), a band of rows at
+ *    a time under its per frame budget; FinishUpload() takes over when the
+ *    last band is in. Collecting results stops after kUploadBudgetMs.
+ *    Results for a stale color space or texture list are dropped;
+ *    UpdateTexture() asks for them again when needed. An image that failed
+ *    to load goes into failed_ instead, so that it is not loaded again
+ *    every frame.
+ */
+bool ImageViewEngine::IsStaleResult(const TEXTURE_RESULT& result) {
+  uint32_t idx = result.job_.index_;
+  return idx >= textures_.size() ||
+         textures_[idx]->Name() != result.job_.name_ ||
+         result.job_.space_ != dispColorSpace_;
+}
+
+bool ImageViewEngine::MapDecodedTexture(TEXTURE_RESULT& result) {
+  TEXTURE_JOB& job = result.job_;
+  job.levels_ = job.mipmaps_ ?
+      MipLevelCount(job.source_->width_, job.source_->height_) : 1;
+  size_t size = AssetTexture::StagingSize(job.source_->width_,
+                                          job.source_->height_, job.levels_,
+                                          job.layout_);
+  job.slot_ = pboRing_.Acquire(size, &job.dst_);
+  if (job.slot_ < 0) {
+    return false;
+  }
+  job.stage_ = TEXTURE_STAGE::FILL;
+  loader_->Submit(job, true);
+  return true;
+}
+
+void ImageViewEngine::UploadReadyTextures(void) {
+  while (!decoded_.empty()) {
+    if (IsStaleResult(decoded_.front())) {
+      loader_->Finished(decoded_.front().job_.index_);
+    } else if (!MapDecodedTexture(decoded_.front())) {
+      break;
+    }
+    decoded_.pop_front();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  TEXTURE_RESULT result;
+  while (loader_->PopReady(&result)) {
+    TEXTURE_JOB& job = result.job_;
+    uint32_t idx = job.index_;
+    bool stale = IsStaleResult(result);
+    if (stale || !result.status_) {
+      if (job.stage_ == TEXTURE_STAGE::FILL ||
+          job.stage_ == TEXTURE_STAGE::TILE) {
+        pboRing_.Abandon(job.slot_);
+      }
+      if (job.stage_ == TEXTURE_STAGE::TILE) {
+        tileCache_.Loading(idx, job.tile_, false);
+      } else if (job.stage_ == TEXTURE_STAGE::THUMBNAIL) {
+        // one that failed stays loading: not retried every frame
+        if (result.status_) {
+          thumbnails_.Loading(idx, false);
+        }
+      } else if (job.HoldsPending()) {
+        if (!stale && failed_.insert(idx).second) {
+          LOGE("Texture %s failed to load, not retried", job.name_.c_str());
+        }
+        loader_->Finished(idx);
+      }
+      continue;
+    }
+
+    switch (job.stage_) {
+      case TEXTURE_STAGE::DECODE:
+        if (job.pyramid_) {
+          pyramids_[idx] = job.pyramid_;
+          loader_->Finished(idx);
+          LOGI("Texture %s ready (tiled) %.1f ms after load start",
+               job.name_.c_str(), std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - loadStart_).count());
+          break;
+        }
+        if (job.pixels_) {
+          // cached pixels: uploaded right from the file mapping
+          const MAPPED_PIXELS& pixels = *job.pixels_;
+          StartUpload(job, pixels.width_, pixels.height_, pixels.levels_,
+                      false, pixels.layout_, pixels.data_);
+          break;
+        }
+        if (!job.compressed_) {
+          if (!decoded_.empty() || !MapDecodedTexture(result)) {
+            decoded_.push_back(std::move(result));
+          }
+          continue;
+        }
+        // from the disk cache: no decode, transform or encode this time
+        StartUpload(job, job.compressed_->width_, job.compressed_->height_,
+                    job.compressed_->levels_, true,
+                    job.compressed_->alpha_ ? TEXEL_RGBA : TEXEL_RGB,
+                    job.compressed_->data_.data());
+        break;
+      case TEXTURE_STAGE::FILL:
+        // bits are offsets into the slot's GL_PIXEL_UNPACK_BUFFER
+        StartUpload(job, job.source_->width_, job.source_->height_,
+                    job.levels_, false, job.layout_, nullptr);
+        break;
+      case TEXTURE_STAGE::STORE:
+        // swap in the compressed copy if the texture is still the same
+        if (!job.compressed_ ||
+            !textures_[idx]->IsValid() || textures_[idx]->IsCompressed() ||
+            textures_[idx]->IsPreview() ||
+            textures_[idx]->ColorSpace() != job.space_) {
+          continue;
+        }
+        StartUpload(job, job.compressed_->width_, job.compressed_->height_,
+                    job.compressed_->levels_, true,
+                    job.compressed_->alpha_ ? TEXEL_RGBA : TEXEL_RGB,
+                    job.compressed_->data_.data());
+        break;
+      case TEXTURE_STAGE::TILE:
+        UploadTile(job);
+        break;
+      case TEXTURE_STAGE::PREVIEW:
+        // only while the texture has nothing better (at most the index
+        // thumbnail), shown or on its way
+        if (!job.preview_ ||
+            (textures_[idx]->IsValid() && !textures_[idx]->IsPreview()) ||
+            uploads_.IsUploading(idx)) {
+          continue;
+        }
+        StartUpload(job, job.preview_->width_, job.preview_->height_, 1,
+                    false, TEXEL_RGBA, job.preview_->pixels_.data());
+        break;
+      case TEXTURE_STAGE::INDEX:
+        continue;   // kept by the loader, never a result
+      case TEXTURE_STAGE::THUMBNAIL:
+        UploadThumbnail(job);
+        break;
+    }
+
+    if (std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count() >
+        kUploadBudgetMs) {
+      break;
+    }
+  }
+
+  std::vector<TEXTURE_UPLOAD> done;
+  uploads_.Run(&done);
+  for (auto& upload : done) {
+    FinishUpload(upload);
+  }
+  TrimTextures();
+}
+
+/*
+ * StartUpload()
+ *    Hands the job's texture content to the upload scheduler; the texture
+ *    switches to it when the last band is in (FinishUpload())
+ */
+void ImageViewEngine::StartUpload(const TEXTURE_JOB& job, uint32_t width,
+                                  uint32_t height, uint32_t levels,
+                                  bool compressed, TEXEL_LAYOUT layout,
+                                  const uint8_t* bits) {
+  uint32_t idx = job.index_;
+  uploads_.Cancel(idx);
+  if (!textures_[idx]->BeginUpload(width, height, job.space_, levels,
+                                   compressed, layout,
+                                   job.stage_ == TEXTURE_STAGE::PREVIEW)) {
+    if (job.slot_ >= 0) {
+      pboRing_.Abandon(job.slot_);
+    }
+    if (job.HoldsPending()) {
+      loader_->Finished(idx);
+    }
+    return;
+  }
+  uploads_.Add(TEXTURE_UPLOAD { job, textures_[idx], bits, width, height,
+                                levels, compressed, layout });
+}
+
+/*
+ * FinishUpload()
+ *    After the last band: the texture is resident. A freshly filled one
+ *    gets its background STORE into the disk cache: ETC2 encoded when
+ *    compression is on, the pixels as they are otherwise.
+ */
+void ImageViewEngine::FinishUpload(TEXTURE_UPLOAD& upload) {
+  TEXTURE_JOB& job = upload.job_;
+  uint32_t idx = job.index_;
+  if (job.HoldsPending()) {
+    loader_->Finished(idx);
+  }
+  if (!upload.status_) {
+    LOGW("Reloading %s", job.name_.c_str());
+    return;
+  }
+  textureCache_.Uploaded(idx, textures_[idx]->GpuBytes());
+  if (job.stage_ == TEXTURE_STAGE::PREVIEW) {
+    return;   // drawn until the texture replaces it
+  }
+
+  if (job.stage_ == TEXTURE_STAGE::FILL) {
+    const SOURCE_IMAGE& source = *job.source_;
+    if (source.width_ != source.fullWidth_ ||
+        source.height_ != source.fullHeight_) {
+      // against the texture at full resolution without mipmaps
+      size_t fullBytes = static_cast<size_t>(source.fullWidth_) *
+                         source.fullHeight_ * 4;
+      LOGI("Texture %s: %ux%u shrunk to %ux%u with %u mip levels, "
+           "%zu KB of GPU memory saved", job.name_.c_str(),
+           source.fullWidth_, source.fullHeight_, source.width_,
+           source.height_, job.levels_,
+           (fullBytes - std::min(fullBytes, textures_[idx]->GpuBytes())) / 1024);
+    }
+    TEXTURE_JOB store = job;
+    store.stage_ = TEXTURE_STAGE::STORE;
+    store.slot_ = -1;
+    store.dst_ = nullptr;
+    loader_->Submit(store);
+  }
+
+  LOGI("Texture %s ready%s %.1f ms after load start, uploaded in %u frames",
+       job.name_.c_str(),
+       textures_[idx]->IsCompressed() ? " (ETC2)" :
+           (job.pixels_ ? " (cached pixels)" : ""),
+       std::chrono::duration<double, std::milli>(
+           std::chrono::steady_clock::now() - loadStart_).count(),
+       upload.frames_);
+}
+
+/*
+ * CancelUploads()
+ *    Drops the uploads of image idx; a load that was on its way is not
+ *    pending anymore, so UpdateTexture() asks for it again when needed
+ */
+void ImageViewEngine::CancelUploads(uint32_t idx) {
+  std::vector<TEXTURE_UPLOAD> dropped;
+  uploads_.Cancel(idx, &dropped);
+  for (auto& upload : dropped) {
+    if (upload.job_.HoldsPending()) {
+      loader_->Finished(idx);
+    }
+  }
+}
+
+/*
+ * MeasureLoadTimes()
+ *    Called every frame with what is drawn: times are from the frame the
+ *    image was landed on, to the first one drawing anything of it and to
+ *    the first one drawing its final texture
+ */
+void ImageViewEngine::MeasureLoadTimes(bool preview, bool final) {
+  if (loadTimes_.finalMs_ >= 0.0 || (!preview && !final)) {
+    return;
+  }
+  double ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - viewStart_).count();
+  if (loadTimes_.firstPixelMs_ < 0.0) {
+    loadTimes_.firstPixelMs_ = ms;
+    loadTimes_.preview_ = preview;
+  }
+  if (final) {
+    loadTimes_.finalMs_ = ms;
+    LOGI("Image %s: first pixels after %.1f ms%s, final after %.1f ms",
+         textures_[viewedIdx_]->Name().c_str(), loadTimes_.firstPixelMs_,
+         loadTimes_.preview_ ? " (preview)" : "", ms);
+  }
+}
+
+LOAD_TIMES ImageViewEngine::GetLoadTimes(void) {
+  return loadTimes_;
+}
+
+UPLOAD_STATS ImageViewEngine::GetUploadStats(void) {
+  return uploads_.Stats();
+}
+
+void ImageViewEngine::SetUploadBudget(size_t bytes) {
+  uploads_.FrameBudget(bytes);
+}
+
+MEMORY_STATS ImageViewEngine::GetMemoryStats(void) {
+  return MemoryTracker::Instance().Stats();
+}
+
+void ImageViewEngine::ShowMemoryOverlay(bool enable) {
+  memoryOverlay_ = enable;
+  if (enable) {
+    // shown right away, not a second later
+    memoryOverlayTime_ = std::chrono::steady_clock::time_point();
+    UpdateMemoryOverlay();
+  } else {
+    UpdateMemoryUI(nullptr);
+  }
+}
+
+/*
+ * UpdateMemoryOverlay()
+ *    At most every kMemoryOverlayIntervalMs: a JNI round trip per frame
+ *    would cost more than the numbers are worth. The same text goes to the
+ *    log.
+ */
+void ImageViewEngine::UpdateMemoryOverlay(void) {
+  auto now = std::chrono::steady_clock::now();
+  if (std::chrono::duration<double, std::milli>(now - memoryOverlayTime_)
+          .count() < kMemoryOverlayIntervalMs) {
+    return;
+  }
+  memoryOverlayTime_ = now;
+  std::string text = MemoryTracker::Format(GetMemoryStats());
+  LOGI("Memory: %s", text.c_str());
+  UpdateMemoryUI(&text);
+}
+
+/*
+ * SetTextureCompression()
+ *    Takes effect for textures loaded from now on; resident ones stay.
+ */
+void ImageViewEngine::SetTextureCompression(bool enable) {
+  compressTextures_ = enable;
+}
+
+/*
+ * UpdateTexture()
+ *    True when the texture is usable in the current display_ color space.
+ *    Otherwise (not loaded yet, evicted, or built for the space before a
+ *    SwitchDisplayColorSpace()) it is queued to the loader (in front when
+ *    urgent), unless already on its way or failed_. Decoded pixels come
+ *    from sourceImages_, so only the color transform and upload run again
+ *    after a switch.
+ *    A tiled image is usable once its pyramid is open; DrawFrame() asks
+ *    for its tiles.
+ *    The urgent (visible) image also gets a PREVIEW when it has nothing to
+ *    show at all, and its index thumbnail until then: a preview is drawn,
+ *    but is not usable here.
+ */
+bool ImageViewEngine::UpdateTexture(uint32_t idx, bool urgent) {
+  ASSERT(idx < textures_.size(), "texture index out of range");
+  AssetTexture* tex = textures_[idx];
+  bool tiled = IsTiled(idx);
+  if (tiled ? (pyramids_[idx] != nullptr) :
+              (tex->IsValid() && !tex->IsPreview() &&
+               tex->ColorSpace() == dispColorSpace_)) {
+    return true;
+  }
+  if (!loader_->IsPending(idx) && !failed_.count(idx)) {
+    TEXTURE_JOB job { idx, tex->Name(), dispColorSpace_ };
+    job.tiled_ = tiled;
+    job.mipmaps_ = scaleTextures_;
+    job.compress_ = compressTextures_;
+    job.srgbR8_ = srgbR8_;
+    TextureLimits(&job.maxWidth_, &job.maxHeight_);
+    loader_->Submit(job, urgent);
+    if (urgent && !tiled && !tex->IsValid()) {
+      ShowThumbnail(idx);
+      // in front of the DECODE: a worker has it on screen long before
+      job.stage_ = TEXTURE_STAGE::PREVIEW;
+      loader_->Submit(job, true);
+    }
+  }
+  return false;
+}
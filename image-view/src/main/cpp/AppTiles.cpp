@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include "ImageViewEngine.h"
+
+/*
+ * IsTiled()
+ *    Images larger than a texture may be, or than kMaxUntiledPixels (their
+ *    decoded pixels alone would take hundreds of MB), are never decoded
+ *    whole: they are drawn from tiles of their pyramid.
+ */
+bool ImageViewEngine::IsTiled(uint32_t idx) {
+  if (idx >= imageSizes_.size()) {
+    return false;
+  }
+  uint32_t width = imageSizes_[idx].first, height = imageSizes_[idx].second;
+  return static_cast<uint64_t>(width) * height > kMaxUntiledPixels ||
+         (maxTextureSize_ > 0 &&
+          std::max(width, height) > static_cast<uint32_t>(maxTextureSize_));
+}
+
+/*
+ * VisibleTiles()
+ *    Tiles of a level the view overlaps, row by row
+ */
+static void VisibleTiles(const TILE_LEVEL& info, uint32_t level,
+                         const VIEW_RECT& view, std::vector<TILE_ID>* tiles) {
+  const float T = static_cast<float>(TilePyramid::kTileSize);
+  uint32_t left = static_cast<uint32_t>(
+      std::max(0.0f, view.left_ * info.width_ / T));
+  uint32_t top = static_cast<uint32_t>(
+      std::max(0.0f, view.top_ * info.height_ / T));
+  uint32_t right = std::min(info.columns_, static_cast<uint32_t>(
+      std::ceil(view.right_ * info.width_ / T)));
+  uint32_t bottom = std::min(info.rows_, static_cast<uint32_t>(
+      std::ceil(view.bottom_ * info.height_ / T)));
+  for (uint32_t y = top; y < bottom; y++) {
+    for (uint32_t x = left; x < right; x++) {
+      tiles->push_back(TILE_ID { level, x, y });
+    }
+  }
+}
+
+/*
+ * TileLevel()
+ *    The level whose pixels come closest to screen pixels (each view is
+ *    half the window), or a coarser one when the visible tiles would take
+ *    more than 3/4 of the tile cache: the rest holds the coarser tiles
+ *    drawn while finer ones load.
+ */
+uint32_t ImageViewEngine::TileLevel(const TilePyramid& pyramid,
+                                    const VIEW_RECT& view) {
+  const TILE_LEVEL& base = pyramid.Level(0);
+  float ratio = std::max(
+      (view.right_ - view.left_) * base.width_ /
+          std::max(renderTargetWidth_ / 2, 1),
+      (view.bottom_ - view.top_) * base.height_ /
+          std::max(renderTargetHeight_, 1));
+  uint32_t top = pyramid.LevelCount() - 1;
+  uint32_t level = (ratio > 1.0f) ?
+      static_cast<uint32_t>(std::log2(ratio) + 0.5f) : 0;
+  level = std::min(level, top);
+  std::vector<TILE_ID> tiles;
+  while (level < top) {
+    tiles.clear();
+    VisibleTiles(pyramid.Level(level), level, view, &tiles);
+    if (tiles.size() <= TileCache::kTileLayers * 3 / 4) {
+      break;
+    }
+    level++;
+  }
+  return level;
+}
+
+/*
+ * RequestTiles()
+ *    Queues the tiles the view needs that are neither resident nor on
+ *    their way: the single tile of the coarsest level first (it stands in
+ *    for all the others until they arrive), then the visible ones at
+ *    TileLevel(). Each takes a PboRing slot; with every slot in flight the
+ *    rest are asked for again next frame.
+ */
+void ImageViewEngine::RequestTiles(uint32_t idx, const VIEW_RECT& view) {
+  const TilePyramid& pyramid = *pyramids_[idx];
+  uint32_t top = pyramid.LevelCount() - 1;
+  std::vector<TILE_ID> tiles(1, TILE_ID { top, 0, 0 });
+  uint32_t level = TileLevel(pyramid, view);
+  if (level != top) {
+    VisibleTiles(pyramid.Level(level), level, view, &tiles);
+  }
+
+  std::vector<TEXTURE_JOB> jobs;
+  for (auto& tile : tiles) {
+    uint32_t layer;
+    if (tileCache_.Find(idx, tile, &layer) || tileCache_.IsLoading(idx, tile)) {
+      continue;
+    }
+    TEXTURE_JOB job { idx, textures_[idx]->Name(), dispColorSpace_ };
+    job.stage_ = TEXTURE_STAGE::TILE;
+    job.pyramid_ = pyramids_[idx];
+    job.tile_ = tile;
+    job.slot_ = pboRing_.Acquire(TilePyramid::TileBytes(), &job.dst_);
+    if (job.slot_ < 0) {
+      break;
+    }
+    tileCache_.Loading(idx, tile, true);
+    jobs.push_back(job);
+  }
+  // urgent jobs go in front of the queue: submitted last to first, they
+  // run in the order above, ahead of any background work
+  for (auto it = jobs.rbegin(); it != jobs.rend(); ++it) {
+    loader_->Submit(*it, true);
+  }
+}
+
+/*
+ * UploadTile()
+ *    Uploads from the PBO slot a TILE job wrote, unless the tile cache was
+ *    released or is for another color space by now
+ */
+void ImageViewEngine::UploadTile(TEXTURE_JOB& job) {
+  tileCache_.Loading(job.index_, job.tile_, false);
+  if (tileCache_.Space() != job.space_ || !pboRing_.BindForUpload(job.slot_)) {
+    pboRing_.Abandon(job.slot_);
+    return;
+  }
+  // bits are offsets into the bound GL_PIXEL_UNPACK_BUFFER
+  tileCache_.Upload(job.index_, job.tile_, nullptr);
+  pboRing_.Release(job.slot_);
+}
+
+/*
+ * DrawTiles()
+ *    Draws the view of a tiled image into the screen rectangle, a quad per
+ *    visible tile at TileLevel(). A tile not resident yet is drawn from the
+ *    closest coarser tile that is, blurry for a few frames instead of
+ *    missing.
+ */
+void ImageViewEngine::DrawTiles(uint32_t idx, ShaderProgram& program,
+                                const VIEW_RECT& screen,
+                                const VIEW_RECT& view) {
+  const float T = static_cast<float>(TilePyramid::kTileSize);
+  const float B = static_cast<float>(TilePyramid::kTileBorder);
+  const float S = static_cast<float>(TilePyramid::kTileStride);
+  const TilePyramid& pyramid = *pyramids_[idx];
+  uint32_t level = TileLevel(pyramid, view);
+  const TILE_LEVEL& info = pyramid.Level(level);
+  std::vector<TILE_ID> tiles;
+  VisibleTiles(info, level, view, &tiles);
+
+  float scaleX = (screen.right_ - screen.left_) / (view.right_ - view.left_);
+  float scaleY = (screen.bottom_ - screen.top_) / (view.bottom_ - view.top_);
+  for (auto& tile : tiles) {
+    // the part of the view the tile covers
+    float width = static_cast<float>(info.width_);
+    float height = static_cast<float>(info.height_);
+    VIEW_RECT part {
+        std::max(view.left_, tile.x_ * T / width),
+        std::max(view.top_, tile.y_ * T / height),
+        std::min(view.right_, std::min((tile.x_ + 1) * T, width) / width),
+        std::min(view.bottom_, std::min((tile.y_ + 1) * T, height) / height)
+    };
+    if (part.right_ <= part.left_ || part.bottom_ <= part.top_) {
+      continue;
+    }
+
+    TILE_ID source = tile;
+    uint32_t layer = 0;
+    bool found = tileCache_.Find(idx, source, &layer);
+    while (!found && source.level_ + 1 < pyramid.LevelCount()) {
+      source = TILE_ID { source.level_ + 1, source.x_ / 2, source.y_ / 2 };
+      found = tileCache_.Find(idx, source, &layer);
+    }
+    if (!found) {
+      continue;
+    }
+
+    // texel kTileBorder is the source tile's first own pixel
+    const TILE_LEVEL& src = pyramid.Level(source.level_);
+    VIEW_RECT tex {
+        (part.left_ * src.width_ - source.x_ * T + B) / S,
+        (part.top_ * src.height_ - source.y_ * T + B) / S,
+        (part.right_ * src.width_ - source.x_ * T + B) / S,
+        (part.bottom_ * src.height_ - source.y_ * T + B) / S
+    };
+    VIEW_RECT rect {
+        screen.left_ + (part.left_ - view.left_) * scaleX,
+        screen.top_ + (part.top_ - view.top_) * scaleY,
+        screen.left_ + (part.right_ - view.left_) * scaleX,
+        screen.top_ + (part.bottom_ - view.top_) * scaleY
+    };
+    DrawQuad(program, rect, tex, static_cast<GLfloat>(layer));
+  }
+}
+
+/*
+ * ReleaseTileCache()
+ *    Frees the tile layers while no tiled image is shown
+ */
+void ImageViewEngine::ReleaseTileCache(void) {
+  if (tileCache_.Texture()) {
+    // GL may hand the deleted name out again: forget it is bound
+    texturePool_.BindForDraw(0);
+  }
+  tileCache_.Reset();
+}
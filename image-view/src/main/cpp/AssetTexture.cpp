@@ -15,33 +15,56 @@
  *
  */
 
-#define STB_IMAGE_IMPLEMENTATION
-#define STBI_ONLY_PNG
-#include <stb/stb_image.h>
+#include <algorithm>
+#include <cstring>
 #include "simple_png.h"
 #include "ColorSpaceTransform.h"
+#include "ImageScaler.h"
 #include "AssetTexture.h"
-#include "AssetUtil.h"
 #include "ImageViewEngine.h"
 
 
-#define INVALID_TEXTURE_ID 0xFFFFFFFF
-AssetTexture::AssetTexture(const std::string& name) :
-  name_(name), p3Id_(INVALID_TEXTURE_ID), sRGBId_(INVALID_TEXTURE_ID),
-  valid_(false), dispColorSpace_(DISPLAY_COLORSPACE::INVALID)
+AssetTexture::AssetTexture(const std::string& name, uint32_t index,
+                           TextureArrayPool& pool) :
+  name_(name), index_(index), pool_(pool), layer_ { 0, 0 },
+  valid_(false), dispColorSpace_(DISPLAY_COLORSPACE::INVALID),
+  width_(0), height_(0), levels_(1), compressed_(false), texels_(TEXEL_RGBA),
+  preview_(false), upload_ { 0, 0 }, uploadLayout_ { 0, 0, 0, 0 },
+  uploadSpace_(DISPLAY_COLORSPACE::INVALID), uploadCompressed_(false),
+  uploadTexels_(TEXEL_RGBA), uploadPreview_(false)
 {
 }
 
 AssetTexture::~AssetTexture() {
+  ReleaseGLTextures();
+}
+
+/*
+ * ReleaseGLTextures()
+ *     Gives the array layer back, with an upload in progress; the texture
+ *     can be uploaded again later
+ */
+void AssetTexture::ReleaseGLTextures(void) {
+  AbortUpload();
+  ReleaseLayer();
+}
+
+void AssetTexture::ReleaseLayer(void) {
   if (valid_) {
-    glDeleteTextures(1, &p3Id_);
-    glDeleteTextures(1, &sRGBId_);
+    pool_.Release(layer_);
+    memory_.Reset();
     valid_ = false;
-    p3Id_ = INVALID_TEXTURE_ID;
-    sRGBId_ = INVALID_TEXTURE_ID;
+    layer_ = ARRAY_LAYER { 0, 0 };
   }
 }
 
+size_t AssetTexture::GpuBytes(void) {
+  if (!valid_) {
+    return 0;
+  }
+  return TexelChainSize(width_, height_, levels_, texels_, compressed_);
+}
+
 void AssetTexture::ColorSpace(enum DISPLAY_COLORSPACE space) {
   ASSERT(space != DISPLAY_COLORSPACE::INVALID, "invalid dispColorSpace_");
   // should release all of the previous valid textures...
@@ -55,137 +78,249 @@ bool AssetTexture::IsValid(void) {
   return valid_;
 }
 
-GLuint AssetTexture::P3TexId() {
+/*
+ * TexId()
+ *     The one texture of the image: shown as is, and clipped to sRGB by the
+ *     gamut clip shader for the second view. It is a texture array, shared
+ *     with other images of the same size (TextureArrayPool).
+ */
+GLuint AssetTexture::TexId() {
   ASSERT(valid_, "Texture has not created");
-  return p3Id_;
+  return layer_.texture_;
+}
+uint32_t AssetTexture::Layer() {
+  ASSERT(valid_, "Texture has not created");
+  return layer_.layer_;
+}
+
+/*
+ * InternalFormat()
+ *     Our texture content is EOTF encoded, but depends on display P3 mode, app
+ *     chooses to use or bypass EOTF & OETF hardware functionality. See detailed
+ *     comments in WideColorCtx.cpp. If OETF/EOTF needs bypassed on Android P
+ *     and before, the texture is plain RGBA to fake GPU to bypass OETF/EOTF
+ *     ( gamma alike thing ).
+ */
+GLenum AssetTexture::InternalFormat(DISPLAY_COLORSPACE space) {
+  return (space == DISPLAY_COLORSPACE::P3_PASSTHROUGH) ? GL_RGBA8
+                                                       : GL_SRGB8_ALPHA8;
 }
 
-GLuint AssetTexture::SRGBATexId() {
-  ASSERT(valid_, "texture has not been created");
-  return sRGBId_;
+/*
+ * StagingSize()
+ *     Bytes FillTextures() writes: one mip chain of levels levels
+ *     (TexelChainSize() layout)
+ */
+size_t AssetTexture::StagingSize(uint32_t width, uint32_t height,
+                                 uint32_t levels, TEXEL_LAYOUT layout) {
+  return TexelChainSize(width, height, levels, layout, false);
 }
 
 /*
- * CreateGLTexture()
- *     Create textures with regard to current display_ color space.
- *     For P3 image, one texture is created with original image; the second
- *     texture is created from:
- *       original image --> sRGB color Space --> display_ color space
- *     during the process, colors outside sRGB are clamped.
+ * FillTextures()
+ *     CPU half of CreateGLTextures(): the texture content for the given
+ *     display_ color space, written straight into dst (StagingSize() bytes,
+ *     typically a mapped pixel unpack buffer). Touches no GL state, so it
+ *     runs on the texture loader threads.
+ *     Mip levels are averaged in linear light (BuildMipChain()), not from
+ *     gamma encoded values as glGenerateMipmap() would.
+ *     The transform and the mips work on R8G8B8A8: other layouts go through
+ *     a scratch chain packed into dst at the end (PackTexels()).
  */
-bool AssetTexture::CreateGLTextures(AAssetManager *mgr) {
-  ASSERT(mgr, "Asset Manager is not valid");
-  ASSERT(dispColorSpace_ != DISPLAY_COLORSPACE::INVALID, "eglContext_ color space not set");
-  if (valid_) {
-    glDeleteTextures(1, &p3Id_);
-    glDeleteTextures(1, &sRGBId_);
-    valid_ = false;
-    p3Id_ = INVALID_TEXTURE_ID;
-    sRGBId_ = INVALID_TEXTURE_ID;
+void AssetTexture::FillTextures(const SOURCE_IMAGE& source,
+                                DISPLAY_COLORSPACE space, uint32_t levels,
+                                uint8_t* dst, TEXEL_LAYOUT layout) {
+  if (layout == TEXEL_RGBA) {
+    TransformPixels(source.pixels_, dst, source.width_, source.height_, space);
+    BuildMipChain(dst, source.width_, source.height_, levels);
+    return;
   }
+  std::vector<uint8_t> rgba(StagingSize(source.width_, source.height_, levels));
+  TrackedAllocation rgbaMemory(MEMORY_CATEGORY::STAGING,
+                               source.memory_.Image(), rgba.size());
+  TransformPixels(source.pixels_, rgba.data(), source.width_, source.height_,
+                  space);
+  BuildMipChain(rgba.data(), source.width_, source.height_, levels);
+  PackTexels(rgba.data(), rgba.size() / 4, layout, dst);
+}
 
-  glGenTextures(1, &p3Id_);
-  glBindTexture(GL_TEXTURE_2D, p3Id_);
-
-  std::vector<uint8_t> fileData;
-  AssetReadFile(mgr, name_, fileData);
-
-  uint32_t imgWidth, imgHeight, n;
-  uint8_t* imageData = stbi_load_from_memory(
-      fileData.data(), fileData.size(), reinterpret_cast<int*>(&imgWidth),
-      reinterpret_cast<int*>(&imgHeight), reinterpret_cast<int*>(&n), 4);
-  uint8_t* imgBits = imageData;
-  std::vector<uint8_t> staging;
-  if (dispColorSpace_ == DISPLAY_COLORSPACE::SRGB) {
-    staging.resize(imgWidth * imgHeight * 4 * sizeof(uint8_t));
-    IMAGE_FORMAT src {
-        .buf_ = imageData,
-        .width_ = imgWidth,
-        .height_ = imgHeight,
+/*
+ * TransformPixels()
+ *     Decoded image pixels as the texture holds them in the given display_
+ *     color space. For P3 display_ modes it is the original image: the sRGB
+ *     clipped view
+ *       original image --> sRGB color Space --> display_ color space
+ *     is computed when drawing, by the gamut clip shader. For an sRGB
+ *     display_ the image is converted to sRGB here, clamping colors outside
+ *     of it. src and dst may be the same buffer.
+ */
+void AssetTexture::TransformPixels(const uint8_t* src, uint8_t* dst,
+                                   uint32_t width, uint32_t height,
+                                   DISPLAY_COLORSPACE space) {
+  ASSERT(space != DISPLAY_COLORSPACE::INVALID, "eglContext_ color space not set");
+  if (space == DISPLAY_COLORSPACE::SRGB) {
+    IMAGE_FORMAT srcImg {
+        .buf_ = const_cast<uint8_t*>(src),
+        .width_ = width,
+        .height_ = height,
         .gamma_ = DEFAULT_P3_IMAGE_GAMMA,
-        .npm_ = GetTransformNPM(NPM_TYPE::P3_D65), // p3->xyz
+        .gamut_ = android::Gamut::DISPLAY_P3,
     };
 
-    IMAGE_FORMAT dst {
-        .buf_ = staging.data(),
-        .width_ = imgWidth,
-        .height_ = imgHeight,
+    IMAGE_FORMAT dstImg {
+        .buf_ = dst,
+        .width_ = width,
+        .height_ = height,
         .gamma_ = DEFAULT_DISPLAY_GAMMA,
-        .npm_ = GetTransformNPM(NPM_TYPE::SRGB_D65_INV), // xyz -> sRGB
+        .gamut_ = android::Gamut::SRGB,
     };
-    TransformColorSpace(dst, src);
-    imgBits = staging.data();
+    TransformColorSpace(dstImg, srcImg);
+  } else if (dst != src) {
+    memcpy(dst, src, static_cast<size_t>(width) * height * 4);
+  }
+}
+
+/*
+ * UploadTextures()
+ *     GL half of CreateGLTextures(): (re)fills the image's array layer from
+ *     the FillTextures() layout in one go and takes over its color space.
+ *     With a pixel unpack buffer bound, bits is the offset into that buffer.
+ */
+bool AssetTexture::UploadTextures(uint32_t width, uint32_t height,
+                                  DISPLAY_COLORSPACE space, uint32_t levels,
+                                  const uint8_t* bits, TEXEL_LAYOUT layout) {
+  if (!BeginUpload(width, height, space, levels, false, layout)) {
+    return false;
+  }
+  const uint8_t* level = bits;
+  uint32_t w = width, h = height;
+  for (uint32_t mip = 0; mip < levels; mip++) {
+    UploadBand(mip, 0, h, level);
+    level += TexelImageSize(w, h, layout, false);
+    w = std::max(1u, w >> 1);
+    h = std::max(1u, h >> 1);
   }
+  EndUpload();
+  return true;
+}
 
-  // Our texture content is EOTF encoded, but depends on display P3 mode, app chooses to
-  // use or bypass EOTF & OETF hardware functionality. See detailed comments in WideColorCtx.cpp
-  // If OETF/EOTF needs bypassed on Android P and before, set flag for the texture to be in RGBA
-  // to fake GPU to bypass OETF/EOTF ( gamma alike thing ).
-  GLint textureInternalFormat = GL_SRGB8_ALPHA8;
-  if (dispColorSpace_ == DISPLAY_COLORSPACE::P3_PASSTHROUGH) {
-      textureInternalFormat = GL_RGBA;
+/*
+ * BeginUpload()
+ *     The new content goes into a layer of its own while the current one
+ *     is still drawn (e.g. the ETC2 copy replacing a resident texture, or
+ *     the texture replacing its preview). A texture of the same layout
+ *     would get the same planned layer back: it is released first.
+ *     The format follows the layout (TexelFormat()); ETC2 data (core in
+ *     GLES 3.0) takes a quarter of the memory of TEXEL_RGBA, or an eighth.
+ */
+bool AssetTexture::BeginUpload(uint32_t width, uint32_t height,
+                               DISPLAY_COLORSPACE space, uint32_t levels,
+                               bool compressed, TEXEL_LAYOUT layout,
+                               bool preview) {
+  AbortUpload();
+  uploadLayout_ = TEXTURE_LAYOUT {
+      width, height, levels, TexelFormat(layout, space, compressed) };
+  if (valid_ && uploadLayout_ == TEXTURE_LAYOUT {
+          width_, height_, levels_,
+          TexelFormat(texels_, dispColorSpace_, compressed_) }) {
+    ReleaseLayer();
   }
-  glTexImage2D(GL_TEXTURE_2D, 0,  // mip level
-               textureInternalFormat,
-               imgWidth, imgHeight,
-               0,                // border color
-               GL_RGBA, GL_UNSIGNED_BYTE, imgBits);
-
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-
-  // Generate sRGB view texture
-  glGenTextures(1, &sRGBId_);
-  glBindTexture(GL_TEXTURE_2D, sRGBId_);
-  if(dispColorSpace_ == DISPLAY_COLORSPACE::P3 || dispColorSpace_ == DISPLAY_COLORSPACE::P3_PASSTHROUGH) {
-    IMAGE_FORMAT src {
-        .buf_ = imageData,
-        .width_ = imgWidth,
-        .height_ = imgHeight,
-        .gamma_ = DEFAULT_P3_IMAGE_GAMMA,
-        .npm_ = GetTransformNPM(NPM_TYPE::P3_D65), // p3->xyz
-    };
-    std::vector<uint8_t> srgbImg(imgWidth * imgHeight * 4 * sizeof(uint8_t));
-    IMAGE_FORMAT dst{
-        .buf_ = srgbImg.data(),
-        .width_ = imgWidth,
-        .height_ = imgHeight,
-        .gamma_ = 0.0f,     // intermediate image stays in linear space
-        .npm_ = GetTransformNPM(NPM_TYPE::SRGB_D65_INV), // xyz->sRGB
-    };
-    TransformColorSpace(dst, src);
-
-    // sRGB back to P3 so we could display_ it correctly on P3 device mode
-    staging.resize(imgWidth * imgHeight * 4 * sizeof(uint8_t));
-    IMAGE_FORMAT tmp  = src;
-    src = dst;   // intermediate gamma is 0.0f
-    dst = tmp;   // original src's gamma is preserved
-    src.npm_ = GetTransformNPM(NPM_TYPE::SRGB_D65);
-    dst.buf_ = staging.data();
-    dst.npm_ = GetTransformNPM(NPM_TYPE::P3_D65_INV);
-    dst.gamma_ = DEFAULT_DISPLAY_GAMMA,
-
-    TransformColorSpace(dst, src);
-    imgBits = staging.data();
+  if (!pool_.Acquire(index_, uploadLayout_, &upload_)) {
+    upload_ = ARRAY_LAYER { 0, 0 };
+    return false;
+  }
+  uploadSpace_ = space;
+  uploadCompressed_ = compressed;
+  uploadTexels_ = layout;
+  uploadPreview_ = preview;
+  uploadMemory_ = TrackedAllocation(
+      MEMORY_CATEGORY::GPU_TEXTURE, name_,
+      TexelChainSize(width, height, levels, layout, compressed));
+  return true;
+}
+
+/*
+ * UploadBand()
+ *     rows rows of mip level level from y on: pixels packed in the upload's
+ *     layout, or ETC2 blocks when compressed (y a multiple of 4). With a
+ *     pixel unpack buffer bound, bits is the offset into that buffer.
+ *     Rows of 1 and 3 byte texels are not 4 byte aligned.
+ */
+void AssetTexture::UploadBand(uint32_t level, uint32_t y, uint32_t rows,
+                              const uint8_t* bits) {
+  ASSERT(upload_.texture_, "no upload in progress");
+  uint32_t w = std::max(1u, uploadLayout_.width_ >> level);
+  TextureArrayPool::BindForUpload(upload_.texture_);
+  if (uploadCompressed_) {
+    glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, y, upload_.layer_,
+                              w, rows, 1, uploadLayout_.format_,
+                              static_cast<GLsizei>(TexelImageSize(
+                                  w, rows, uploadTexels_, true)),
+                              bits);
+  } else {
+    if (uploadTexels_ != TEXEL_RGBA) {
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    }
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, y, upload_.layer_,
+                    w, rows, 1, TexelUploadFormat(uploadTexels_),
+                    GL_UNSIGNED_BYTE, bits);
+    if (uploadTexels_ != TEXEL_RGBA) {
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+  }
+  TextureArrayPool::UnbindUpload();
+}
+
+void AssetTexture::EndUpload(void) {
+  if (!upload_.texture_) {
+    return;
   }
-  glTexImage2D(GL_TEXTURE_2D, 0,  // mip level
-               textureInternalFormat, // GL_SRGB8_ALPHA8 for p3_ext mode,
-                                      // GL_RGBA for p3_passthrough_ext
-               imgWidth, imgHeight,
-               0,                // border color
-               GL_RGBA, GL_UNSIGNED_BYTE, imgBits);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-
-  glBindTexture(GL_TEXTURE_2D, 0);
-  stbi_image_free(imageData);
+  ReleaseLayer();
+  layer_ = upload_;
+  dispColorSpace_ = uploadSpace_;
+  width_ = uploadLayout_.width_;
+  height_ = uploadLayout_.height_;
+  levels_ = uploadLayout_.levels_;
+  compressed_ = uploadCompressed_;
+  texels_ = uploadTexels_;
+  preview_ = uploadPreview_;
+  memory_ = std::move(uploadMemory_);
   valid_ = true;
+  upload_ = ARRAY_LAYER { 0, 0 };
+}
 
-  return true;
+void AssetTexture::AbortUpload(void) {
+  if (upload_.texture_) {
+    pool_.Release(upload_);
+    upload_ = ARRAY_LAYER { 0, 0 };
+    uploadMemory_.Reset();
+  }
+}
+
+/*
+ * CreateGLTexture()
+ *     Create textures with regard to current display_ color space, on the
+ *     calling (GL) thread, from client memory. The decoded image comes from
+ *     (and stays in) the source image cache, so creating the textures again
+ *     for another color space only redoes the transform and the upload.
+ */
+bool AssetTexture::CreateGLTextures(AAssetManager *mgr,
+                                    SourceImageCache& cache) {
+  ASSERT(mgr, "Asset Manager is not valid");
+  std::shared_ptr<const SOURCE_IMAGE> source = cache.Get(mgr, name_);
+  if (!source) {
+    return false;
+  }
+  // no GL_EXT_texture_sRGB_R8 check on this path: gray needs GL_R8
+  TEXEL_LAYOUT layout = ChooseTexelLayout(source->traits_, dispColorSpace_,
+                                          false);
+  std::vector<uint8_t> staging(
+      StagingSize(source->width_, source->height_, 1, layout));
+  TrackedAllocation stagingMemory(MEMORY_CATEGORY::STAGING, name_,
+                                  staging.size());
+  FillTextures(*source, dispColorSpace_, 1, staging.data(), layout);
+  return UploadTextures(source->width_, source->height_, dispColorSpace_, 1,
+                        staging.data(), layout);
 }
 
 std::string& AssetTexture::Name(void) {
@@ -19,26 +19,82 @@
 #define  __ASSET_TEXTURE_H__
 #include "common.h"
 #include <string>
+#include <vector>
 #include <GLES3/gl32.h>
 #include <android/asset_manager.h>
+#include "SourceImageCache.h"
+#include "CompressedTextureCache.h"
+#include "TextureArrayPool.h"
+#include "MemoryTracker.h"
+#include "TextureFormat.h"
 
 class AssetTexture {
 private:
   std::string name_;
-  GLuint p3Id_;
-  GLuint sRGBId_;
+  uint32_t index_;              // in the gallery, for the pool's plan
+  TextureArrayPool& pool_;
+  ARRAY_LAYER layer_;
   bool  valid_;
   enum DISPLAY_COLORSPACE dispColorSpace_;
+  uint32_t width_, height_;
+  uint32_t levels_;
+  bool compressed_;
+  TEXEL_LAYOUT texels_;
+  bool preview_;                // stand in until the real content is in
+  TrackedAllocation memory_;    // GPU_TEXTURE bytes of the layer
+
+  // Banded upload in progress (upload_.texture_ 0: none)
+  ARRAY_LAYER upload_;
+  TEXTURE_LAYOUT uploadLayout_;
+  DISPLAY_COLORSPACE uploadSpace_;
+  bool uploadCompressed_;
+  TEXEL_LAYOUT uploadTexels_;
+  bool uploadPreview_;
+  TrackedAllocation uploadMemory_;
+  void ReleaseLayer(void);
 
 public:
-  explicit AssetTexture(const std::string& name);
+  AssetTexture(const std::string& name, uint32_t index, TextureArrayPool& pool);
   ~AssetTexture();
   void ColorSpace(enum DISPLAY_COLORSPACE  clrSpace);
   DISPLAY_COLORSPACE ColorSpace(void);
-  bool CreateGLTextures(AAssetManager* mgr);
+  bool CreateGLTextures(AAssetManager* mgr, SourceImageCache& cache);
+  // Sized format of TEXEL_RGBA textures in that display_ color space
+  static GLenum InternalFormat(DISPLAY_COLORSPACE space);
+  static size_t StagingSize(uint32_t width, uint32_t height,
+                            uint32_t levels = 1,
+                            TEXEL_LAYOUT layout = TEXEL_RGBA);
+  static void FillTextures(const SOURCE_IMAGE& source,
+                           DISPLAY_COLORSPACE space, uint32_t levels,
+                           uint8_t* dst, TEXEL_LAYOUT layout = TEXEL_RGBA);
+  static void TransformPixels(const uint8_t* src, uint8_t* dst,
+                              uint32_t width, uint32_t height,
+                              DISPLAY_COLORSPACE space);
+  bool UploadTextures(uint32_t width, uint32_t height,
+                      DISPLAY_COLORSPACE space, uint32_t levels,
+                      const uint8_t* bits, TEXEL_LAYOUT layout = TEXEL_RGBA);
+  // Banded upload (UploadScheduler): BeginUpload() takes a layer for the
+  // new content, UploadBand() fills rows of a mip level, EndUpload()
+  // switches to it. Until then the texture keeps its previous content.
+  // A preview is valid, but IsPreview() until other content replaces it.
+  bool BeginUpload(uint32_t width, uint32_t height, DISPLAY_COLORSPACE space,
+                   uint32_t levels, bool compressed, TEXEL_LAYOUT layout,
+                   bool preview = false);
+  void UploadBand(uint32_t level, uint32_t y, uint32_t rows,
+                  const uint8_t* bits);
+  void EndUpload(void);
+  void AbortUpload(void);
+  bool IsCompressed(void) const { return valid_ && compressed_; }
+  bool IsPreview(void) const { return valid_ && preview_; }
+  // of the resident content (level 0)
+  uint32_t Width(void) const { return width_; }
+  uint32_t Height(void) const { return height_; }
+  void ReleaseGLTextures(void);
+  size_t GpuBytes(void);   // with mips, 0 when not resident
   bool IsValid(void);
-  GLuint P3TexId(void);
-  GLuint SRGBATexId(void);
+  // GL_TEXTURE_2D_ARRAY holding the image, at Layer()
+  GLuint TexId(void);
+  uint32_t Layer(void);
   std::string& Name(void);
 };
 
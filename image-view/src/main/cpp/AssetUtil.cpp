@@ -15,6 +15,8 @@
  *
  */
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include "AssetUtil.h"
 #include "android_debug.h"
 
@@ -78,3 +80,83 @@ bool AssetReadFile(AAssetManager* assetManager,
   AAsset_close(assetDescriptor);
   return (readSize == buf.size());
 }
+
+int64_t AssetFileSize(AAssetManager* assetManager, const std::string& name) {
+  AAsset* assetDescriptor = AAssetManager_open(assetManager, name.c_str(),
+                                               AASSET_MODE_UNKNOWN);
+  if (!assetDescriptor) {
+    return -1;
+  }
+  int64_t fileLength = AAsset_getLength64(assetDescriptor);
+  AAsset_close(assetDescriptor);
+  return fileLength;
+}
+
+/*
+ * AssetContentHash()
+ *    FNV-1a over the asset's length and its first and last kHashBlock
+ *    bytes, so even a gigapixel asset costs two small reads. That is
+ *    enough to tell an updated PNG from the one a cache file was made
+ *    from: the first block holds IHDR, the last one the Adler-32 of the
+ *    whole zlib stream, the CRC of the last IDAT chunk and IEND.
+ */
+uint64_t AssetContentHash(AAssetManager* assetManager, const std::string& name) {
+  const uint64_t kPrime = 0x100000001b3ULL;
+  const size_t kHashBlock = 64 * 1024;
+  AAsset* assetDescriptor = AAssetManager_open(assetManager, name.c_str(),
+                                               AASSET_MODE_RANDOM);
+  if (!assetDescriptor) {
+    return 0;
+  }
+  int64_t length = AAsset_getLength64(assetDescriptor);
+  std::vector<uint8_t> data(static_cast<size_t>(
+      std::min<int64_t>(length, 2 * kHashBlock)));
+  size_t head = std::min(data.size(), kHashBlock);
+  bool status = AAsset_read(assetDescriptor, data.data(), head) ==
+                static_cast<int>(head);
+  if (status && data.size() > head) {
+    size_t tail = data.size() - head;
+    status = AAsset_seek64(assetDescriptor, length - static_cast<int64_t>(tail),
+                           SEEK_SET) >= 0 &&
+             AAsset_read(assetDescriptor, data.data() + head, tail) ==
+                 static_cast<int>(tail);
+  }
+  AAsset_close(assetDescriptor);
+  if (!status) {
+    return 0;
+  }
+  uint64_t hash = 0xcbf29ce484222325ULL ^ static_cast<uint64_t>(length);
+  for (auto byte : data) {
+    hash = (hash ^ byte) * kPrime;
+  }
+  return hash ? hash : 1;
+}
+
+/*
+ * AssetImageSize()
+ *    PNG signature (8 bytes), IHDR length and type (8 bytes), then big
+ *    endian width and height
+ */
+bool AssetImageSize(AAssetManager* assetManager, const std::string& name,
+                    uint32_t* width, uint32_t* height) {
+  static const uint8_t kSignature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+  AAsset* assetDescriptor = AAssetManager_open(assetManager, name.c_str(),
+                                               AASSET_MODE_STREAMING);
+  if (!assetDescriptor) {
+    return false;
+  }
+  uint8_t header[24];
+  int readSize = AAsset_read(assetDescriptor, header, sizeof(header));
+  AAsset_close(assetDescriptor);
+  if (readSize != sizeof(header) ||
+      !std::equal(kSignature, kSignature + sizeof(kSignature), header) ||
+      !std::equal(header + 12, header + 16, "IHDR")) {
+    return false;
+  }
+  auto bigEndian = [](const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+  };
+  *width = bigEndian(header + 16);
+  *height = bigEndian(header + 20);
+  return *width && *height;
+}
@@ -25,5 +25,13 @@ bool AssetEnumerateFileType(AAssetManager * assetManager,
                         const char* type, std::vector<std::string> & files);
 bool AssetReadFile(AAssetManager* assetManager,
               std::string& name, std::vector<uint8_t>& buf);
+// Byte size of the asset without reading it, -1 if there is none
+int64_t AssetFileSize(AAssetManager* assetManager, const std::string& name);
+// 64 bit hash of the asset's length, first and last bytes (cheap even
+// for the largest assets), 0 if it cannot be read
+uint64_t AssetContentHash(AAssetManager* assetManager, const std::string& name);
+// Dimensions from the PNG IHDR chunk, reading only the first bytes
+bool AssetImageSize(AAssetManager* assetManager, const std::string& name,
+                    uint32_t* width, uint32_t* height);
 
 #endif // __ASSET__UTIL_H__
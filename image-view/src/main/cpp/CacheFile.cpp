@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "CacheFile.h"
+
+static std::string TempPath(const std::string& path) {
+  static std::atomic<uint32_t> tmpCount(0);
+  return path + ".tmp" + std::to_string(tmpCount++);
+}
+
+static bool Publish(const std::string& tmpPath, const std::string& path,
+                    bool status) {
+  // rename() keeps a half written file from ever being loaded
+  if (!status || rename(tmpPath.c_str(), path.c_str())) {
+    unlink(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool WriteCacheFile(const std::string& path,
+                    const std::function<bool(int fd)>& write) {
+  std::string tmpPath = TempPath(path);
+  int fd = open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    return false;
+  }
+  bool status = write(fd);
+  status = (close(fd) == 0) && status;
+  return Publish(tmpPath, path, status);
+}
+
+bool WriteCacheStream(const std::string& path,
+                      const std::function<bool(FILE* fp)>& write) {
+  std::string tmpPath = TempPath(path);
+  FILE* fp = fopen(tmpPath.c_str(), "wb");
+  if (!fp) {
+    return false;
+  }
+  bool status = write(fp);
+  status = (fclose(fp) == 0) && status;
+  return Publish(tmpPath, path, status);
+}
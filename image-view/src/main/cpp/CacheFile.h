@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __CACHE_FILE_H__
+#define __CACHE_FILE_H__
+
+#include <cstdio>
+#include <functional>
+#include <string>
+
+/*
+ * WriteCacheFile()
+ *    Writes path through a temporary file of its own (path.tmp<n>, unique
+ *    in the process) renamed over path once write() and close() succeed,
+ *    so a half written file is never loaded and two writers of the same
+ *    path never share one. On failure the temporary file is removed and
+ *    path is left as it was. WriteCacheStream() is the same with stdio.
+ */
+bool WriteCacheFile(const std::string& path,
+                    const std::function<bool(int fd)>& write);
+bool WriteCacheStream(const std::string& path,
+                      const std::function<bool(FILE* fp)>& write);
+
+#endif // __CACHE_FILE_H__
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "CacheTrim.h"
+#include "android_debug.h"
+
+size_t TrimCacheDir(const std::string& dir, const char* suffix,
+                    size_t budget) {
+  DIR* dp = opendir(dir.c_str());
+  if (!dp) {
+    return 0;
+  }
+  struct CACHE_FILE {
+    std::string path_;
+    size_t size_;
+    struct timespec used_;
+  };
+  std::vector<CACHE_FILE> files;
+  size_t total = 0;
+  const size_t suffixLength = strlen(suffix);
+  struct dirent* entry;
+  while ((entry = readdir(dp))) {
+    size_t length = strlen(entry->d_name);
+    if (length <= suffixLength ||
+        strcmp(entry->d_name + length - suffixLength, suffix)) {
+      continue;
+    }
+    std::string path = dir + "/" + entry->d_name;
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0) {
+      files.push_back(CACHE_FILE { path, static_cast<size_t>(st.st_size),
+                                   st.st_mtim });
+      total += static_cast<size_t>(st.st_size);
+    }
+  }
+  closedir(dp);
+  if (total <= budget) {
+    return total;
+  }
+
+  std::sort(files.begin(), files.end(),
+            [](const CACHE_FILE& a, const CACHE_FILE& b) {
+              return a.used_.tv_sec != b.used_.tv_sec ?
+                     a.used_.tv_sec < b.used_.tv_sec :
+                     a.used_.tv_nsec < b.used_.tv_nsec;
+            });
+  files.pop_back();   // the most recently used one
+  uint32_t removed = 0;
+  for (auto& file : files) {
+    if (total <= budget) {
+      break;
+    }
+    if (unlink(file.path_.c_str()) == 0) {
+      total -= file.size_;
+      removed++;
+    }
+  }
+  LOGI("Cache %s: removed %u files, %zu / %zu bytes", dir.c_str(), removed,
+       total, budget);
+  return total;
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __CACHE_TRIM_H__
+#define __CACHE_TRIM_H__
+
+#include <cstddef>
+#include <string>
+
+/*
+ * TrimCacheDir()
+ *    Deletes the least recently used files of dir ending in suffix (by
+ *    modification time: hits refresh it with futimens()) until the rest
+ *    fits in budget bytes. The most recently used file always stays, so a
+ *    file larger than the budget survives until the next one is written.
+ *    Files being written (.tmp*) are left alone. Returns the bytes left.
+ *    Callers serialize trims of the same directory.
+ */
+size_t TrimCacheDir(const std::string& dir, const char* suffix,
+                    size_t budget);
+
+#endif // __CACHE_TRIM_H__
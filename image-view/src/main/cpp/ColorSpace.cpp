@@ -15,6 +15,7 @@
  */
 
 #include "ColorSpace.h"
+#include "ColorSpaceMatrices.h"
 
 using namespace std::placeholders;
 
@@ -82,6 +83,24 @@ namespace android {
         return std::bind(safePow, _1, gamma);
     }
 
+    template<typename F>
+    static bool isFunction(const std::function<float(float)>& f, F fn) {
+        const F* target = f.template target<F>();
+        return target && *target == fn;
+    }
+
+    // Detects the functions the batch conversions evaluate inline. Anything
+    // else (including copies of saturate<> from another translation unit)
+    // simply takes the std::function path.
+    bool ColorSpace::isLinearResponse(const transfer_function& f) {
+        return isFunction(f, &linearResponse) ||
+               isFunction(f, &ColorSpace::linearResponse);
+    }
+
+    bool ColorSpace::isSaturate(const clamping_function& f) {
+        return isFunction(f, &saturate<float>);
+    }
+
     static constexpr std::array<float2, 3> computePrimaries(const mat3& rgbToXYZ) {
         float3 r(rgbToXYZ * float3{1, 0, 0});
         float3 g(rgbToXYZ * float3{0, 1, 0});
@@ -109,6 +128,9 @@ namespace android {
     , mOETF(std::move(OETF))
     , mEOTF(std::move(EOTF))
     , mClamper(std::move(clamper))
+    , mTransferType(isLinearResponse(mOETF) && isLinearResponse(mEOTF) ?
+            TransferType::Linear : TransferType::Custom)
+    , mSaturates(isSaturate(mClamper))
     , mPrimaries(computePrimaries(rgbToXYZ))
     , mWhitePoint(computeWhitePoint(rgbToXYZ)) {
     }
@@ -125,6 +147,8 @@ namespace android {
     , mOETF(toOETF(mParameters))
     , mEOTF(toEOTF(mParameters))
     , mClamper(std::move(clamper))
+    , mTransferType(TransferType::Parametric)
+    , mSaturates(isSaturate(mClamper))
     , mPrimaries(computePrimaries(rgbToXYZ))
     , mWhitePoint(computeWhitePoint(rgbToXYZ)) {
     }
@@ -141,6 +165,8 @@ namespace android {
     , mOETF(toOETF(gamma))
     , mEOTF(toEOTF(gamma))
     , mClamper(std::move(clamper))
+    , mTransferType(gamma == 1.0f ? TransferType::Linear : TransferType::Gamma)
+    , mSaturates(isSaturate(mClamper))
     , mPrimaries(computePrimaries(rgbToXYZ))
     , mWhitePoint(computeWhitePoint(rgbToXYZ)) {
     }
@@ -158,6 +184,9 @@ namespace android {
     , mOETF(std::move(OETF))
     , mEOTF(std::move(EOTF))
     , mClamper(std::move(clamper))
+    , mTransferType(isLinearResponse(mOETF) && isLinearResponse(mEOTF) ?
+            TransferType::Linear : TransferType::Custom)
+    , mSaturates(isSaturate(mClamper))
     , mPrimaries(primaries)
     , mWhitePoint(whitePoint) {
     }
@@ -175,6 +204,8 @@ namespace android {
     , mOETF(toOETF(mParameters))
     , mEOTF(toEOTF(mParameters))
     , mClamper(std::move(clamper))
+    , mTransferType(TransferType::Parametric)
+    , mSaturates(isSaturate(mClamper))
     , mPrimaries(primaries)
     , mWhitePoint(whitePoint) {
     }
@@ -192,49 +223,17 @@ namespace android {
     , mOETF(toOETF(gamma))
     , mEOTF(toEOTF(gamma))
     , mClamper(std::move(clamper))
+    , mTransferType(gamma == 1.0f ? TransferType::Linear : TransferType::Gamma)
+    , mSaturates(isSaturate(mClamper))
     , mPrimaries(primaries)
     , mWhitePoint(whitePoint) {
     }
 
-    constexpr mat3 ColorSpace::computeXYZMatrix(
-            const std::array<float2, 3>& primaries, const float2& whitePoint) {
-        const float2& R = primaries[0];
-        const float2& G = primaries[1];
-        const float2& B = primaries[2];
-        const float2& W = whitePoint;
-
-        float oneRxRy = (1 - R.x) / R.y;
-        float oneGxGy = (1 - G.x) / G.y;
-        float oneBxBy = (1 - B.x) / B.y;
-        float oneWxWy = (1 - W.x) / W.y;
-
-        float RxRy = R.x / R.y;
-        float GxGy = G.x / G.y;
-        float BxBy = B.x / B.y;
-        float WxWy = W.x / W.y;
-
-        float BY =
-                ((oneWxWy - oneRxRy) * (GxGy - RxRy) - (WxWy - RxRy) * (oneGxGy - oneRxRy)) /
-                ((oneBxBy - oneRxRy) * (GxGy - RxRy) - (BxBy - RxRy) * (oneGxGy - oneRxRy));
-        float GY = (WxWy - RxRy - BY * (BxBy - RxRy)) / (GxGy - RxRy);
-        float RY = 1 - GY - BY;
-
-        float RYRy = RY / R.y;
-        float GYGy = GY / G.y;
-        float BYBy = BY / B.y;
-
-        return {
-                float3{RYRy * R.x, RY, RYRy * (1 - R.x - R.y)},
-                float3{GYGy * G.x, GY, GYGy * (1 - G.x - G.y)},
-                float3{BYBy * B.x, BY, BYBy * (1 - B.x - B.y)}
-        };
-    }
-
     const ColorSpace ColorSpace::sRGB() {
         return {
                 "sRGB IEC61966-2.1",
-                {{float2{0.640f, 0.330f}, {0.300f, 0.600f}, {0.150f, 0.060f}}},
-                {0.3127f, 0.3290f},
+                kGamutPrimaries[static_cast<size_t>(Gamut::SRGB)].primaries,
+                kGamutPrimaries[static_cast<size_t>(Gamut::SRGB)].whitePoint,
                 {2.4f, 1 / 1.055f, 0.055f / 1.055f, 1 / 12.92f, 0.04045f, 0.0f, 0.0f}
         };
     }
@@ -289,8 +288,8 @@ namespace android {
     const ColorSpace ColorSpace::BT2020() {
         return {
                 "Rec. ITU-R BT.2020-1",
-                {{float2{0.708f, 0.292f}, {0.170f, 0.797f}, {0.131f, 0.046f}}},
-                {0.3127f, 0.3290f},
+                kGamutPrimaries[static_cast<size_t>(Gamut::BT2020)].primaries,
+                kGamutPrimaries[static_cast<size_t>(Gamut::BT2020)].whitePoint,
                 {1 / 0.45f, 1 / 1.099f, 0.099f / 1.099f, 1 / 4.5f, 0.081f, 0.0f, 0.0f}
         };
     }
@@ -316,8 +315,8 @@ namespace android {
     const ColorSpace ColorSpace::DisplayP3() {
         return {
                 "Display P3",
-                {{float2{0.680f, 0.320f}, {0.265f, 0.690f}, {0.150f, 0.060f}}},
-                {0.3127f, 0.3290f},
+                kGamutPrimaries[static_cast<size_t>(Gamut::DISPLAY_P3)].primaries,
+                kGamutPrimaries[static_cast<size_t>(Gamut::DISPLAY_P3)].whitePoint,
                 {2.2f, 1 / 1.055f, 0.055f / 1.055f, 1 / 12.92f, 0.039f, 0.0f, 0.0f}
         };
     }
@@ -325,8 +324,8 @@ namespace android {
     const ColorSpace ColorSpace::DCIP3() {
         return {
                 "SMPTE RP 431-2-2007 DCI (P3)",
-                {{float2{0.680f, 0.320f}, {0.265f, 0.690f}, {0.150f, 0.060f}}},
-                {0.314f, 0.351f},
+                kGamutPrimaries[static_cast<size_t>(Gamut::DCI_P3)].primaries,
+                kGamutPrimaries[static_cast<size_t>(Gamut::DCI_P3)].whitePoint,
                 2.6f
         };
     }
@@ -351,6 +350,70 @@ namespace android {
         };
     }
 
+    void ColorSpace::toLinear(float* values, size_t count) const noexcept {
+        switch (mTransferType) {
+            case TransferType::Linear:
+                break;
+            case TransferType::Gamma: {
+                const float g = mParameters.g;
+                for (size_t i = 0; i < count; i++) {
+                    values[i] = safePow(values[i], g);
+                }
+                break;
+            }
+            case TransferType::Parametric: {
+                const TransferParameters p = mParameters;
+                for (size_t i = 0; i < count; i++) {
+                    values[i] = fullResponse(values[i], p);
+                }
+                break;
+            }
+            case TransferType::Custom:
+                for (size_t i = 0; i < count; i++) {
+                    values[i] = mEOTF(values[i]);
+                }
+                break;
+        }
+    }
+
+    void ColorSpace::fromLinear(float* values, size_t count) const noexcept {
+        switch (mTransferType) {
+            case TransferType::Linear:
+                break;
+            case TransferType::Gamma: {
+                const float e = 1.0f / mParameters.g;
+                for (size_t i = 0; i < count; i++) {
+                    values[i] = safePow(values[i], e);
+                }
+                break;
+            }
+            case TransferType::Parametric: {
+                const TransferParameters p = mParameters;
+                for (size_t i = 0; i < count; i++) {
+                    values[i] = rcpFullResponse(values[i], p);
+                }
+                break;
+            }
+            case TransferType::Custom:
+                for (size_t i = 0; i < count; i++) {
+                    values[i] = mOETF(values[i]);
+                }
+                break;
+        }
+    }
+
+    void ColorSpace::clampValues(float* values, size_t count) const noexcept {
+        if (mSaturates) {
+            for (size_t i = 0; i < count; i++) {
+                values[i] = saturate(values[i]);
+            }
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                values[i] = mClamper(values[i]);
+            }
+        }
+    }
+
     std::unique_ptr<float3[]> ColorSpace::createLUT(uint32_t size, const ColorSpace& src,
                                                     const ColorSpace& dst) {
         size = clamp(size, 2u, 256u);
@@ -376,46 +439,111 @@ namespace android {
         return lut;
     }
 
-    static const float2 ILLUMINANT_D50_XY = {0.34567f, 0.35850f};
-    static const float3 ILLUMINANT_D50_XYZ = {0.964212f, 1.0f, 0.825188f};
-    static const mat3 BRADFORD = mat3{
-            float3{ 0.8951f, -0.7502f,  0.0389f},
-            float3{ 0.2664f,  1.7135f, -0.0685f},
-            float3{-0.1614f,  0.0367f,  1.0296f}
-    };
-
-    static mat3 adaptation(const mat3& matrix, const float3& srcWhitePoint, const float3& dstWhitePoint) {
-        float3 srcLMS = matrix * srcWhitePoint;
-        float3 dstLMS = matrix * dstWhitePoint;
-        return inverse(matrix) * mat3{dstLMS / srcLMS} * matrix;
-    }
-
     ColorSpaceConnector::ColorSpaceConnector(
             const ColorSpace& src,
             const ColorSpace& dst) noexcept
     : mSource(src)
-    , mDestination(dst) {
+    , mDestination(dst)
+    , mTransform(ColorSpace::computeTransform(
+            src.getRGBtoXYZ(), src.getWhitePoint(),
+            dst.getRGBtoXYZ(), dst.getWhitePoint())) {
+    }
+
+    void ColorSpaceConnector::transformBlock(
+            float* r, float* g, float* b, size_t count, bool linear) const noexcept {
+        mSource.clampValues(r, count);
+        mSource.clampValues(g, count);
+        mSource.clampValues(b, count);
+        if (!linear) {
+            mSource.toLinear(r, count);
+            mSource.toLinear(g, count);
+            mSource.toLinear(b, count);
+        }
 
-        if (all(lessThan(abs(src.getWhitePoint() - dst.getWhitePoint()), float2{1e-3f}))) {
-            mTransform = dst.getXYZtoRGB() * src.getRGBtoXYZ();
-        } else {
-            mat3 rgbToXYZ(src.getRGBtoXYZ());
-            mat3 xyzToRGB(dst.getXYZtoRGB());
+        const mat3& m = mTransform;
+        for (size_t i = 0; i < count; i++) {
+            float x = r[i];
+            float y = g[i];
+            float z = b[i];
+            r[i] = m[0].x * x + m[1].x * y + m[2].x * z;
+            g[i] = m[0].y * x + m[1].y * y + m[2].y * z;
+            b[i] = m[0].z * x + m[1].z * y + m[2].z * z;
+        }
 
-            float3 srcXYZ = ColorSpace::XYZ(float3{src.getWhitePoint(), 1});
-            float3 dstXYZ = ColorSpace::XYZ(float3{dst.getWhitePoint(), 1});
+        if (!linear) {
+            mDestination.fromLinear(r, count);
+            mDestination.fromLinear(g, count);
+            mDestination.fromLinear(b, count);
+        }
+        mDestination.clampValues(r, count);
+        mDestination.clampValues(g, count);
+        mDestination.clampValues(b, count);
+    }
+
+    void ColorSpaceConnector::transformPlanar(
+            const float* srcR, const float* srcG, const float* srcB,
+            float* dstR, float* dstG, float* dstB, size_t count, bool linear) const noexcept {
+        float r[BATCH_SIZE];
+        float g[BATCH_SIZE];
+        float b[BATCH_SIZE];
+        for (size_t start = 0; start < count; start += BATCH_SIZE) {
+            size_t n = std::min(count - start, BATCH_SIZE);
+            std::copy(srcR + start, srcR + start + n, r);
+            std::copy(srcG + start, srcG + start + n, g);
+            std::copy(srcB + start, srcB + start + n, b);
+            transformBlock(r, g, b, n, linear);
+            std::copy(r, r + n, dstR + start);
+            std::copy(g, g + n, dstG + start);
+            std::copy(b, b + n, dstB + start);
+        }
+    }
 
-            if (any(greaterThan(abs(src.getWhitePoint() - ILLUMINANT_D50_XY), float2{1e-3f}))) {
-                rgbToXYZ = adaptation(BRADFORD, srcXYZ, ILLUMINANT_D50_XYZ) * src.getRGBtoXYZ();
+    void ColorSpaceConnector::transformInterleaved(
+            const float* srcRGBA, float* dstRGBA, size_t count, bool linear) const noexcept {
+        float r[BATCH_SIZE];
+        float g[BATCH_SIZE];
+        float b[BATCH_SIZE];
+        float a[BATCH_SIZE];
+        for (size_t start = 0; start < count; start += BATCH_SIZE) {
+            size_t n = std::min(count - start, BATCH_SIZE);
+            const float* src = srcRGBA + start * 4;
+            for (size_t i = 0; i < n; i++) {
+                r[i] = src[i * 4 + 0];
+                g[i] = src[i * 4 + 1];
+                b[i] = src[i * 4 + 2];
+                a[i] = src[i * 4 + 3];
             }
-
-            if (any(greaterThan(abs(dst.getWhitePoint() - ILLUMINANT_D50_XY), float2{1e-3f}))) {
-                xyzToRGB = inverse(adaptation(BRADFORD, dstXYZ, ILLUMINANT_D50_XYZ) * dst.getRGBtoXYZ());
+            transformBlock(r, g, b, n, linear);
+            float* dst = dstRGBA + start * 4;
+            for (size_t i = 0; i < n; i++) {
+                dst[i * 4 + 0] = r[i];
+                dst[i * 4 + 1] = g[i];
+                dst[i * 4 + 2] = b[i];
+                dst[i * 4 + 3] = a[i];
             }
-
-            mTransform = xyzToRGB * rgbToXYZ;
         }
     }
 
-}; // namespace android
+    void ColorSpaceConnector::transform(
+            const float* srcR, const float* srcG, const float* srcB,
+            float* dstR, float* dstG, float* dstB, size_t count) const noexcept {
+        transformPlanar(srcR, srcG, srcB, dstR, dstG, dstB, count, false);
+    }
 
+    void ColorSpaceConnector::transformLinear(
+            const float* srcR, const float* srcG, const float* srcB,
+            float* dstR, float* dstG, float* dstB, size_t count) const noexcept {
+        transformPlanar(srcR, srcG, srcB, dstR, dstG, dstB, count, true);
+    }
+
+    void ColorSpaceConnector::transform(
+            const float* srcRGBA, float* dstRGBA, size_t count) const noexcept {
+        transformInterleaved(srcRGBA, dstRGBA, count, false);
+    }
+
+    void ColorSpaceConnector::transformLinear(
+            const float* srcRGBA, float* dstRGBA, size_t count) const noexcept {
+        transformInterleaved(srcRGBA, dstRGBA, count, true);
+    }
+
+}; // namespace android
@@ -180,6 +180,17 @@ namespace android {
             return mRGBtoXYZ * toLinear(rgb);
         }
 
+        /**
+         * Batch versions of toLinear(), fromLinear() and of the clamping
+         * function, applied in place to count consecutive values. Linear,
+         * gamma and parametric curves and the default saturate clamp are
+         * evaluated inline in loops the compiler can vectorize; custom
+         * functions are called once per value.
+         */
+        void toLinear(float* values, size_t count) const noexcept;
+        void fromLinear(float* values, size_t count) const noexcept;
+        void clampValues(float* values, size_t count) const noexcept;
+
         constexpr const std::string& getName() const noexcept {
             return mName;
         }
@@ -244,6 +255,76 @@ namespace android {
         static const ColorSpace ACES();
         static const ColorSpace ACEScg();
 
+        /**
+         * Computes the RGB->XYZ conversion matrix of the color space
+         * defined by the specified primaries and white point. This can
+         * be evaluated at compile time.
+         */
+        static constexpr mat3 computeXYZMatrix(
+                const std::array<float2, 3>& primaries, const float2& whitePoint) {
+            const float2& R = primaries[0];
+            const float2& G = primaries[1];
+            const float2& B = primaries[2];
+            const float2& W = whitePoint;
+
+            float oneRxRy = (1 - R.x) / R.y;
+            float oneGxGy = (1 - G.x) / G.y;
+            float oneBxBy = (1 - B.x) / B.y;
+            float oneWxWy = (1 - W.x) / W.y;
+
+            float RxRy = R.x / R.y;
+            float GxGy = G.x / G.y;
+            float BxBy = B.x / B.y;
+            float WxWy = W.x / W.y;
+
+            float BY =
+                    ((oneWxWy - oneRxRy) * (GxGy - RxRy) - (WxWy - RxRy) * (oneGxGy - oneRxRy)) /
+                    ((oneBxBy - oneRxRy) * (GxGy - RxRy) - (BxBy - RxRy) * (oneGxGy - oneRxRy));
+            float GY = (WxWy - RxRy - BY * (BxBy - RxRy)) / (GxGy - RxRy);
+            float RY = 1 - GY - BY;
+
+            float RYRy = RY / R.y;
+            float GYGy = GY / G.y;
+            float BYBy = BY / B.y;
+
+            return {
+                    float3{RYRy * R.x, RY, RYRy * (1 - R.x - R.y)},
+                    float3{GYGy * G.x, GY, GYGy * (1 - G.x - G.y)},
+                    float3{BYBy * B.x, BY, BYBy * (1 - B.x - B.y)}
+            };
+        }
+
+        /**
+         * Computes the linear RGB->RGB matrix converting from the source
+         * to the destination color space. When the white points differ,
+         * both sides are adapted to D50 with the Bradford transform.
+         * ColorSpaceConnector uses this as well; it can be evaluated at
+         * compile time.
+         */
+        static constexpr mat3 computeTransform(
+                const mat3& srcRGBtoXYZ, const float2& srcWhitePoint,
+                const mat3& dstRGBtoXYZ, const float2& dstWhitePoint) {
+            if (isSameWhitePoint(srcWhitePoint, dstWhitePoint)) {
+                return inverse(dstRGBtoXYZ) * srcRGBtoXYZ;
+            }
+
+            mat3 rgbToXYZ(srcRGBtoXYZ);
+            mat3 xyzToRGB(inverse(dstRGBtoXYZ));
+
+            float3 srcXYZ = XYZ(float3{srcWhitePoint, 1});
+            float3 dstXYZ = XYZ(float3{dstWhitePoint, 1});
+
+            if (!isSameWhitePoint(srcWhitePoint, ILLUMINANT_D50_XY)) {
+                rgbToXYZ = adaptation(BRADFORD, srcXYZ, ILLUMINANT_D50_XYZ) * srcRGBtoXYZ;
+            }
+
+            if (!isSameWhitePoint(dstWhitePoint, ILLUMINANT_D50_XY)) {
+                xyzToRGB = inverse(adaptation(BRADFORD, dstXYZ, ILLUMINANT_D50_XYZ) * dstRGBtoXYZ);
+            }
+
+            return xyzToRGB * rgbToXYZ;
+        }
+
         // Creates a NxNxN 3D LUT, where N is the specified size (min=2, max=256)
         // The 3D lookup coordinates map to the RGB components: u=R, v=G, w=B
         // The generated 3D LUT is meant to be used as a 3D texture and its Y
@@ -254,13 +335,46 @@ namespace android {
                                                    const ColorSpace& dst);
 
     private:
-        static constexpr mat3 computeXYZMatrix(
-                const std::array<float2, 3>& primaries, const float2& whitePoint);
+        static constexpr float2 ILLUMINANT_D50_XY = {0.34567f, 0.35850f};
+        static constexpr float3 ILLUMINANT_D50_XYZ = {0.964212f, 1.0f, 0.825188f};
+        static constexpr mat3 BRADFORD = mat3{
+                float3{ 0.8951f, -0.7502f,  0.0389f},
+                float3{ 0.2664f,  1.7135f, -0.0685f},
+                float3{-0.1614f,  0.0367f,  1.0296f}
+        };
 
         static constexpr float linearResponse(float v) {
             return v;
         }
 
+        // How the transfer functions were specified, so that the batch
+        // conversions can evaluate them inline instead of one value at a
+        // time through std::function
+        enum class TransferType {
+            Linear,
+            Gamma,
+            Parametric,
+            Custom
+        };
+
+        static bool isLinearResponse(const transfer_function& f);
+        static bool isSaturate(const clamping_function& f);
+
+        // Same test as abs(a - b) < 1e-3, without std::abs so that it
+        // stays usable in constant expressions
+        static constexpr bool isSameWhitePoint(const float2& a, const float2& b) {
+            return a.x - b.x < 1e-3f && b.x - a.x < 1e-3f &&
+                   a.y - b.y < 1e-3f && b.y - a.y < 1e-3f;
+        }
+
+        static constexpr mat3 adaptation(
+                const mat3& matrix, const float3& srcWhitePoint, const float3& dstWhitePoint) {
+            float3 srcLMS = matrix * srcWhitePoint;
+            float3 dstLMS = matrix * dstWhitePoint;
+            float3 scale{dstLMS.x / srcLMS.x, dstLMS.y / srcLMS.y, dstLMS.z / srcLMS.z};
+            return inverse(matrix) * mat3{scale} * matrix;
+        }
+
         std::string mName;
 
         mat3 mRGBtoXYZ;
@@ -270,6 +384,8 @@ namespace android {
         transfer_function mOETF;
         transfer_function mEOTF;
         clamping_function mClamper;
+        TransferType mTransferType;
+        bool mSaturates;
 
         std::array<float2, 3> mPrimaries;
         float2 mWhitePoint;
@@ -294,7 +410,36 @@ namespace android {
             return apply(mTransform * linear, mDestination.getClamper());
         }
 
+        /**
+         * Batch versions of transform() and transformLinear() over planar
+         * buffers holding count values per channel. The work is done in
+         * blocks of BATCH_SIZE values, one pass per step (clamp, curve,
+         * matrix) so that each pass vectorizes. Source and destination
+         * may be the same buffers.
+         */
+        void transform(const float* srcR, const float* srcG, const float* srcB,
+                       float* dstR, float* dstG, float* dstB, size_t count) const noexcept;
+        void transformLinear(const float* srcR, const float* srcG, const float* srcB,
+                             float* dstR, float* dstG, float* dstB, size_t count) const noexcept;
+
+        /**
+         * Same as above for interleaved RGBA buffers of count pixels. Alpha
+         * is copied unchanged. src and dst may be the same buffer.
+         */
+        void transform(const float* srcRGBA, float* dstRGBA, size_t count) const noexcept;
+        void transformLinear(const float* srcRGBA, float* dstRGBA, size_t count) const noexcept;
+
+        static constexpr size_t BATCH_SIZE = 256;
+
     private:
+        void transformBlock(float* r, float* g, float* b, size_t count,
+                            bool linear) const noexcept;
+        void transformPlanar(const float* srcR, const float* srcG, const float* srcB,
+                             float* dstR, float* dstG, float* dstB, size_t count,
+                             bool linear) const noexcept;
+        void transformInterleaved(const float* srcRGBA, float* dstRGBA, size_t count,
+                                  bool linear) const noexcept;
+
         ColorSpace mSource;
         ColorSpace mDestination;
         mat3 mTransform;
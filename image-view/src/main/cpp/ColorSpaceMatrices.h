@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_UI_COLOR_SPACE_MATRICES
+#define ANDROID_UI_COLOR_SPACE_MATRICES
+
+#include <array>
+#include <cstdint>
+
+#include "ColorSpace.h"
+
+namespace android {
+
+    /**
+     * Gamuts the viewer converts between. The order matches the
+     * entries of kGamutPrimaries and the rows/columns of kGamutMatrices.
+     */
+    enum class Gamut : uint32_t {
+        SRGB = 0,
+        DISPLAY_P3,
+        DCI_P3,
+        BT2020,
+        COUNT
+    };
+
+    constexpr size_t kGamutCount = static_cast<size_t>(Gamut::COUNT);
+
+    struct GamutPrimaries {
+        std::array<float2, 3> primaries;
+        float2 whitePoint;
+    };
+
+    /**
+     * Primaries and white points of every Gamut. ColorSpace::sRGB(),
+     * DisplayP3(), DCIP3() and BT2020() are built from these same values.
+     */
+    constexpr GamutPrimaries kGamutPrimaries[kGamutCount] = {
+            // sRGB IEC61966-2.1
+            {{{float2{0.640f, 0.330f}, {0.300f, 0.600f}, {0.150f, 0.060f}}},
+                    {0.3127f, 0.3290f}},
+            // Display P3
+            {{{float2{0.680f, 0.320f}, {0.265f, 0.690f}, {0.150f, 0.060f}}},
+                    {0.3127f, 0.3290f}},
+            // SMPTE RP 431-2-2007 DCI (P3)
+            {{{float2{0.680f, 0.320f}, {0.265f, 0.690f}, {0.150f, 0.060f}}},
+                    {0.314f, 0.351f}},
+            // Rec. ITU-R BT.2020-1
+            {{{float2{0.708f, 0.292f}, {0.170f, 0.797f}, {0.131f, 0.046f}}},
+                    {0.3127f, 0.3290f}},
+    };
+
+    /**
+     * Every conversion matrix between the gamuts above:
+     *   rgbToXYZ[g]        linear RGB of g -> CIE XYZ (g's own white point)
+     *   xyzToRGB[g]        inverse of rgbToXYZ[g]
+     *   transform[src][dst] linear RGB of src -> linear RGB of dst, with
+     *                      Bradford adaptation when the white points differ
+     */
+    struct GamutMatrices {
+        mat3 rgbToXYZ[kGamutCount];
+        mat3 xyzToRGB[kGamutCount];
+        mat3 transform[kGamutCount][kGamutCount];
+    };
+
+    constexpr GamutMatrices computeGamutMatrices() {
+        GamutMatrices m;
+        for (size_t g = 0; g < kGamutCount; g++) {
+            m.rgbToXYZ[g] = ColorSpace::computeXYZMatrix(
+                    kGamutPrimaries[g].primaries, kGamutPrimaries[g].whitePoint);
+            m.xyzToRGB[g] = inverse(m.rgbToXYZ[g]);
+        }
+        for (size_t src = 0; src < kGamutCount; src++) {
+            for (size_t dst = 0; dst < kGamutCount; dst++) {
+                m.transform[src][dst] = ColorSpace::computeTransform(
+                        m.rgbToXYZ[src], kGamutPrimaries[src].whitePoint,
+                        m.rgbToXYZ[dst], kGamutPrimaries[dst].whitePoint);
+            }
+        }
+        return m;
+    }
+
+    /**
+     * Generated at compile time: no matrix math happens at startup.
+     */
+    constexpr GamutMatrices kGamutMatrices = computeGamutMatrices();
+
+    constexpr const mat3& gamutToXYZ(Gamut g) {
+        return kGamutMatrices.rgbToXYZ[static_cast<size_t>(g)];
+    }
+
+    constexpr const mat3& xyzToGamut(Gamut g) {
+        return kGamutMatrices.xyzToRGB[static_cast<size_t>(g)];
+    }
+
+    constexpr const mat3& gamutTransform(Gamut src, Gamut dst) {
+        return kGamutMatrices.transform[static_cast<size_t>(src)][static_cast<size_t>(dst)];
+    }
+
+}; // namespace android
+
+#endif // ANDROID_UI_COLOR_SPACE_MATRICES
@@ -182,12 +182,24 @@ static bool TransformR8G8B8A8(uint8_t* dst, uint8_t *src,
   return true;
 }
 
+/*
+ * ToMathfuMat3()
+ *    Copy a (compile-time computed) android::mat3 into a mathfu::mat3;
+ *    both are column major.
+ */
+static mathfu::mat3 ToMathfuMat3(const android::mat3& m) {
+  return mathfu::mat3(m[0].x, m[0].y, m[0].z,
+                      m[1].x, m[1].y, m[1].z,
+                      m[2].x, m[2].y, m[2].z);
+}
+
 /*
  * Interface Function:
  *     Convert Color Spaces
  */
 bool TransformColorSpace(IMAGE_FORMAT &dst, IMAGE_FORMAT& src) {
-  if (!src.npm_  || !dst.npm_ || !dst.buf_ || !src.buf_) {
+  if (src.gamut_ >= android::Gamut::COUNT ||
+      dst.gamut_ >= android::Gamut::COUNT || !dst.buf_ || !src.buf_) {
     LOGE("=====Error: Invalid Parameters to TransformColorSpace()");
     return false;
   }
@@ -200,7 +212,8 @@ bool TransformColorSpace(IMAGE_FORMAT &dst, IMAGE_FORMAT& src) {
     srcBits = dstBits;
   }
 
-  mathfu::mat3 matrix = *dst.npm_ * (*src.npm_);
+  mathfu::mat3 matrix =
+      ToMathfuMat3(android::gamutTransform(src.gamut_, dst.gamut_));
   TransformR8G8B8A8(dstBits, srcBits, src.width_, src.height_, matrix);
 
   if (HAS_GAMMA(dst.gamma_)) {
@@ -209,47 +222,3 @@ bool TransformColorSpace(IMAGE_FORMAT &dst, IMAGE_FORMAT& src) {
 
   return true;
 }
-
-
-/*
- * Default NPMs with white reference points as D65
- * The array sequence should match enum NPM_TYPE definition
-    enum NPM_TYPE {
-      SRGB_D65 = 0,
-      SRGB_D65_INV,
-      P3_D65,
-      P3_D65_INV,
-      TYPE_COUNT
-   };
- */
-static mathfu::mat3 defaultNPMs[] =  {
-    /* SRGB --> XYZ, White reference point D65
-     *    Digital Video and HDTV
-     *         Algorithms and Interfaces
-     *      Charles Poynton
-     */
-    mathfu::mat3(0.4123908281f, 0.2126390338f, 0.0193308201f,
-                 0.3575843275f, 0.7151686549f, 0.1191947237f,
-                 0.1804807931f, 0.0721923113f, 0.9505321383f),
-    // XYZ --> SRGB white reference point D65
-    mathfu::mat3( 3.2409696579f, -0.9692436457f, 0.0556300320f,
-                  -1.5373830795f, 1.8759675026f, -0.2039768547f,
-                  -0.4986107349f, 0.0415550880f, 1.0569714308f),
-    /* P3 --> XYZ, white reference point D65
-    *     SMTP EG 432-1:2010, p23
-    */
-    mathfu::mat3(0.4865709245f, 0.2289745510f, 0.000000000f,
-                 0.2656676769f, 0.6917385459f, 0.0451133996f,
-                 0.1982172877f, 0.0792869106f, 1.0439443588f),
-    /*
-     * CIE XYZ --> Display P3, white reference point D65. Source
-     *     SMTP EG 432-1:2010, p24
-     */
-    mathfu::mat3(2.4934973717f, -0.8294889927f, 0.0358458459f,
-                 -0.9313836098f, 1.7626641989f, -0.0761724263f,
-                 -0.4027108550f, 0.0236246940f, 0.9568846226f),
-};
-const mathfu::mat3* GetTransformNPM(NPM_TYPE type) {
-  ASSERT(type < NPM_TYPE::TYPE_COUNT, "NPM_TYPE (%d) out of bounds", type);
-  return &defaultNPMs[type];
-}
@@ -20,12 +20,13 @@
 
 #include <cstdint>
 #include <mathfu/glsl_mappings.h>
+#include "ColorSpaceMatrices.h"
 
 struct IMAGE_FORMAT {
   void*       buf_;  // packed image pointer
   uint32_t    width_, height_;
   float       gamma_;
-  const mathfu::mat3* npm_;
+  android::Gamut gamut_;
 };
 
 #define DEFAULT_DISPLAY_GAMMA (1.0f/2.2f)
@@ -34,7 +35,7 @@ struct IMAGE_FORMAT {
 /*
  * TransformColorSpace(IMAGE_FORMAT& dst, IMAGE_FORMAT& src)
  *     Transforms image between DCI-P3 and sRGB space
- *     Dst.buf_ = dst.npm * src.npm * de-gamma(src.buf_)
+ *     Dst.buf_ = gamutTransform(src.gamut, dst.gamut) * de-gamma(src.buf_)
  *     dst.buf_ = en-gamma(dst.buf_)
  * dst.buf_:
  *     transformed image buf pointer; user must allocate enough space for the image
@@ -45,16 +46,4 @@ struct IMAGE_FORMAT {
  */
 bool TransformColorSpace(IMAGE_FORMAT &dst, IMAGE_FORMAT& src);
 
-/*
- * GetTransformNPM
- */
-enum NPM_TYPE {
-  SRGB_D65 = 0,
-  SRGB_D65_INV,
-  P3_D65,
-  P3_D65_INV,
-  TYPE_COUNT
-};
-const mathfu::mat3* GetTransformNPM(NPM_TYPE type);
-
 #endif // __COLOR_TRANSFORM_H__
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "CompressedTextureCache.h"
+#include "CacheFile.h"
+#include "CacheTrim.h"
+#include "android_debug.h"
+
+#define TEXTURE_CACHE_DIR      "textures"
+#define TEXTURE_FILE_SUFFIX    ".etc2"
+#define TEXTURE_FILE_MAGIC     "ETC2"
+#define TEXTURE_FILE_VERSION   4   // 1: P3 and sRGB views, 2: RGBA8 only,
+                                   // 3: keyed by asset size
+
+/*
+ * File layout: TEXTURE_FILE_HEADER followed by dataSize_ bytes of
+ * COMPRESSED_TEXTURE::data_. The key fields repeat the file name, which
+ * is only a lookup hint.
+ */
+struct TEXTURE_FILE_HEADER {
+  char     magic_[4];
+  uint32_t version_;
+  uint64_t contentHash_;
+  int32_t  space_;
+  uint32_t maxWidth_, maxHeight_;
+  uint32_t mipmaps_;
+  uint32_t width_, height_, levels_;
+  uint32_t alpha_;            // RGBA8 blocks, RGB8 otherwise
+  uint64_t dataSize_;
+};
+
+static std::string TextureCacheDir(const char* dir) {
+  std::string path(dir ? dir : "");
+  if (path.length() && path.back() != '/') {
+    path.push_back('/');
+  }
+  return path + TEXTURE_CACHE_DIR;
+}
+
+static std::mutex gTrimLock;   // workers save concurrently
+
+static std::string TextureFilePath(const char* dir,
+                                   const COMPRESSED_TEXTURE_KEY& key) {
+  std::string name(key.name_);
+  for (auto& ch : name) {
+    if (ch == '/') {
+      ch = '_';
+    }
+  }
+  char suffix[64];
+  snprintf(suffix, sizeof(suffix), ".%d.%ux%u%s" TEXTURE_FILE_SUFFIX,
+           key.space_, key.maxWidth_, key.maxHeight_,
+           key.mipmaps_ ? ".mip" : "");
+  return TextureCacheDir(dir) + "/" + name + suffix;
+}
+
+bool LoadCompressedTexture(const char* dir, const COMPRESSED_TEXTURE_KEY& key,
+                           COMPRESSED_TEXTURE* texture) {
+  std::string path = TextureFilePath(dir, key);
+  FILE* fp = fopen(path.c_str(), "rb");
+  if (!fp) {
+    return false;
+  }
+
+  TEXTURE_FILE_HEADER header;
+  bool valid = fread(&header, sizeof(header), 1, fp) == 1 &&
+               !memcmp(header.magic_, TEXTURE_FILE_MAGIC, 4) &&
+               header.version_ == TEXTURE_FILE_VERSION &&
+               header.contentHash_ == key.contentHash_ &&
+               header.space_ == key.space_ &&
+               header.maxWidth_ == key.maxWidth_ &&
+               header.maxHeight_ == key.maxHeight_ &&
+               header.mipmaps_ == (key.mipmaps_ ? 1u : 0u) &&
+               header.levels_ >= 1 && header.levels_ <= 32;
+  if (valid) {
+    texture->width_ = header.width_;
+    texture->height_ = header.height_;
+    texture->levels_ = header.levels_;
+    texture->alpha_ = (header.alpha_ != 0);
+    valid = header.dataSize_ == texture->Size();
+  }
+  if (valid) {
+    texture->data_.resize(header.dataSize_);
+    texture->memory_ = TrackedAllocation(MEMORY_CATEGORY::COMPRESSED_DATA,
+                                         key.name_, texture->data_.size());
+    valid = fread(texture->data_.data(), 1, texture->data_.size(), fp) ==
+            texture->data_.size();
+  }
+  if (valid) {
+    futimens(fileno(fp), nullptr);   // most recently used
+  }
+  fclose(fp);
+
+  if (!valid) {
+    LOGI("Compressed texture %s is stale", path.c_str());
+    unlink(path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool SaveCompressedTexture(const char* dir, const COMPRESSED_TEXTURE_KEY& key,
+                           const COMPRESSED_TEXTURE& texture) {
+  mkdir(TextureCacheDir(dir).c_str(), 0700);
+  std::string path = TextureFilePath(dir, key);
+  TEXTURE_FILE_HEADER header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic_, TEXTURE_FILE_MAGIC, 4);
+  header.version_ = TEXTURE_FILE_VERSION;
+  header.contentHash_ = key.contentHash_;
+  header.space_ = key.space_;
+  header.maxWidth_ = key.maxWidth_;
+  header.maxHeight_ = key.maxHeight_;
+  header.mipmaps_ = key.mipmaps_ ? 1 : 0;
+  header.width_ = texture.width_;
+  header.height_ = texture.height_;
+  header.levels_ = texture.levels_;
+  header.alpha_ = texture.alpha_ ? 1 : 0;
+  header.dataSize_ = texture.data_.size();
+  bool status = WriteCacheStream(path, [&header, &texture](FILE* fp) {
+    return fwrite(&header, sizeof(header), 1, fp) == 1 &&
+           fwrite(texture.data_.data(), 1, texture.data_.size(), fp) ==
+               texture.data_.size();
+  });
+  if (!status) {
+    LOGW("Cannot write compressed texture %s", path.c_str());
+    return false;
+  }
+  std::lock_guard<std::mutex> guard(gTrimLock);
+  TrimCacheDir(TextureCacheDir(dir), TEXTURE_FILE_SUFFIX,
+               kCompressedCacheBudget);
+  return true;
+}
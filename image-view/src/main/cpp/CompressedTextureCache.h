@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __COMPRESSED_TEXTURE_CACHE_H__
+#define __COMPRESSED_TEXTURE_CACHE_H__
+
+#include <string>
+#include <vector>
+#include "common.h"
+#include "Etc2Codec.h"
+#include "MemoryTracker.h"
+
+/*
+ * ETC2 data of a texture, an Etc2ChainSize() mip chain: RGBA8 blocks with
+ * alpha_, RGB8 ones for opaque images
+ */
+struct COMPRESSED_TEXTURE {
+  uint32_t width_, height_, levels_;
+  bool alpha_ = true;
+  std::vector<uint8_t> data_;
+  TrackedAllocation memory_;   // COMPRESSED_DATA bytes of data_
+
+  size_t Size(void) const {
+    return Etc2ChainSize(width_, height_, levels_, alpha_);
+  }
+};
+
+/*
+ * What the compressed data was made from; a file written for another key
+ * is not used
+ */
+struct COMPRESSED_TEXTURE_KEY {
+  std::string name_;          // asset
+  uint64_t contentHash_;      // AssetContentHash() of the asset
+  DISPLAY_COLORSPACE space_;
+  uint32_t maxWidth_, maxHeight_;   // decode-time downscale limits
+  bool mipmaps_;
+};
+
+/*
+ * Compressed textures persisted under dir/textures, so that later launches
+ * upload them without decoding or transforming the images. The directory
+ * is kept under kCompressedCacheBudget bytes, least recently used files
+ * (by modification time, refreshed on every hit) going first: every window
+ * size writes a set of its own.
+ */
+constexpr size_t kCompressedCacheBudget = 256 * 1024 * 1024;
+
+bool LoadCompressedTexture(const char* dir, const COMPRESSED_TEXTURE_KEY& key,
+                           COMPRESSED_TEXTURE* texture);
+bool SaveCompressedTexture(const char* dir, const COMPRESSED_TEXTURE_KEY& key,
+                           const COMPRESSED_TEXTURE& texture);
+
+#endif // __COMPRESSED_TEXTURE_CACHE_H__
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <sys/system_properties.h>
+
+#include "DisplayCapsCache.h"
+#include "CacheFile.h"
+#include "android_debug.h"
+
+#define CAPS_FILE_NAME     "display_caps.bin"
+#define CAPS_FILE_MAGIC    "WCAP"
+#define CAPS_FILE_VERSION  1
+
+/*
+ * File layout: CAPS_FILE_HEADER followed by fingerprintSize_ bytes of
+ * fingerprint (no terminator).
+ */
+struct CAPS_FILE_HEADER {
+  char     magic_[4];
+  uint32_t version_;
+  int32_t  mode_;
+  int32_t  configId_;
+  uint32_t extBits_;
+  uint32_t fingerprintSize_;
+};
+
+static std::string CapsFilePath(const char* dir) {
+  std::string path(dir ? dir : "");
+  if (path.length() && path.back() != '/') {
+    path.push_back('/');
+  }
+  return path + CAPS_FILE_NAME;
+}
+
+/*
+ * 64 bit FNV-1a: the extension string is long, only its identity matters
+ */
+static uint64_t HashString(const char* str) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  while (str && *str) {
+    hash ^= static_cast<uint8_t>(*str++);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+std::string GetDisplayFingerprint(EGLDisplay display) {
+  std::string fingerprint;
+  // OS build and (updatable) graphics driver
+  const char* props[] = {
+      "ro.build.fingerprint",
+      "ro.hardware.egl",
+      "ro.gfx.driver.0",
+  };
+  for (auto prop : props) {
+    char value[PROP_VALUE_MAX] = {0,};
+    __system_property_get(prop, value);
+    fingerprint += value;
+    fingerprint += '|';
+  }
+
+  const char* vendor = eglQueryString(display, EGL_VENDOR);
+  const char* version = eglQueryString(display, EGL_VERSION);
+  fingerprint += vendor ? vendor : "";
+  fingerprint += '|';
+  fingerprint += version ? version : "";
+  fingerprint += '|';
+
+  char extHash[24];
+  snprintf(extHash, sizeof(extHash), "%016llx", static_cast<unsigned long long>(
+      HashString(eglQueryString(display, EGL_EXTENSIONS))));
+  fingerprint += extHash;
+  return fingerprint;
+}
+
+bool LoadDisplayCaps(const char* dir, const std::string& fingerprint,
+                     DISPLAY_CAPS* caps) {
+  std::string path = CapsFilePath(dir);
+  FILE* fp = fopen(path.c_str(), "rb");
+  if (!fp) {
+    return false;
+  }
+
+  CAPS_FILE_HEADER header;
+  bool valid = fread(&header, sizeof(header), 1, fp) == 1 &&
+               !memcmp(header.magic_, CAPS_FILE_MAGIC, 4) &&
+               header.version_ == CAPS_FILE_VERSION &&
+               header.fingerprintSize_ == fingerprint.length();
+  if (valid) {
+    std::string stored(header.fingerprintSize_, '\0');
+    valid = fread(&stored[0], 1, stored.length(), fp) == stored.length() &&
+            stored == fingerprint;
+  }
+  fclose(fp);
+
+  if (!valid) {
+    LOGI("Display caps cache %s is stale", path.c_str());
+    return false;
+  }
+  caps->mode_ = header.mode_;
+  caps->configId_ = header.configId_;
+  caps->extBits_ = header.extBits_;
+  caps->fingerprint_ = fingerprint;
+  return true;
+}
+
+bool SaveDisplayCaps(const char* dir, const DISPLAY_CAPS& caps) {
+  std::string path = CapsFilePath(dir);
+  CAPS_FILE_HEADER header;
+  memcpy(header.magic_, CAPS_FILE_MAGIC, 4);
+  header.version_ = CAPS_FILE_VERSION;
+  header.mode_ = caps.mode_;
+  header.configId_ = caps.configId_;
+  header.extBits_ = caps.extBits_;
+  header.fingerprintSize_ = static_cast<uint32_t>(caps.fingerprint_.length());
+  bool status = WriteCacheStream(path, [&header, &caps](FILE* fp) {
+    return fwrite(&header, sizeof(header), 1, fp) == 1 &&
+           fwrite(caps.fingerprint_.data(), 1, caps.fingerprint_.length(),
+                  fp) == caps.fingerprint_.length();
+  });
+  if (!status) {
+    LOGW("Cannot write display caps cache %s", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+void InvalidateDisplayCaps(const char* dir) {
+  unlink(CapsFilePath(dir).c_str());
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __DISPLAY_CAPS_CACHE_H__
+#define __DISPLAY_CAPS_CACHE_H__
+
+#include <string>
+#include <EGL/egl.h>
+
+// Extension bits recorded in DISPLAY_CAPS::extBits_
+#define DISPLAY_CAPS_EXT_P3           0x01
+#define DISPLAY_CAPS_EXT_PASSTHROUGH  0x02
+
+/*
+ * Result of the wide color probe for this device, persisted in the app's
+ * internal storage so that later launches create the context on the first
+ * attempt.
+ */
+struct DISPLAY_CAPS {
+  int32_t mode_;              // ImageViewEngine::WIDECOLOR_MODE
+  EGLint configId_;           // EGL_CONFIG_ID of the chosen config
+  uint32_t extBits_;          // DISPLAY_CAPS_EXT_xxx
+  std::string fingerprint_;   // GetDisplayFingerprint() when probed
+};
+
+/*
+ * OS build + EGL driver identity. A cache written under a different
+ * fingerprint is stale.
+ */
+std::string GetDisplayFingerprint(EGLDisplay display);
+
+/*
+ * LoadDisplayCaps()
+ *    Returns false when there is no cache, it has another version, or was
+ *    written for another fingerprint.
+ */
+bool LoadDisplayCaps(const char* dir, const std::string& fingerprint,
+                     DISPLAY_CAPS* caps);
+bool SaveDisplayCaps(const char* dir, const DISPLAY_CAPS& caps);
+void InvalidateDisplayCaps(const char* dir);
+
+#endif // __DISPLAY_CAPS_CACHE_H__
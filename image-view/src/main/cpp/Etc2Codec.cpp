@@ -0,0 +1,362 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+#include "Etc2Codec.h"
+
+#define CLIP_COLOR(color, max) ((color > max) ? max : ((color > 0) ? color : 0))
+
+/*
+ * Modifier tables from the ETC2 specification (OpenGL ES 3.0, C.1):
+ * color intensity modifiers {a, b} giving -b, -a, +a, +b, and the
+ * EAC alpha modifiers
+ */
+static const int32_t kColorModifiers[8][2] = {
+    {2, 8}, {5, 17}, {9, 29}, {13, 42},
+    {18, 60}, {24, 80}, {33, 106}, {47, 183},
+};
+// pixel index (msb << 1 | lsb) -> modifier
+static const int32_t kColorIndexSign[4][2] = {
+    {1, 0}, {1, 1}, {-1, 0}, {-1, 1},    // {sign, 0: a / 1: b}
+};
+static const int32_t kAlphaModifiers[16][8] = {
+    {-3, -6,  -9, -15, 2, 5, 8, 14},
+    {-3, -7, -10, -13, 2, 6, 9, 12},
+    {-2, -5,  -8, -13, 1, 4, 7, 12},
+    {-2, -4,  -6, -13, 1, 3, 5, 12},
+    {-3, -6,  -8, -12, 2, 5, 7, 11},
+    {-3, -7,  -9, -11, 2, 6, 8, 10},
+    {-4, -7,  -8, -11, 3, 6, 7, 10},
+    {-3, -5,  -8, -11, 2, 4, 7, 10},
+    {-2, -6,  -8, -10, 1, 5, 7,  9},
+    {-2, -5,  -8, -10, 1, 4, 7,  9},
+    {-2, -4,  -8, -10, 1, 3, 7,  9},
+    {-2, -5,  -7, -10, 1, 4, 6,  9},
+    {-3, -4,  -7, -10, 2, 3, 6,  9},
+    {-1, -2,  -3, -10, 0, 1, 2,  9},
+    {-4, -6,  -8,  -9, 3, 5, 7,  8},
+    {-3, -5,  -7,  -9, 2, 4, 6,  8},
+};
+#define ALPHA_EXACT_TABLE 13    // kAlphaModifiers[13][4] == 0
+#define ALPHA_EXACT_INDEX 4
+
+/*
+ * BLOCK
+ *    4x4 RGBA pixels, pixel (x, y) at [x * 4 + y]: the ETC2 pixel index
+ *    order
+ */
+struct BLOCK {
+  uint8_t px_[16][4];
+};
+
+static inline int32_t Modifier(uint32_t table, uint32_t index) {
+  return kColorIndexSign[index][0] * kColorModifiers[table][kColorIndexSign[index][1]];
+}
+
+static inline uint8_t Expand4(uint32_t c) { return static_cast<uint8_t>((c << 4) | c); }
+static inline uint8_t Expand5(uint32_t c) { return static_cast<uint8_t>((c << 3) | (c >> 2)); }
+
+static void WriteBigEndian(uint64_t bits, uint8_t* dst) {
+  for (int idx = 7; idx >= 0; idx--) {
+    dst[idx] = static_cast<uint8_t>(bits);
+    bits >>= 8;
+  }
+}
+static uint64_t ReadBigEndian(const uint8_t* src) {
+  uint64_t bits = 0;
+  for (int idx = 0; idx < 8; idx++) {
+    bits = (bits << 8) | src[idx];
+  }
+  return bits;
+}
+
+/*
+ * Sub-blocks: flip 0 splits the block in 2x4 left/right halves, flip 1 in
+ * 4x2 top/bottom halves
+ */
+static inline uint32_t SubBlock(uint32_t pixel, uint32_t flip) {
+  uint32_t x = pixel >> 2, y = pixel & 3;
+  return flip ? (y >> 1) : (x >> 1);
+}
+
+/*
+ * FitSubBlock()
+ *    Best table and pixel indices for a sub-block around a base color;
+ *    returns the squared error
+ */
+static uint32_t FitSubBlock(const BLOCK& block, uint32_t flip, uint32_t sub,
+                            const int32_t base[3], uint32_t* table,
+                            uint32_t indices[16]) {
+  uint32_t bestError = UINT_MAX;
+  for (uint32_t t = 0; t < 8; t++) {
+    uint32_t error = 0;
+    uint32_t tableIndices[16];
+    for (uint32_t p = 0; p < 16 && error < bestError; p++) {
+      if (SubBlock(p, flip) != sub) {
+        continue;
+      }
+      uint32_t bestPixel = UINT_MAX;
+      for (uint32_t i = 0; i < 4; i++) {
+        int32_t mod = Modifier(t, i);
+        uint32_t e = 0;
+        for (uint32_t c = 0; c < 3; c++) {
+          int32_t v = CLIP_COLOR(base[c] + mod, 255) - block.px_[p][c];
+          e += static_cast<uint32_t>(v * v);
+        }
+        if (e < bestPixel) {
+          bestPixel = e;
+          tableIndices[p] = i;
+        }
+      }
+      error += bestPixel;
+    }
+    if (error < bestError) {
+      bestError = error;
+      *table = t;
+      for (uint32_t p = 0; p < 16; p++) {
+        if (SubBlock(p, flip) == sub) {
+          indices[p] = tableIndices[p];
+        }
+      }
+    }
+  }
+  return bestError;
+}
+
+static uint64_t EncodeColor(const BLOCK& block) {
+  uint64_t bestBits = 0;
+  uint32_t bestError = UINT_MAX;
+  for (uint32_t flip = 0; flip < 2; flip++) {
+    // average color of each half
+    int32_t sum[2][3] = {};
+    for (uint32_t p = 0; p < 16; p++) {
+      for (uint32_t c = 0; c < 3; c++) {
+        sum[SubBlock(p, flip)][c] += block.px_[p][c];
+      }
+    }
+
+    for (uint32_t diff = 0; diff < 2; diff++) {
+      uint32_t q[2][3];
+      int32_t base[2][3];
+      bool valid = true;
+      for (uint32_t c = 0; c < 3; c++) {
+        for (uint32_t s = 0; s < 2; s++) {
+          // 8 pixels per half, rounded to 4 or 5 bits
+          q[s][c] = diff ? (sum[s][c] * 31 + 1020) / 2040
+                         : (sum[s][c] * 15 + 1020) / 2040;
+        }
+        if (diff) {
+          int32_t d = static_cast<int32_t>(q[1][c]) - static_cast<int32_t>(q[0][c]);
+          if (d < -4 || d > 3) {
+            valid = false;    // would turn into a T, H or planar block
+          }
+        }
+        for (uint32_t s = 0; s < 2; s++) {
+          base[s][c] = diff ? Expand5(q[s][c]) : Expand4(q[s][c]);
+        }
+      }
+      if (!valid) {
+        continue;
+      }
+
+      uint32_t tables[2], indices[16];
+      uint32_t error = FitSubBlock(block, flip, 0, base[0], &tables[0], indices);
+      if (error >= bestError) {
+        continue;
+      }
+      error += FitSubBlock(block, flip, 1, base[1], &tables[1], indices);
+      if (error >= bestError) {
+        continue;
+      }
+
+      uint64_t bits = 0;
+      for (uint32_t c = 0; c < 3; c++) {
+        uint64_t field = diff ?
+            ((q[0][c] << 3) | ((q[1][c] - q[0][c]) & 7)) :
+            ((q[0][c] << 4) | q[1][c]);
+        bits |= field << (56 - c * 8);
+      }
+      bits |= static_cast<uint64_t>(tables[0]) << 37;
+      bits |= static_cast<uint64_t>(tables[1]) << 34;
+      bits |= static_cast<uint64_t>(diff) << 33;
+      bits |= static_cast<uint64_t>(flip) << 32;
+      for (uint32_t p = 0; p < 16; p++) {
+        bits |= static_cast<uint64_t>(indices[p] >> 1) << (16 + p);
+        bits |= static_cast<uint64_t>(indices[p] & 1) << p;
+      }
+      bestError = error;
+      bestBits = bits;
+    }
+  }
+  return bestBits;
+}
+
+static uint64_t EncodeAlpha(const BLOCK& block) {
+  int32_t minA = 255, maxA = 0;
+  for (uint32_t p = 0; p < 16; p++) {
+    minA = std::min(minA, static_cast<int32_t>(block.px_[p][3]));
+    maxA = std::max(maxA, static_cast<int32_t>(block.px_[p][3]));
+  }
+  if (minA == maxA) {
+    // exact: multiplier 1 with the table holding a zero modifier
+    uint64_t bits = static_cast<uint64_t>(minA) << 56 | 1ull << 52 |
+                    static_cast<uint64_t>(ALPHA_EXACT_TABLE) << 48;
+    for (uint32_t p = 0; p < 16; p++) {
+      bits |= static_cast<uint64_t>(ALPHA_EXACT_INDEX) << (45 - p * 3);
+    }
+    return bits;
+  }
+
+  uint64_t bestBits = 0;
+  uint32_t bestError = UINT_MAX;
+  for (int32_t t = 0; t < 16; t++) {
+    const int32_t* mods = kAlphaModifiers[t];
+    int32_t span = mods[7] - mods[3];
+    int32_t mult = (maxA - minA + span / 2) / span;
+    for (int32_t m = std::max(1, mult - 1); m <= std::min(15, mult + 1); m++) {
+      {
+        int32_t center = (minA + maxA + 1) / 2 - (mods[3] + mods[7]) * m / 2;
+        int32_t base = CLIP_COLOR(center, 255);
+        uint32_t error = 0;
+        uint64_t indices = 0;
+        for (uint32_t p = 0; p < 16 && error < bestError; p++) {
+          uint32_t bestPixel = UINT_MAX, bestIndex = 0;
+          for (uint32_t i = 0; i < 8; i++) {
+            int32_t v = CLIP_COLOR(base + mods[i] * m, 255) - block.px_[p][3];
+            if (static_cast<uint32_t>(v * v) < bestPixel) {
+              bestPixel = static_cast<uint32_t>(v * v);
+              bestIndex = i;
+            }
+          }
+          error += bestPixel;
+          indices |= static_cast<uint64_t>(bestIndex) << (45 - p * 3);
+        }
+        if (error < bestError) {
+          bestError = error;
+          bestBits = static_cast<uint64_t>(base) << 56 |
+                     static_cast<uint64_t>(m) << 52 |
+                     static_cast<uint64_t>(t) << 48 | indices;
+        }
+      }
+    }
+  }
+  return bestBits;
+}
+
+size_t Etc2ImageSize(uint32_t width, uint32_t height, bool alpha) {
+  return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) *
+         (alpha ? ETC2_BLOCK_SIZE : ETC2_RGB_BLOCK_SIZE);
+}
+
+size_t Etc2ChainSize(uint32_t width, uint32_t height, uint32_t levels,
+                     bool alpha) {
+  size_t size = 0;
+  for (uint32_t level = 0; level < levels; level++) {
+    size += Etc2ImageSize(width, height, alpha);
+    width = std::max(1u, width >> 1);
+    height = std::max(1u, height >> 1);
+  }
+  return size;
+}
+
+void EncodeEtc2Rgba8(const uint8_t* src, uint32_t width, uint32_t height,
+                     uint8_t* dst, bool alpha) {
+  BLOCK block;
+  for (uint32_t by = 0; by < height; by += 4) {
+    for (uint32_t bx = 0; bx < width; bx += 4) {
+      for (uint32_t p = 0; p < 16; p++) {
+        uint32_t x = std::min(bx + (p >> 2), width - 1);
+        uint32_t y = std::min(by + (p & 3), height - 1);
+        const uint8_t* px = src + (static_cast<size_t>(y) * width + x) * 4;
+        std::copy(px, px + 4, block.px_[p]);
+      }
+      if (alpha) {
+        WriteBigEndian(EncodeAlpha(block), dst);
+        dst += 8;
+      }
+      WriteBigEndian(EncodeColor(block), dst);
+      dst += 8;
+    }
+  }
+}
+
+void EncodeEtc2Chain(const uint8_t* src, uint32_t width, uint32_t height,
+                     uint32_t levels, uint8_t* dst, bool alpha) {
+  for (uint32_t level = 0; level < levels; level++) {
+    EncodeEtc2Rgba8(src, width, height, dst, alpha);
+    src += static_cast<size_t>(width) * height * 4;
+    dst += Etc2ImageSize(width, height, alpha);
+    width = std::max(1u, width >> 1);
+    height = std::max(1u, height >> 1);
+  }
+}
+
+bool DecodeEtc2Rgba8(const uint8_t* src, uint32_t width, uint32_t height,
+                     uint8_t* dst) {
+  for (uint32_t by = 0; by < height; by += 4) {
+    for (uint32_t bx = 0; bx < width; bx += 4) {
+      uint64_t alpha = ReadBigEndian(src);
+      uint64_t color = ReadBigEndian(src + 8);
+      src += ETC2_BLOCK_SIZE;
+
+      uint32_t diff = (color >> 33) & 1, flip = (color >> 32) & 1;
+      int32_t base[2][3];
+      for (uint32_t c = 0; c < 3; c++) {
+        uint32_t field = (color >> (56 - c * 8)) & 0xff;
+        if (diff) {
+          int32_t c0 = field >> 3;
+          int32_t d = static_cast<int32_t>(field & 7) - ((field & 4) ? 8 : 0);
+          if (c0 + d < 0 || c0 + d > 31) {
+            return false;
+          }
+          base[0][c] = Expand5(c0);
+          base[1][c] = Expand5(c0 + d);
+        } else {
+          base[0][c] = Expand4(field >> 4);
+          base[1][c] = Expand4(field & 0xf);
+        }
+      }
+      uint32_t tables[2] = {
+          static_cast<uint32_t>((color >> 37) & 7),
+          static_cast<uint32_t>((color >> 34) & 7)
+      };
+      int32_t alphaBase = static_cast<int32_t>(alpha >> 56);
+      int32_t mult = static_cast<int32_t>((alpha >> 52) & 0xf);
+      const int32_t* alphaMods = kAlphaModifiers[(alpha >> 48) & 0xf];
+
+      for (uint32_t p = 0; p < 16; p++) {
+        uint32_t x = bx + (p >> 2), y = by + (p & 3);
+        if (x >= width || y >= height) {
+          continue;
+        }
+        uint32_t sub = SubBlock(p, flip);
+        uint32_t index = static_cast<uint32_t>(((color >> (16 + p)) & 1) << 1 |
+                                               ((color >> p) & 1));
+        int32_t mod = Modifier(tables[sub], index);
+        uint8_t* px = dst + (static_cast<size_t>(y) * width + x) * 4;
+        for (uint32_t c = 0; c < 3; c++) {
+          px[c] = static_cast<uint8_t>(CLIP_COLOR(base[sub][c] + mod, 255));
+        }
+        int32_t a = alphaBase + alphaMods[(alpha >> (45 - p * 3)) & 7] * mult;
+        px[3] = static_cast<uint8_t>(CLIP_COLOR(a, 255));
+      }
+    }
+  }
+  return true;
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __ETC2_CODEC_H__
+#define __ETC2_CODEC_H__
+
+#include <cstddef>
+#include <cstdint>
+
+// One 4x4 block of GL_COMPRESSED_RGBA8_ETC2_EAC: EAC alpha + ETC2 color
+#define ETC2_BLOCK_SIZE 16
+// One 4x4 block of GL_COMPRESSED_RGB8_ETC2: the color half alone
+#define ETC2_RGB_BLOCK_SIZE 8
+
+/*
+ * Sizes of ETC2 RGBA8 images (RGB8 without alpha), and of mip chains laid
+ * out like MipChainSize(): level 0 first, each level half the previous one
+ */
+size_t Etc2ImageSize(uint32_t width, uint32_t height, bool alpha = true);
+size_t Etc2ChainSize(uint32_t width, uint32_t height, uint32_t levels,
+                     bool alpha = true);
+
+/*
+ * EncodeEtc2Rgba8()
+ *     Compresses an R8G8B8A8 image (any size; edge blocks are padded by
+ *     repeating pixels) to GL_COMPRESSED_RGBA8_ETC2_EAC blocks, which are
+ *     also valid GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC data. Color uses the
+ *     ETC1 compatible individual / differential modes with both flips,
+ *     alpha a searched EAC block; values are compared as stored (no gamma).
+ *     Without alpha the blocks are the color halves only, which makes
+ *     GL_COMPRESSED_RGB8_ETC2 (and GL_COMPRESSED_SRGB8_ETC2) data for
+ *     opaque images at half the size.
+ *     Thread safe.
+ */
+void EncodeEtc2Rgba8(const uint8_t* src, uint32_t width, uint32_t height,
+                     uint8_t* dst, bool alpha = true);
+// src in MipChainSize() layout, dst in Etc2ChainSize() layout
+void EncodeEtc2Chain(const uint8_t* src, uint32_t width, uint32_t height,
+                     uint32_t levels, uint8_t* dst, bool alpha = true);
+
+/*
+ * DecodeEtc2Rgba8()
+ *     Reference decoder for the blocks EncodeEtc2Rgba8() produces, for
+ *     quality measurements. Returns false on the T, H and planar color
+ *     modes, which it does not implement.
+ */
+bool DecodeEtc2Rgba8(const uint8_t* src, uint32_t width, uint32_t height,
+                     uint8_t* dst);
+
+#endif // __ETC2_CODEC_H__
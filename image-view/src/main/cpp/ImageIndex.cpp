@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <cstdio>
+#include <cstring>
+#include <unordered_set>
+
+#include "ImageIndex.h"
+#include "CacheFile.h"
+#include "ImageScaler.h"
+#include "android_debug.h"
+
+#define INDEX_FILE_NAME     "image_index.bin"
+#define INDEX_FILE_MAGIC    "IIDX"
+#define INDEX_FILE_VERSION  1
+
+/*
+ * File layout: INDEX_FILE_HEADER, then count_ records, each an
+ * INDEX_RECORD_HEADER, nameSize_ bytes of asset name (no terminator) and
+ * the thumbnail (thumbnailSize_ squared R8G8B8A8 pixels)
+ */
+struct INDEX_FILE_HEADER {
+  char     magic_[4];
+  uint32_t version_;
+  uint32_t count_;
+  uint32_t thumbnailSize_;
+};
+
+struct INDEX_RECORD_HEADER {
+  int64_t  assetSize_;
+  uint32_t width_, height_;
+  uint32_t profile_;          // PNG_PROFILE
+  uint32_t nameSize_;
+};
+
+static constexpr size_t kThumbnailBytes =
+    IMAGE_RECORD::kThumbnailSize * IMAGE_RECORD::kThumbnailSize * 4;
+
+ImageIndex::ImageIndex() :
+    dirty_(false), memory_(MEMORY_CATEGORY::IMAGE_INDEX, "", 0) {
+}
+
+/*
+ * Load()
+ *    The file is read in one go and parsed from memory; a file of another
+ *    version or a truncated one is dropped as a whole (the loader indexes
+ *    the images again).
+ */
+bool ImageIndex::Load(const std::string& dir) {
+  std::lock_guard<std::mutex> guard(lock_);
+  path_ = dir;
+  if (path_.length() && path_.back() != '/') {
+    path_.push_back('/');
+  }
+  path_ += INDEX_FILE_NAME;
+  records_.clear();
+  dirty_ = false;
+
+  std::vector<uint8_t> file;
+  FILE* fp = fopen(path_.c_str(), "rb");
+  if (fp) {
+    if (!fseek(fp, 0, SEEK_END)) {
+      long size = ftell(fp);
+      if (size > 0 && !fseek(fp, 0, SEEK_SET)) {
+        file.resize(static_cast<size_t>(size));
+        if (fread(file.data(), 1, file.size(), fp) != file.size()) {
+          file.clear();
+        }
+      }
+    }
+    fclose(fp);
+  }
+
+  INDEX_FILE_HEADER header;
+  bool valid = file.size() >= sizeof(header);
+  if (valid) {
+    memcpy(&header, file.data(), sizeof(header));
+    valid = !memcmp(header.magic_, INDEX_FILE_MAGIC, 4) &&
+            header.version_ == INDEX_FILE_VERSION &&
+            header.thumbnailSize_ == IMAGE_RECORD::kThumbnailSize;
+  }
+  size_t offset = sizeof(header);
+  for (uint32_t idx = 0; valid && idx < header.count_; idx++) {
+    INDEX_RECORD_HEADER info;
+    valid = file.size() - offset >= sizeof(info);
+    if (!valid) {
+      break;
+    }
+    memcpy(&info, file.data() + offset, sizeof(info));
+    offset += sizeof(info);
+    valid = info.profile_ <= PNG_PROFILE_ICC &&
+            file.size() - offset >= info.nameSize_ + kThumbnailBytes;
+    if (!valid) {
+      break;
+    }
+    std::string name(reinterpret_cast<const char*>(file.data() + offset),
+                     info.nameSize_);
+    offset += info.nameSize_;
+    auto record = std::make_shared<IMAGE_RECORD>();
+    record->assetSize_ = info.assetSize_;
+    record->width_ = info.width_;
+    record->height_ = info.height_;
+    record->profile_ = static_cast<PNG_PROFILE>(info.profile_);
+    record->thumbnail_.assign(file.data() + offset,
+                              file.data() + offset + kThumbnailBytes);
+    offset += kThumbnailBytes;
+    records_[name] = record;
+  }
+
+  if (!valid) {
+    if (!file.empty()) {
+      LOGI("Image index %s is stale", path_.c_str());
+    }
+    records_.clear();
+  }
+  UpdateMemory();
+  return valid;
+}
+
+bool ImageIndex::Save(void) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (!dirty_ || path_.empty()) {
+    return true;
+  }
+  bool status = WriteCacheStream(path_, [this](FILE* fp) {
+    INDEX_FILE_HEADER header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic_, INDEX_FILE_MAGIC, 4);
+    header.version_ = INDEX_FILE_VERSION;
+    header.count_ = static_cast<uint32_t>(records_.size());
+    header.thumbnailSize_ = IMAGE_RECORD::kThumbnailSize;
+    bool status = fwrite(&header, sizeof(header), 1, fp) == 1;
+    for (auto& entry : records_) {
+      const IMAGE_RECORD& record = *entry.second;
+      INDEX_RECORD_HEADER info;
+      memset(&info, 0, sizeof(info));
+      info.assetSize_ = record.assetSize_;
+      info.width_ = record.width_;
+      info.height_ = record.height_;
+      info.profile_ = record.profile_;
+      info.nameSize_ = static_cast<uint32_t>(entry.first.length());
+      status = status && fwrite(&info, sizeof(info), 1, fp) == 1 &&
+               fwrite(entry.first.data(), 1, entry.first.length(), fp) ==
+                   entry.first.length() &&
+               fwrite(record.thumbnail_.data(), 1, kThumbnailBytes, fp) ==
+                   kThumbnailBytes;
+    }
+    return status;
+  });
+  if (!status) {
+    LOGW("Failed to write image index %s", path_.c_str());
+    return false;
+  }
+  dirty_ = false;
+  LOGI("Image index: %zu images saved", records_.size());
+  return true;
+}
+
+std::shared_ptr<const IMAGE_RECORD> ImageIndex::Find(const std::string& name) {
+  std::lock_guard<std::mutex> guard(lock_);
+  auto it = records_.find(name);
+  return (it != records_.end()) ? it->second : nullptr;
+}
+
+void ImageIndex::Add(const std::string& name,
+                     std::shared_ptr<const IMAGE_RECORD> record) {
+  ASSERT(record && record->thumbnail_.size() == kThumbnailBytes,
+         "Invalid image index record");
+  std::lock_guard<std::mutex> guard(lock_);
+  records_[name] = record;
+  dirty_ = true;
+  UpdateMemory();
+}
+
+void ImageIndex::Remove(const std::string& name) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (records_.erase(name)) {
+    dirty_ = true;
+    UpdateMemory();
+  }
+}
+
+void ImageIndex::Retain(const std::vector<std::string>& names) {
+  std::unordered_set<std::string> keep(names.begin(), names.end());
+  std::lock_guard<std::mutex> guard(lock_);
+  for (auto it = records_.begin(); it != records_.end();) {
+    if (keep.count(it->first)) {
+      ++it;
+    } else {
+      it = records_.erase(it);
+      dirty_ = true;
+    }
+  }
+  UpdateMemory();
+}
+
+size_t ImageIndex::Count(void) {
+  std::lock_guard<std::mutex> guard(lock_);
+  return records_.size();
+}
+
+/*
+ * MakeRecord()
+ *    A box filter in linear light, shrinking or (for images narrower than
+ *    the thumbnail) repeating pixels
+ */
+std::shared_ptr<const IMAGE_RECORD> ImageIndex::MakeRecord(
+    int64_t assetSize, uint32_t width, uint32_t height, PNG_PROFILE profile,
+    const uint8_t* pixels, uint32_t pixelsWidth, uint32_t pixelsHeight) {
+  auto record = std::make_shared<IMAGE_RECORD>();
+  record->assetSize_ = assetSize;
+  record->width_ = width;
+  record->height_ = height;
+  record->profile_ = profile;
+  record->thumbnail_.resize(kThumbnailBytes);
+  ScaleImageLinear(pixels, pixelsWidth, pixelsHeight,
+                   record->thumbnail_.data(), IMAGE_RECORD::kThumbnailSize,
+                   IMAGE_RECORD::kThumbnailSize);
+  return record;
+}
+
+// called with lock_ held
+void ImageIndex::UpdateMemory(void) {
+  size_t bytes = 0;
+  for (auto& entry : records_) {
+    bytes += entry.first.length() + sizeof(IMAGE_RECORD) +
+             entry.second->thumbnail_.size();
+  }
+  memory_.Resize(bytes);
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __IMAGE_INDEX_H__
+#define __IMAGE_INDEX_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "MemoryTracker.h"
+#include "PngRowReader.h"
+
+/*
+ * What the index knows about an image without decoding it: its size,
+ * the color profile its PNG declares (the viewer treats them all as
+ * Display P3) and a thumbnail_ of kThumbnailSize x kThumbnailSize
+ * R8G8B8A8 pixels, the whole image stretched as the viewer stretches it,
+ * in the asset's own (Display P3) encoding: P3 displays upload it as is,
+ * sRGB ones transform it first (AssetTexture::TransformPixels()).
+ */
+struct IMAGE_RECORD {
+  int64_t assetSize_;         // AssetFileSize() when indexed
+  uint32_t width_, height_;
+  PNG_PROFILE profile_;
+  std::vector<uint8_t> thumbnail_;
+
+  static constexpr uint32_t kThumbnailSize = 32;
+};
+
+/*
+ * ImageIndex
+ *    One record per asset, persisted in a single small file (dir/
+ *    image_index.bin) read whole at startup, so the first frame of any
+ *    image can show its thumbnail before a byte of the image itself is
+ *    read. Records are made once by the loader (TEXTURE_STAGE::INDEX) and
+ *    written back with Save(); an asset whose size changed is indexed
+ *    again. Thread safe.
+ */
+class ImageIndex {
+public:
+  ImageIndex();
+
+  bool Load(const std::string& dir);
+  // Writes the records when any changed since Load() or the last Save()
+  bool Save(void);
+
+  // nullptr when the asset is not indexed
+  std::shared_ptr<const IMAGE_RECORD> Find(const std::string& name);
+  void Add(const std::string& name, std::shared_ptr<const IMAGE_RECORD> record);
+  void Remove(const std::string& name);
+  // Drops the records of assets not in names
+  void Retain(const std::vector<std::string>& names);
+  size_t Count(void);
+
+  // The thumbnail of a streamed image, fitted (ScaleImageLinear()) from
+  // any R8G8B8A8 version of it, e.g. a PREVIEW image before its transform
+  static std::shared_ptr<const IMAGE_RECORD> MakeRecord(
+      int64_t assetSize, uint32_t width, uint32_t height, PNG_PROFILE profile,
+      const uint8_t* pixels, uint32_t pixelsWidth, uint32_t pixelsHeight);
+
+private:
+  void UpdateMemory(void);
+
+  std::string path_;
+  std::mutex lock_;
+  std::unordered_map<std::string, std::shared_ptr<const IMAGE_RECORD>> records_;
+  bool dirty_;
+  TrackedAllocation memory_;   // IMAGE_INDEX bytes of the thumbnails
+};
+
+#endif // __IMAGE_INDEX_H__
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "ImageScaler.h"
+#include "android_debug.h"
+
+// linear light -> 8 bit lookup resolution; fine enough for the darkest codes
+#define ENCODE_TABLE_BITS 14
+#define ENCODE_TABLE_SIZE (1 << ENCODE_TABLE_BITS)
+
+/*
+ * LINEAR_TABLES
+ *    sRGB transfer function lookups, built once
+ */
+struct LINEAR_TABLES {
+  float decode_[256];
+  uint8_t encode_[ENCODE_TABLE_SIZE];
+
+  LINEAR_TABLES() {
+    for (uint32_t idx = 0; idx < 256; idx++) {
+      double val = idx / 255.0;
+      decode_[idx] = static_cast<float>(
+          (val < 0.04045) ? val / 12.92 : pow((val + 0.055) / 1.055, 2.4));
+    }
+    for (uint32_t idx = 0; idx < ENCODE_TABLE_SIZE; idx++) {
+      double val = idx / static_cast<double>(ENCODE_TABLE_SIZE - 1);
+      val = (val < 0.0031308) ? val * 12.92 : 1.055 * pow(val, 1.0 / 2.4) - 0.055;
+      encode_[idx] = static_cast<uint8_t>(std::min(val * 255.0 + 0.5, 255.0));
+    }
+  }
+};
+static const LINEAR_TABLES& GetLinearTables(void) {
+  static const LINEAR_TABLES tables;
+  return tables;
+}
+
+/*
+ * FILTER_TAP
+ *    Source range [first_, first_ + count_) one destination pixel averages,
+ *    with its weights at weights[weight_]
+ */
+struct FILTER_TAP {
+  uint32_t first_;
+  uint32_t count_;
+  uint32_t weight_;
+};
+
+static void BuildAreaFilter(uint32_t srcSize, uint32_t dstSize,
+                            std::vector<FILTER_TAP>& taps,
+                            std::vector<float>& weights) {
+  double scale = static_cast<double>(srcSize) / dstSize;
+  for (uint32_t d = 0; d < dstSize; d++) {
+    double start = d * scale, end = std::min((d + 1) * scale, double(srcSize));
+    uint32_t first = static_cast<uint32_t>(start);
+    uint32_t last = std::max(first + 1, static_cast<uint32_t>(ceil(end)));
+    taps.push_back(FILTER_TAP { first, last - first,
+                                static_cast<uint32_t>(weights.size()) });
+    double sum = 0.0;
+    for (uint32_t s = first; s < last; s++) {
+      double w = std::min(end, s + 1.0) - std::max(start, double(s));
+      weights.push_back(static_cast<float>(w));
+      sum += w;
+    }
+    for (uint32_t s = 0; s < last - first; s++) {
+      weights[taps.back().weight_ + s] /= static_cast<float>(sum);
+    }
+  }
+}
+
+/*
+ * MulAdd()
+ *    acc[0..count) += src[0..count) * w, count a multiple of 4 (one RGBA
+ *    pixel per NEON register)
+ */
+static inline void MulAdd(float* acc, const float* src, float w, uint32_t count) {
+#if defined(__ARM_NEON)
+  for (uint32_t idx = 0; idx < count; idx += 4) {
+    vst1q_f32(acc + idx, vmlaq_n_f32(vld1q_f32(acc + idx), vld1q_f32(src + idx), w));
+  }
+#else
+  for (uint32_t idx = 0; idx < count; idx++) {
+    acc[idx] += src[idx] * w;
+  }
+#endif
+}
+
+/*
+ * FilterRow()
+ *    One source row, decoded to linear light and shrunk horizontally
+ */
+static void FilterRow(const uint8_t* src, uint32_t srcWidth,
+                      const std::vector<FILTER_TAP>& taps,
+                      const std::vector<float>& weights,
+                      std::vector<float>& linear, float* dst) {
+  const LINEAR_TABLES& tables = GetLinearTables();
+  for (uint32_t x = 0; x < srcWidth * 4; x += 4) {
+    linear[x + 0] = tables.decode_[src[x + 0]];
+    linear[x + 1] = tables.decode_[src[x + 1]];
+    linear[x + 2] = tables.decode_[src[x + 2]];
+    linear[x + 3] = src[x + 3] * (1.0f / 255.0f);
+  }
+  for (size_t x = 0; x < taps.size(); x++) {
+    const FILTER_TAP& tap = taps[x];
+    float* acc = dst + x * 4;
+    acc[0] = acc[1] = acc[2] = acc[3] = 0.0f;
+    for (uint32_t s = 0; s < tap.count_; s++) {
+      MulAdd(acc, &linear[(tap.first_ + s) * 4], weights[tap.weight_ + s], 4);
+    }
+  }
+}
+
+void ScaleImageLinear(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight,
+                      uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight) {
+  ASSERT(src && dst && dstWidth && dstHeight, "Invalid image to scale");
+  std::vector<FILTER_TAP> colTaps, rowTaps;
+  std::vector<float> colWeights, rowWeights;
+  BuildAreaFilter(srcWidth, dstWidth, colTaps, colWeights);
+  BuildAreaFilter(srcHeight, dstHeight, rowTaps, rowWeights);
+
+  const LINEAR_TABLES& tables = GetLinearTables();
+  uint32_t rowFloats = dstWidth * 4;
+  std::vector<float> linear(srcWidth * 4);
+  std::vector<float> row(rowFloats), acc(rowFloats);
+  for (uint32_t y = 0; y < dstHeight; y++) {
+    // a source row on a boundary is filtered for both destination rows
+    const FILTER_TAP& tap = rowTaps[y];
+    std::fill(acc.begin(), acc.end(), 0.0f);
+    for (uint32_t s = 0; s < tap.count_; s++) {
+      FilterRow(src + static_cast<size_t>(tap.first_ + s) * srcWidth * 4,
+                srcWidth, colTaps, colWeights, linear, row.data());
+      MulAdd(acc.data(), row.data(), rowWeights[tap.weight_ + s], rowFloats);
+    }
+
+    uint8_t* out = dst + static_cast<size_t>(y) * dstWidth * 4;
+    for (uint32_t x = 0; x < rowFloats; x += 4) {
+      for (uint32_t c = 0; c < 3; c++) {
+        float val = std::min(std::max(acc[x + c], 0.0f), 1.0f);
+        out[x + c] = tables.encode_[static_cast<uint32_t>(
+            val * (ENCODE_TABLE_SIZE - 1) + 0.5f)];
+      }
+      out[x + 3] = static_cast<uint8_t>(
+          std::min(std::max(acc[x + 3], 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+  }
+}
+
+void HalveRowsLinear(const uint8_t* row0, const uint8_t* row1, uint32_t width,
+                     uint8_t* dst) {
+  const LINEAR_TABLES& tables = GetLinearTables();
+  uint32_t dstWidth = std::max(1u, width / 2);
+  uint32_t step = (width > 1) ? 4 : 0;   // second column of the 2x2 block
+  for (uint32_t x = 0; x < dstWidth; x++, dst += 4) {
+    const uint8_t* a = row0 + x * 8;
+    const uint8_t* b = row1 + x * 8;
+    for (uint32_t c = 0; c < 3; c++) {
+      float val = 0.25f * (tables.decode_[a[c]] + tables.decode_[a[c + step]] +
+                           tables.decode_[b[c]] + tables.decode_[b[c + step]]);
+      dst[c] = tables.encode_[static_cast<uint32_t>(
+          std::min(val, 1.0f) * (ENCODE_TABLE_SIZE - 1) + 0.5f)];
+    }
+    dst[3] = static_cast<uint8_t>((a[3] + a[3 + step] + b[3] + b[3 + step] + 2) >> 2);
+  }
+}
+
+uint32_t MipLevelCount(uint32_t width, uint32_t height) {
+  uint32_t levels = 1;
+  for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+    levels++;
+  }
+  return levels;
+}
+
+size_t MipChainSize(uint32_t width, uint32_t height, uint32_t levels) {
+  size_t size = 0;
+  for (uint32_t level = 0; level < levels; level++) {
+    size += static_cast<size_t>(width) * height * 4;
+    width = std::max(1u, width >> 1);
+    height = std::max(1u, height >> 1);
+  }
+  return size;
+}
+
+void BuildMipChain(uint8_t* image, uint32_t width, uint32_t height,
+                   uint32_t levels) {
+  for (uint32_t level = 1; level < levels; level++) {
+    uint8_t* next = image + static_cast<size_t>(width) * height * 4;
+    uint32_t nextWidth = std::max(1u, width >> 1);
+    uint32_t nextHeight = std::max(1u, height >> 1);
+    ScaleImageLinear(image, width, height, next, nextWidth, nextHeight);
+    image = next;
+    width = nextWidth;
+    height = nextHeight;
+  }
+}
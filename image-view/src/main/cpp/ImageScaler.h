@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __IMAGE_SCALER_H__
+#define __IMAGE_SCALER_H__
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * ScaleImageLinear()
+ *     Resamples an R8G8B8A8 image with the sRGB transfer function (P3 and
+ *     sRGB images both use it) to dstWidth x dstHeight, averaging in linear
+ *     light with an area (box) filter. Meant for shrinking: each
+ *     destination pixel averages the source pixels it covers. Alpha is
+ *     averaged as is.
+ */
+void ScaleImageLinear(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight,
+                      uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight);
+
+/*
+ * HalveRowsLinear()
+ *     One row of a half size image from two rows of width pixels, for
+ *     images streamed a row at a time: each destination pixel is the 2x2
+ *     linear light average (ScaleImageLinear() transfer function), over
+ *     max(1, width / 2) pixels; an odd last column is dropped, a width of
+ *     1 averages vertically only.
+ */
+void HalveRowsLinear(const uint8_t* row0, const uint8_t* row1, uint32_t width,
+                     uint8_t* dst);
+
+/*
+ * Mip chains: level 0 first, then each level half the previous one
+ * (rounded down, at least 1) packed right after it, down to 1x1
+ */
+uint32_t MipLevelCount(uint32_t width, uint32_t height);
+size_t MipChainSize(uint32_t width, uint32_t height, uint32_t levels);
+// Fills levels 1 .. levels - 1 from level 0 at image, with ScaleImageLinear()
+void BuildMipChain(uint8_t* image, uint32_t width, uint32_t height,
+                   uint32_t levels);
+
+#endif // __IMAGE_SCALER_H__
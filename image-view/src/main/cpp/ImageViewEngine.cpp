@@ -22,6 +22,18 @@
  */
 bool ImageViewEngine::InitializeDisplay(void) {
 
+  // Context, shaders and textures survived the last window: new surface only.
+  // If the new window refuses the wide color space, fall back to sRGB.
+  if (RestoreWindowSurface() ||
+      (eglContext_ != EGL_NO_CONTEXT &&
+       SwitchDisplayColorSpace(DISPLAY_COLORSPACE::SRGB))) {
+    glViewport(0, 0, renderTargetWidth_, renderTargetHeight_);
+    EnableRenderUI();
+    return true;
+  }
+  // a kept context that cannot render to the new window is useless
+  TerminateDisplay();
+
   EnableWelcomeUI();
 
   bool status = CreateWideColorCtx();
@@ -29,6 +41,12 @@ bool ImageViewEngine::InitializeDisplay(void) {
 
   status = program_.createProgram();
   ASSERT(status, "CreateShaderProgram Failed");
+  status = clipProgram_.createGamutClipProgram();
+  ASSERT(status, "CreateShaderProgram Failed");
+  status = gridProgram_.createGridProgram();
+  ASSERT(status, "CreateShaderProgram Failed");
+  status = quads_.Create();
+  ASSERT(status, "QuadRenderer::Create() Failed");
 
   status = CreateTextures();
   ASSERT(status, "LoadTextures() Failed")
@@ -38,6 +56,7 @@ bool ImageViewEngine::InitializeDisplay(void) {
 
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
   glViewport(0, 0, renderTargetWidth_, renderTargetHeight_);
 
@@ -56,55 +75,107 @@ void ImageViewEngine::EnableAnimation(bool enable) {
  * Draw quad(s) to view texture
  */
 void ImageViewEngine::DrawFrame(void) {
-  if (display_ == NULL) {
+  if (display_ == NULL || surface_ == EGL_NO_SURFACE) {
     return;
   }
 
-  const GLfloat leftQuadVertices[] = {
-      -1.f, -1.0f,  0.0f, 1.0f,
-      0.0f, -1.0f,  1.0f, 1.0f,
-      0.0f,  1.0f,  1.0f, 0.0f,
-      -1.0f, 1.0f,  0.0f, 0.0f };
-  const GLfloat rightQuadVertices[] = {
-      0.0f, -1.0f,  0.0f, 1.0f,
-      1.0f, -1.0f,  1.0f, 1.0f,
-      1.0f,  1.0f,  1.0f, 0.0f,
-      0.0f, 1.0f,  0.0f, 0.0f };
-
   // Just fill the screen with a color.
-  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
   glClear(GL_COLOR_BUFFER_BIT);
 
-  glUseProgram(program_.getProgram());
+  UploadReadyTextures();
+  if (gridMode_) {
+    DrawGrid();
+    eglSwapBuffers(display_, surface_);
+    if (memoryOverlay_) {
+      UpdateMemoryOverlay();
+    }
+    return;
+  }
+  int32_t texIdx = textureIdx_;
+  bool ready = UpdateTexture(texIdx);
+  bool tiled = IsTiled(texIdx);
+  if (static_cast<uint32_t>(texIdx) != viewedIdx_) {
+    // a new image is shown: its neighbours become the working set
+    textureCache_.Viewed(texIdx, ready);
+    viewedIdx_ = texIdx;
+    viewStart_ = std::chrono::steady_clock::now();
+    loadTimes_ = LOAD_TIMES { -1.0, -1.0, false };
+    ResetView();
+    if (!tiled) {
+      ReleaseTileCache();
+    }
+    RequestWorkingSet();
+    TrimTextures();
+  }
+  if (ready && tiled && tileCache_.Space() != dispColorSpace_) {
+    // first tiled image shown, or the display color space changed
+    ReleaseTileCache();
+    ready = tileCache_.Create(dispColorSpace_);
+  }
 
-  glVertexAttribPointer(program_.getAttribLocation(),
-                        2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 4, leftQuadVertices);
-  glEnableVertexAttribArray(program_.getAttribLocation());
+  // a preview stands in until the texture is in
+  bool preview = !ready && !tiled && textures_[texIdx]->IsPreview() &&
+                 textures_[texIdx]->ColorSpace() == dispColorSpace_;
+  bool drawable = ready || preview;
+  MeasureLoadTimes(preview, ready);
 
-  glVertexAttribPointer(program_.getAttribLocationTex(),
-                        2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 4, leftQuadVertices + 2);
-  glEnableVertexAttribArray(program_.getAttribLocationTex());
-  int32_t texIdx = textureIdx_;
-  if(renderModeBits_ & RENDERING_P3) {
-    glActiveTexture(GL_TEXTURE0 + 0);
-    glBindTexture(GL_TEXTURE_2D, textures_[texIdx]->P3TexId());
-    glUniform1i(program_.getSamplerLoc(), 0);
-    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+  VIEW_RECT view = ViewRect();
+  GLfloat layer = 0.0f;
+  if (ready && tiled) {
+    tileCache_.BeginFrame();
+    RequestTiles(texIdx, view);
+    texturePool_.BindForDraw(tileCache_.Texture());
+  } else if (drawable) {
+    // both halves sample the same layer; moving between images of one
+    // array keeps the binding (unit 0 is active outside of uploads)
+    texturePool_.BindForDraw(textures_[texIdx]->TexId());
+    layer = static_cast<GLfloat>(textures_[texIdx]->Layer());
   }
-  if (renderModeBits_ & RENDERING_SRGB) {
-    glVertexAttribPointer(program_.getAttribLocation(),
-                          2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 4,
-                          rightQuadVertices);
-    glVertexAttribPointer(program_.getAttribLocationTex(),
-                          2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 4,
-                          rightQuadVertices + 2);
-    glActiveTexture(GL_TEXTURE0 + 1);
-    glBindTexture(GL_TEXTURE_2D, textures_[texIdx]->SRGBATexId());
-    glUniform1i(program_.getSamplerLoc(), 1);
-    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+
+  const VIEW_RECT halves[] = { { -1.0f, 1.0f, 0.0f, -1.0f },
+                               { 0.0f, 1.0f, 1.0f, -1.0f } };
+  const uint32_t modes[] = { RENDERING_P3, RENDERING_SRGB };
+  for (uint32_t half = 0; drawable && half < 2; half++) {
+    if (!(renderModeBits_ & modes[half])) {
+      continue;
+    }
+    // the right half is the same texture, clipped to sRGB in the shader
+    // unless the display (and so the texture) is sRGB already
+    ShaderProgram& program = (half == 0 ||
+                              dispColorSpace_ == DISPLAY_COLORSPACE::SRGB) ?
+                             program_ : clipProgram_;
+    if (&program == &clipProgram_) {
+      quads_.UseProgram(program.getProgram());
+      program.setGamutClip(
+          android::gamutTransform(android::Gamut::DISPLAY_P3, android::Gamut::SRGB),
+          android::gamutTransform(android::Gamut::SRGB, android::Gamut::DISPLAY_P3),
+          (dispColorSpace_ == DISPLAY_COLORSPACE::P3_PASSTHROUGH) ?
+              DEFAULT_DISPLAY_GAMMA : 0.0f);
+    }
+    if (tiled) {
+      DrawTiles(texIdx, program, halves[half], view);
+    } else {
+      DrawQuad(program, halves[half], view, layer);
+    }
   }
 
   eglSwapBuffers(display_, surface_);
+  if (memoryOverlay_) {
+    UpdateMemoryOverlay();
+  }
+}
+
+/*
+ * DrawQuad()
+ *    Draws the tex rectangle of an array layer (normalized texture
+ *    coordinates) into the screen rectangle (clip space)
+ */
+void ImageViewEngine::DrawQuad(ShaderProgram& program, const VIEW_RECT& screen,
+                               const VIEW_RECT& tex, GLfloat layer) {
+  const GLfloat screenRect[] = { screen.left_, screen.top_,
+                                 screen.right_, screen.bottom_ };
+  const GLfloat texRect[] = { tex.left_, tex.top_, tex.right_, tex.bottom_ };
+  quads_.Draw(program, screenRect, texRect, layer);
 }
 
 /**
@@ -117,10 +188,32 @@ void ImageViewEngine::TerminateDisplay(void) {
   if(display_ == EGL_NO_DISPLAY)
     return;
 
-  DestroyWideColorCtx();
-
+  // GL objects go first, while the context is still current
   glDeleteProgram(program_.getProgram());
+  glDeleteProgram(clipProgram_.getProgram());
+  glDeleteProgram(gridProgram_.getProgram());
+  quads_.Destroy();
+  DeleteGridGeometry();
   DeleteTextures();
+
+  DestroyWideColorCtx();
+}
+
+/**
+ * The window is gone (app in background, rotation): drop the window surface
+ * only. Falls back to a full teardown when the context cannot stay current
+ * without a window.
+ */
+void ImageViewEngine::ReleaseWindow(void) {
+
+  animating_ = 0;
+
+  if(display_ == EGL_NO_DISPLAY)
+    return;
+
+  if (!ReleaseWindowSurface()) {
+    TerminateDisplay();
+  }
 }
 
 /*
@@ -129,10 +222,37 @@ void ImageViewEngine::TerminateDisplay(void) {
 ImageViewEngine::ImageViewEngine(struct android_app* app) :
     app_(app),
     animating_(0),
-    textureIdx_(0) {
+    textureIdx_(0),
+    uploads_(pboRing_) {
   textures_.resize(0);
   renderModeBits_ = RENDERING_P3 | RENDERING_SRGB;
   eglContext_ = EGL_NO_CONTEXT;
   surface_ = EGL_NO_SURFACE;
+  pbufferSurface_ = EGL_NO_SURFACE;
   display_ = EGL_NO_DISPLAY;
+  wideColorMode_ = SRGBA_R8G8B8A8_REV;
+  imageIndex_.Load(app->activity->internalDataPath ?
+                       app->activity->internalDataPath : "");
+  loader_.reset(new TextureLoader(app->activity->assetManager, sourceImages_,
+                                  imageIndex_,
+                                  app->activity->internalDataPath));
+  viewedIdx_ = UINT32_MAX;
+  loadTimes_ = LOAD_TIMES { -1.0, -1.0, false };
+  prefetchDirection_ = 0;
+  prefetchOrigin_ = 0;
+  scaleTextures_ = true;
+  compressTextures_ = true;
+  srgbR8_ = false;
+  memoryOverlay_ = false;
+  maxTextureSize_ = 0;
+  pinchDistance_ = 0.0f;
+  pinchZoom_ = 1.0f;
+  gridMode_ = false;
+  gridScroll_ = 0.0f;
+  gridVelocity_ = 0.0f;
+  gridDragging_ = false;
+  gridMoveTime_ = 0;
+  gridFrom_ = gridTo_ = 0;
+  gridVao_ = gridBuffer_ = 0;
+  ResetView();
 }
@@ -19,9 +19,13 @@
 #define __APP_ENGINE_H__
 
 #include <atomic>
+#include <chrono>
 #include <mutex>
 #include <condition_variable>
+#include <deque>
 #include <string>
+#include <unordered_set>
+#include <utility>
 
 #include <initializer_list>
 #include <memory>
@@ -35,7 +39,39 @@
 #include "android_debug.h"
 #include "gldebug.h"
 #include "ShaderProgram.h"
+#include "QuadRenderer.h"
 #include "AssetTexture.h"
+#include "TextureLoader.h"
+#include "TextureCache.h"
+#include "PboRing.h"
+#include "UploadScheduler.h"
+#include "TileCache.h"
+#include "ImageIndex.h"
+#include "ThumbnailAtlas.h"
+#include "MemoryTracker.h"
+
+struct DISPLAY_CAPS;
+
+// Left, top, right and bottom of a rectangle: in normalized image
+// coordinates (0, 0 at the top left) or in clip space (top 1, bottom -1)
+struct VIEW_RECT {
+  float left_, top_, right_, bottom_;
+};
+
+// How long the image last landed on took to show: its first pixels (a
+// preview_ or the texture itself) and its final texture; -1 until then
+struct LOAD_TIMES {
+  double firstPixelMs_;
+  double finalMs_;
+  bool preview_;
+};
+
+// How much ReleaseMemory() gives back; each level includes the ones before
+enum MEMORY_PRESSURE {
+  PRESSURE_PREFETCH,    // work ahead of the user: prefetch, idle PBOs
+  PRESSURE_OFFSCREEN,   // every texture but the visible image's
+  PRESSURE_SOURCES,     // decoded source images (CPU) too
+};
 
 class ImageViewEngine {
 public:
@@ -43,6 +79,46 @@ public:
 
   bool InitializeDisplay(void);
   void TerminateDisplay(void);
+  // Window lost: keeps the context and GL objects for the next window
+  void ReleaseWindow(void);
+
+  // Re-creates the window surface in another color space (same EGL config);
+  // textures follow lazily from the decoded source image cache
+  bool SwitchDisplayColorSpace(DISPLAY_COLORSPACE space);
+
+  // GPU texture residency
+  TEXTURE_CACHE_STATS GetTextureCacheStats(void);
+  void SetTextureBudget(size_t bytes);
+  // Shrink images larger than their quad when decoding and give them
+  // linear light mipmaps (default); off: full resolution, no mipmaps
+  void SetTextureScaling(bool enable);
+  // ETC2 compress uploaded textures in the background and keep them on
+  // disk for later launches (default); off: the transformed pixels are
+  // kept on disk as they are (PixelCache)
+  void SetTextureCompression(bool enable);
+  // Texture uploads are spread over frames, bytes at most per frame
+  // (UploadScheduler::kDefaultFrameBudget by default); stats with the time
+  // spent uploading per frame
+  UPLOAD_STATS GetUploadStats(void);
+  void SetUploadBudget(size_t bytes);
+  // Images not loaded when they are landed on show a low resolution
+  // preview first
+  LOAD_TIMES GetLoadTimes(void);
+
+  // CPU and GPU memory of the image pipeline (MemoryTracker)
+  MEMORY_STATS GetMemoryStats(void);
+  // Memory pressure (APP_CMD_LOW_MEMORY: PRESSURE_SOURCES, onTrimMemory()
+  // levels through TrimMemoryPressure()): releases caches up to level,
+  // returning the bytes given back; everything is rebuilt on demand
+  size_t ReleaseMemory(MEMORY_PRESSURE level);
+  // Debug overlay with GetMemoryStats(), refreshed every second; tapping
+  // the line between the two views toggles it too
+  void ShowMemoryOverlay(bool enable);
+
+  // Grid of all images as thumbnails, scrolled vertically (pinching out
+  // of an image opens it, tapping a thumbnail shows that image)
+  void ShowGrid(bool enable);
+  bool IsGridShown(void) const { return gridMode_; }
 
   // Touch/swipe event handler
   bool ProcessInputEvent(const AInputEvent* event);
@@ -61,6 +137,7 @@ private:
   int animating_;
   EGLDisplay display_;
   EGLSurface surface_;
+  EGLSurface pbufferSurface_;   // current surface while there is no window
   DISPLAY_COLORSPACE dispColorSpace_;
   DISPLAY_FORMAT dispFormat_;
 
@@ -69,10 +146,104 @@ private:
   int32_t renderTargetHeight_;
 
   ShaderProgram program_;
+  ShaderProgram clipProgram_;   // sRGB clipped view of P3 images
+  ShaderProgram gridProgram_;   // instanced thumbnails
+  QuadRenderer quads_;          // geometry, program and vertex array binds
 
   // Image file texture store
+  TextureArrayPool texturePool_;
   std::vector<AssetTexture*> textures_;
+  std::vector<std::pair<uint32_t, uint32_t>> imageSizes_;   // PNG headers
+  // Sizes and thumbnails of all images, read at startup; images missing
+  // from it are indexed in the background (IndexImages())
+  ImageIndex imageIndex_;
   std::atomic<uint32_t>  textureIdx_;
+  SourceImageCache sourceImages_;
+  std::unique_ptr<TextureLoader> loader_;
+  std::chrono::steady_clock::time_point loadStart_;
+  static constexpr double kUploadBudgetMs = 4.0;
+  PboRing pboRing_;
+  UploadScheduler uploads_;
+  bool scaleTextures_;
+  bool compressTextures_;
+  bool srgbR8_;                          // GL_EXT_texture_sRGB_R8
+  std::deque<TEXTURE_RESULT> decoded_;   // waiting for a free PBO slot
+  // Images whose DECODE failed (e.g. a corrupt asset): not asked for again
+  // until the textures are rebuilt or the display color space changes
+  std::unordered_set<uint32_t> failed_;
+  TextureCache textureCache_;
+  uint32_t viewedIdx_;
+  std::chrono::steady_clock::time_point viewStart_;   // of viewedIdx_
+  LOAD_TIMES loadTimes_;
+  void MeasureLoadTimes(bool preview, bool final);
+  static constexpr uint32_t kWorkingSetRadius = 1;
+
+  // Images too large for one texture (IsTiled()): a TilePyramid on disk
+  // each once opened, and the tiles in view in tileCache_
+  std::vector<std::shared_ptr<const TilePyramid>> pyramids_;
+  TileCache tileCache_;
+  GLint maxTextureSize_;
+  static constexpr uint64_t kMaxUntiledPixels = 4096 * 4096;
+  bool IsTiled(uint32_t idx);
+  uint32_t TileLevel(const TilePyramid& pyramid, const VIEW_RECT& view);
+  void RequestTiles(uint32_t idx, const VIEW_RECT& view);
+  void UploadTile(TEXTURE_JOB& job);
+  void DrawTiles(uint32_t idx, ShaderProgram& program,
+                 const VIEW_RECT& screen, const VIEW_RECT& view);
+  void ReleaseTileCache(void);
+
+  // Grid mode: thumbnails (THUMBNAIL jobs, the index thumbnail standing in)
+  // in thumbnails_, only those of the rows in view and kGridPrefetchRows
+  // around them; drawn in one instanced call from gridCells_
+  struct GRID_CELL {
+    GLfloat screen_[4];   // clip space left, top, right, bottom
+    GLfloat tex_[4];      // atlas rectangle, ThumbnailAtlas::Find()
+  };
+  bool gridMode_;
+  float gridScroll_;            // pixels of rows above the window
+  float gridVelocity_;          // pixels per ms: the drag, then the fling
+  bool gridDragging_;
+  uint64_t gridMoveTime_;       // of the last drag event
+  std::chrono::steady_clock::time_point gridFrameTime_;
+  uint32_t gridFrom_, gridTo_;  // images thumbnails are loaded for
+  ThumbnailAtlas thumbnails_;
+  std::vector<GRID_CELL> gridCells_;
+  GLuint gridVao_, gridBuffer_;
+  static constexpr float kGridCellPixels = 240.0f;
+  static constexpr uint32_t kGridMinColumns = 3;
+  static constexpr float kGridGapPixels = 2.0f;
+  static constexpr uint32_t kGridPrefetchRows = 2;
+  static constexpr float kGridFlingDecayMs = 325.0f;
+  static constexpr float kGridPinchZoom = 0.6f;   // pinch out of an image
+  uint32_t GridColumns(void);
+  float GridCellSize(void);
+  void ClampGridScroll(void);
+  void DrawGrid(void);
+  void RequestThumbnails(uint32_t firstRow, uint32_t lastRow);
+  void UploadThumbnail(TEXTURE_JOB& job);
+  void DeleteGridGeometry(void);
+  bool ProcessGridEvent(const AInputEvent* event);
+
+  // Zoom (pinch) and pan (drag while zoomed in), the same in both views
+  float viewZoom_;              // 1: the whole image
+  mathfu::vec2 viewCenter_;     // normalized image coordinates
+  static constexpr float kMinMaxZoom = 4.0f;
+  VIEW_RECT ViewRect(void);
+  float MaxZoom(uint32_t idx);
+  void ResetView(void);
+  void ClampView(void);
+  void PanView(const mathfu::vec2& pixels);
+  void DrawQuad(ShaderProgram& program, const VIEW_RECT& screen,
+                const VIEW_RECT& tex, GLfloat layer);
+
+  // Swipe direction prefetch
+  std::vector<uint32_t> prefetch_;
+  int32_t prefetchDirection_;
+  uint32_t prefetchOrigin_;
+  static constexpr uint32_t kPrefetchDepth = 2;
+  static constexpr uint32_t kMaxPrefetchDepth = 4;
+  static constexpr float kFastSwipeVelocity = 2.0f;   // pixels per ms
+  void PrefetchTextures(int32_t direction, float velocity);
 
   enum WIDECOLOR_MODE {
     P3_PASSTHROUGH_R8G8B8A8_REV,
@@ -85,25 +256,58 @@ private:
     MODE_COUNT
   };
   bool CreateWideColorCtx(void);
-  bool CreateWideColorCtx(WIDECOLOR_MODE mode);
+  bool CreateCachedWideColorCtx(const DISPLAY_CAPS& caps);
+  bool CreateWideColorCtx(WIDECOLOR_MODE mode, const EGL_CONFIG_INFO& cfg);
   void DestroyWideColorCtx(void);
+  bool CreateWindowSurface(void);
+  bool ReleaseWindowSurface(void);
+  bool RestoreWindowSurface(void);
+  WIDECOLOR_MODE wideColorMode_;
+  EGL_CONFIG_INFO eglConfig_;
 
   bool CreateTextures(void);
   void DeleteTextures(void);
+  bool TextureLimits(uint32_t* maxWidth, uint32_t* maxHeight);
+  void PlanTextureArrays(void);
+  bool UpdateTexture(uint32_t idx, bool urgent = true);
+  void UploadReadyTextures(void);
+  bool IsStaleResult(const TEXTURE_RESULT& result);
+  bool MapDecodedTexture(TEXTURE_RESULT& result);
+  void StartUpload(const TEXTURE_JOB& job, uint32_t width, uint32_t height,
+                   uint32_t levels, bool compressed, TEXEL_LAYOUT layout,
+                   const uint8_t* bits);
+  void FinishUpload(TEXTURE_UPLOAD& upload);
+  void CancelUploads(uint32_t idx);
+  bool InWorkingSet(uint32_t idx);
+  void RequestWorkingSet(void);
+  void IndexImages(void);
+  bool ShowThumbnail(uint32_t idx);
+  void TrimTextures(void);
 
   uint32_t renderModeBits_;
 
   // Input event data
   mathfu::vec2 touchStartPos_;
   uint64_t startTime_;
+  mathfu::vec2 lastTouchPos_;   // panning
+  float pinchDistance_;         // 0: no pinch going on
+  float pinchZoom_;             // viewZoom_ when the pinch started
   void ResetUserEventCache(void);
   void ProcessTapEvent(int x, int y);
+  void ProcessPinchEvent(const AInputEvent* event);
 
   // 2 TextView UI management
   void EnableWelcomeUI(void);
   void EnableRenderUI(void);
   void UpdateUI(void);
 
+  // Memory overlay
+  bool memoryOverlay_;
+  std::chrono::steady_clock::time_point memoryOverlayTime_;
+  static constexpr double kMemoryOverlayIntervalMs = 1000.0;
+  void UpdateMemoryOverlay(void);
+  void UpdateMemoryUI(const std::string* stats);
+
 };
 
 
@@ -17,12 +17,24 @@
 #include <android/input.h>
 #include "mathfu/matrix.h"
 #include "mathfu/glsl_mappings.h"
+#include <algorithm>
+#include <cmath>
 #include "ImageViewEngine.h"
 
 const uint64_t kSwipeThreshold = static_cast<uint64_t>(1000000000);
 const uint32_t kMinDistance = 100;
 const uint32_t kMaxTapDistance = 10;
 const uint32_t kMaxTapTime   = static_cast<uint64_t>(125000000);
+const uint32_t kMinPrefetchDistance = 30;
+
+/*
+ * SwipeVelocity()
+ *    Vertical speed in pixels per ms since the touch down
+ */
+static float SwipeVelocity(float distance, uint64_t startTime, uint64_t now) {
+  uint64_t elapsed = std::max<uint64_t>(now - startTime, 1);
+  return std::abs(distance) * 1000000.0f / static_cast<float>(elapsed);
+}
 
 void ImageViewEngine::ResetUserEventCache(void) {
   touchStartPos_ = mathfu::vec2(0.0f, 0.0f);
@@ -33,8 +45,11 @@ void ImageViewEngine::ProcessTapEvent(int x, int y) {
   // Get current display_ size:  the phone is in landscape mode ( in AndroidManifest.xml )
   int halfWidth = renderTargetWidth_ / 2;
 
-  if (x > halfWidth - 10  && x < halfWidth + 10)
+  if (x > halfWidth - 10  && x < halfWidth + 10) {
+    // on the line between the views
+    ShowMemoryOverlay(!memoryOverlay_);
     return;
+  }
 
   uint32_t  mask = 1 << (x / halfWidth);
 
@@ -44,10 +59,197 @@ void ImageViewEngine::ProcessTapEvent(int x, int y) {
   UpdateUI();
 }
 
+/*
+ * ViewRect()
+ *    The part of the image both views show: 1 / viewZoom_ of it each way,
+ *    around viewCenter_
+ */
+VIEW_RECT ImageViewEngine::ViewRect(void) {
+  float half = 0.5f / viewZoom_;
+  return VIEW_RECT { viewCenter_.x - half, viewCenter_.y - half,
+                     viewCenter_.x + half, viewCenter_.y + half };
+}
+
+/*
+ * MaxZoom()
+ *    kMinMaxZoom, or more for large images: until an image pixel covers
+ *    two screen pixels. A texture shrunk at decode (TextureLimits()) has
+ *    fewer pixels than the image: only as far as its texels go, and not
+ *    at all before it is resident. Tiled images load their full
+ *    resolution tiles.
+ */
+float ImageViewEngine::MaxZoom(uint32_t idx) {
+  float zoom = kMinMaxZoom;
+  if (idx < imageSizes_.size() && renderTargetWidth_ > 1 &&
+      renderTargetHeight_ > 0) {
+    uint32_t width = imageSizes_[idx].first;
+    uint32_t height = imageSizes_[idx].second;
+    bool shrunk = false;
+    if (!IsTiled(idx)) {
+      AssetTexture* tex = textures_[idx];
+      if (!tex->IsValid()) {
+        return 1.0f;
+      }
+      shrunk = tex->Width() < width || tex->Height() < height;
+      width = tex->Width();
+      height = tex->Height();
+    }
+    float ratio = std::max(
+        width / (renderTargetWidth_ / 2.0f),
+        height / static_cast<float>(renderTargetHeight_));
+    zoom = std::max(shrunk ? 1.0f : zoom, 2.0f * ratio);
+  }
+  return zoom;
+}
+
+void ImageViewEngine::ResetView(void) {
+  viewZoom_ = 1.0f;
+  viewCenter_ = mathfu::vec2(0.5f, 0.5f);
+  pinchDistance_ = 0.0f;
+}
+
+// the view stays inside the image
+void ImageViewEngine::ClampView(void) {
+  float half = 0.5f / viewZoom_;
+  viewCenter_.x = std::min(std::max(viewCenter_.x, half), 1.0f - half);
+  viewCenter_.y = std::min(std::max(viewCenter_.y, half), 1.0f - half);
+}
+
+/*
+ * PanView()
+ *    Moves the image with a drag of that many pixels
+ */
+void ImageViewEngine::PanView(const mathfu::vec2& pixels) {
+  if (renderTargetWidth_ <= 1 || renderTargetHeight_ <= 0) {
+    return;
+  }
+  viewCenter_.x -= pixels.x / (renderTargetWidth_ / 2.0f) / viewZoom_;
+  viewCenter_.y -= pixels.y / renderTargetHeight_ / viewZoom_;
+  ClampView();
+}
+
+/*
+ * ProcessPinchEvent()
+ *    Two fingers zoom between 1 and MaxZoom(), keeping the image point
+ *    between them in place. When one of them lifts, the other one pans.
+ */
+void ImageViewEngine::ProcessPinchEvent(const AInputEvent* event) {
+  int32_t action = AMotionEvent_getAction(event);
+  mathfu::vec2 p0(AMotionEvent_getX(event, 0), AMotionEvent_getY(event, 0));
+  mathfu::vec2 p1(AMotionEvent_getX(event, 1), AMotionEvent_getY(event, 1));
+  float distance = (p1 - p0).Length();
+
+  switch (action & AMOTION_EVENT_ACTION_MASK) {
+    case AMOTION_EVENT_ACTION_POINTER_UP: {
+      size_t up = (action & AMOTION_EVENT_ACTION_POINTER_INDEX_MASK) >>
+                  AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT;
+      size_t stays = up ? 0 : 1;
+      lastTouchPos_ = mathfu::vec2(AMotionEvent_getX(event, stays),
+                                   AMotionEvent_getY(event, stays));
+      pinchDistance_ = 0.0f;
+      break;
+    }
+    case AMOTION_EVENT_ACTION_MOVE: {
+      if (pinchDistance_ <= 0.0f) {
+        // two fingers left of three: a new pinch
+        pinchDistance_ = std::max(distance, 1.0f);
+        pinchZoom_ = viewZoom_;
+        break;
+      }
+      if (renderTargetWidth_ <= 1 || renderTargetHeight_ <= 0) {
+        break;
+      }
+      // the point between the fingers, in the view it is on
+      float halfWidth = renderTargetWidth_ / 2.0f;
+      float x = std::fmod((p0.x + p1.x) * 0.5f, halfWidth) / halfWidth - 0.5f;
+      float y = (p0.y + p1.y) * 0.5f / renderTargetHeight_ - 0.5f;
+      mathfu::vec2 anchor(viewCenter_.x + x / viewZoom_,
+                          viewCenter_.y + y / viewZoom_);
+      if (viewZoom_ <= 1.0f &&
+          pinchZoom_ * distance / pinchDistance_ < kGridPinchZoom) {
+        // pinched out of the whole image: all images
+        pinchDistance_ = 0.0f;
+        ShowGrid(true);
+        break;
+      }
+      viewZoom_ = std::min(std::max(pinchZoom_ * distance / pinchDistance_,
+                                    1.0f), MaxZoom(textureIdx_));
+      viewCenter_ = mathfu::vec2(anchor.x - x / viewZoom_,
+                                 anchor.y - y / viewZoom_);
+      ClampView();
+      break;
+    }
+    default:
+      // a second finger down
+      pinchDistance_ = std::max(distance, 1.0f);
+      pinchZoom_ = viewZoom_;
+      break;
+  }
+}
+
+/*
+ * ProcessGridEvent()
+ *    Drags scroll the grid; lifting the finger while it moves flings it
+ *    (DrawGrid()) at the speed of the last drag events. A tap shows the
+ *    image tapped.
+ */
+bool ImageViewEngine::ProcessGridEvent(const AInputEvent* event) {
+  int32_t action = AMotionEvent_getAction(event);
+  if (AMotionEvent_getPointerCount(event) > 1 ||
+      action == AMOTION_EVENT_ACTION_CANCEL) {
+    ResetUserEventCache();
+    gridDragging_ = false;
+    gridVelocity_ = 0.0f;
+    return true;
+  }
+  mathfu::vec2 pos(AMotionEvent_getX(event, 0), AMotionEvent_getY(event, 0));
+  uint64_t now = AMotionEvent_getEventTime(event);
+
+  if (action == AMOTION_EVENT_ACTION_DOWN) {
+    touchStartPos_ = pos;
+    startTime_ = now;
+    lastTouchPos_ = pos;
+    gridMoveTime_ = now;
+    gridDragging_ = true;
+    gridVelocity_ = 0.0f;   // a touch stops the fling
+  } else if (action == AMOTION_EVENT_ACTION_MOVE && startTime_) {
+    float dy = pos.y - lastTouchPos_.y;
+    float elapsed = std::max(now - gridMoveTime_, static_cast<uint64_t>(1)) /
+                    1000000.0f;
+    // smoothed over the last events: single ones are noisy
+    gridVelocity_ = 0.5f * gridVelocity_ + 0.5f * (-dy / elapsed);
+    gridScroll_ -= dy;
+    ClampGridScroll();
+    lastTouchPos_ = pos;
+    gridMoveTime_ = now;
+  } else if (action == AMOTION_EVENT_ACTION_UP && startTime_) {
+    gridDragging_ = false;
+    mathfu::vec2 moved = pos - touchStartPos_;
+    if (now - startTime_ < kMaxTapTime && moved.Length() < kMaxTapDistance) {
+      gridVelocity_ = 0.0f;
+      float cell = GridCellSize();
+      uint32_t idx = static_cast<uint32_t>((gridScroll_ + pos.y) / cell) *
+                     GridColumns() + static_cast<uint32_t>(pos.x / cell);
+      if (pos.x >= 0.0f && idx < textures_.size()) {
+        textureIdx_ = idx;
+        ShowGrid(false);
+      }
+    } else if (now - gridMoveTime_ > kMaxTapTime) {
+      gridVelocity_ = 0.0f;   // the finger stopped before lifting
+    }
+    ResetUserEventCache();
+  }
+  return true;
+}
+
 bool ImageViewEngine::ProcessInputEvent(const AInputEvent* event) {
+  if (gridMode_) {
+    return ProcessGridEvent(event);
+  }
   if(AMotionEvent_getPointerCount(event) > 1) {
+    // no tap or swipe until all fingers are up
     ResetUserEventCache();
-    LOGE("more than one pointer action");
+    ProcessPinchEvent(event);
     return true;
   }
 
@@ -61,6 +263,28 @@ bool ImageViewEngine::ProcessInputEvent(const AInputEvent* event) {
     touchStartPos_.x = AMotionEvent_getX(event, 0);
     touchStartPos_.y = AMotionEvent_getY(event, 0);
     startTime_ = AMotionEvent_getEventTime(event);
+    lastTouchPos_ = touchStartPos_;
+    return true;
+  } else if(action == AMOTION_EVENT_ACTION_MOVE) {
+    mathfu::vec2 v2(AMotionEvent_getX(event, 0), AMotionEvent_getY(event, 0));
+    if (viewZoom_ > 1.0f) {
+      // zoomed in: drags pan instead of swiping
+      PanView(v2 - lastTouchPos_);
+      lastTouchPos_ = v2;
+      return true;
+    }
+    if (!startTime_) {
+      return true;   // the finger left over from a pinch
+    }
+    // Start loading in the swipe direction while the finger still moves
+    v2 = v2 - touchStartPos_;
+    if (std::abs(v2.y) < kMinPrefetchDistance ||
+        std::abs(v2.x) > std::abs(v2.y)) {
+      return true;
+    }
+    PrefetchTextures(v2.y > 0 ? -1 : 1,
+                     SwipeVelocity(v2.y, startTime_,
+                                   AMotionEvent_getEventTime(event)));
     return true;
   } else if(action == AMOTION_EVENT_ACTION_UP) {
     uint64_t endTime = AMotionEvent_getEventTime(event);
@@ -81,6 +305,10 @@ bool ImageViewEngine::ProcessInputEvent(const AInputEvent* event) {
       return true;
     }
 
+    if (viewZoom_ > 1.0f) {
+      return true;
+    }
+
     if (v2.Length() < kMinDistance) {
       LOGI("---- too short to be considered a swipe");
       return true;
@@ -101,6 +329,8 @@ bool ImageViewEngine::ProcessInputEvent(const AInputEvent* event) {
     idx += offset + textures_.size();
     textureIdx_ = idx % textures_.size();
 
+    // keep going the same way from the new image
+    PrefetchTextures(offset, SwipeVelocity(v2.y, startTime_, endTime));
     UpdateUI();
   }
 
@@ -150,3 +380,23 @@ void ImageViewEngine::UpdateUI(void) {
 
   app_->activity->vm->DetachCurrentThread();
 }
+
+/*
+ * UpdateMemoryUI()
+ *    Shows the memory overlay with the given text, hides it with nullptr
+ */
+void ImageViewEngine::UpdateMemoryUI(const std::string* stats) {
+  JNIEnv* jni;
+  app_->activity->vm->AttachCurrentThread(&jni, NULL);
+
+  jclass clazz = jni->GetObjectClass(app_->activity->clazz);
+  jmethodID methodID = jni->GetMethodID(clazz, "ShowMemoryStats",
+                                        "(Ljava/lang/String;)V");
+  jstring text = stats ? jni->NewStringUTF(stats->c_str()) : nullptr;
+  jni->CallVoidMethod(app_->activity->clazz, methodID, text);
+  if (text) {
+    jni->DeleteLocalRef(text);
+  }
+
+  app_->activity->vm->DetachCurrentThread();
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "MemoryTracker.h"
+
+size_t IMAGE_MEMORY::Total(void) const {
+  size_t total = 0;
+  for (auto bytes : bytes_) {
+    total += bytes;
+  }
+  return total;
+}
+
+MemoryTracker& MemoryTracker::Instance(void) {
+  static MemoryTracker tracker;
+  return tracker;
+}
+
+MemoryTracker::MemoryTracker() :
+    cpuLive_(0), cpuPeak_(0), gpuLive_(0), gpuPeak_(0) {
+  memset(categories_, 0, sizeof(categories_));
+}
+
+void MemoryTracker::Add(MEMORY_CATEGORY category, const std::string& image,
+                        size_t bytes) {
+  std::lock_guard<std::mutex> guard(lock_);
+  MEMORY_CATEGORY_STATS& stats = categories_[category];
+  stats.live_ += bytes;
+  stats.peak_ = std::max(stats.peak_, stats.live_);
+  stats.allocations_++;
+  if (category >= kFirstGpuCategory) {
+    gpuLive_ += bytes;
+    gpuPeak_ = std::max(gpuPeak_, gpuLive_);
+  } else {
+    cpuLive_ += bytes;
+    cpuPeak_ = std::max(cpuPeak_, cpuLive_);
+  }
+
+  if (!image.empty()) {
+    auto it = images_.find(image);
+    if (it == images_.end()) {
+      IMAGE_MEMORY memory;
+      memory.name_ = image;
+      memset(memory.bytes_, 0, sizeof(memory.bytes_));
+      it = images_.emplace(image, memory).first;
+    }
+    it->second.bytes_[category] += bytes;
+  }
+}
+
+void MemoryTracker::Remove(MEMORY_CATEGORY category, const std::string& image,
+                           size_t bytes) {
+  std::lock_guard<std::mutex> guard(lock_);
+  categories_[category].live_ -= bytes;
+  if (category >= kFirstGpuCategory) {
+    gpuLive_ -= bytes;
+  } else {
+    cpuLive_ -= bytes;
+  }
+
+  if (!image.empty()) {
+    auto it = images_.find(image);
+    if (it != images_.end()) {
+      it->second.bytes_[category] -= bytes;
+      if (!it->second.Total()) {
+        images_.erase(it);
+      }
+    }
+  }
+}
+
+MEMORY_STATS MemoryTracker::Stats(void) {
+  MEMORY_STATS stats;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    memcpy(stats.categories_, categories_, sizeof(categories_));
+    stats.cpuLive_ = cpuLive_;
+    stats.cpuPeak_ = cpuPeak_;
+    stats.gpuLive_ = gpuLive_;
+    stats.gpuPeak_ = gpuPeak_;
+    stats.images_.reserve(images_.size());
+    for (auto& image : images_) {
+      stats.images_.push_back(image.second);
+    }
+  }
+  std::sort(stats.images_.begin(), stats.images_.end(),
+            [](const IMAGE_MEMORY& a, const IMAGE_MEMORY& b) {
+              return a.Total() > b.Total();
+            });
+  return stats;
+}
+
+void MemoryTracker::ResetPeaks(void) {
+  std::lock_guard<std::mutex> guard(lock_);
+  for (auto& category : categories_) {
+    category.peak_ = category.live_;
+  }
+  cpuPeak_ = cpuLive_;
+  gpuPeak_ = gpuLive_;
+}
+
+const char* MemoryTracker::CategoryName(MEMORY_CATEGORY category) {
+  static const char* names[MEMORY_CATEGORY_COUNT] = {
+      "asset", "decoded", "staging", "etc2", "mapped",
+      "index", "pbo", "texture", "slack",
+  };
+  return names[category];
+}
+
+/*
+ * Format()
+ *    Sizes in MB with one decimal; categories without any allocation so far
+ *    are left out
+ */
+std::string MemoryTracker::Format(const MEMORY_STATS& stats,
+                                  uint32_t maxImages) {
+  const double MB = 1024.0 * 1024.0;
+  char line[128];
+  snprintf(line, sizeof(line), "CPU %.1f MB (peak %.1f)  GPU %.1f MB (peak %.1f)",
+           stats.cpuLive_ / MB, stats.cpuPeak_ / MB,
+           stats.gpuLive_ / MB, stats.gpuPeak_ / MB);
+  std::string text(line);
+
+  for (uint32_t idx = 0; idx < MEMORY_CATEGORY_COUNT; idx++) {
+    const MEMORY_CATEGORY_STATS& category = stats.categories_[idx];
+    if (!category.allocations_) {
+      continue;
+    }
+    snprintf(line, sizeof(line), "\n%-8s %6.1f MB (peak %.1f)",
+             CategoryName(static_cast<MEMORY_CATEGORY>(idx)),
+             category.live_ / MB, category.peak_ / MB);
+    text += line;
+  }
+
+  uint32_t count = std::min(maxImages,
+                            static_cast<uint32_t>(stats.images_.size()));
+  for (uint32_t idx = 0; idx < count; idx++) {
+    const IMAGE_MEMORY& image = stats.images_[idx];
+    snprintf(line, sizeof(line), "\n%.1f MB %s", image.Total() / MB,
+             image.name_.c_str());
+    text += line;
+  }
+  return text;
+}
+
+TrackedAllocation::TrackedAllocation(MEMORY_CATEGORY category,
+                                     const std::string& image, size_t bytes) :
+    category_(category), image_(image), bytes_(0) {
+  Resize(bytes);
+}
+
+TrackedAllocation::TrackedAllocation(TrackedAllocation&& other) :
+    category_(other.category_), image_(std::move(other.image_)),
+    bytes_(other.bytes_) {
+  other.bytes_ = 0;
+}
+
+TrackedAllocation& TrackedAllocation::operator=(TrackedAllocation&& other) {
+  if (this != &other) {
+    Reset();
+    category_ = other.category_;
+    image_ = std::move(other.image_);
+    bytes_ = other.bytes_;
+    other.bytes_ = 0;
+  }
+  return *this;
+}
+
+void TrackedAllocation::Resize(size_t bytes) {
+  if (bytes > bytes_) {
+    MemoryTracker::Instance().Add(category_, image_, bytes - bytes_);
+  } else if (bytes < bytes_) {
+    MemoryTracker::Instance().Remove(category_, image_, bytes_ - bytes);
+  }
+  bytes_ = bytes;
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __MEMORY_TRACKER_H__
+#define __MEMORY_TRACKER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * What the bytes are used for. The first group is CPU memory, the rest
+ * lives in the GL driver (kFirstGpuCategory).
+ */
+enum MEMORY_CATEGORY {
+  ASSET_FILE,          // PNG file read from the APK, while decoding
+  DECODED_IMAGE,       // SOURCE_IMAGE pixels (source image cache)
+  STAGING,             // transformed pixels in client memory
+  COMPRESSED_DATA,     // COMPRESSED_TEXTURE ETC2 data
+  MAPPED_FILE,         // PixelCache file mappings
+  IMAGE_INDEX,         // ImageIndex records and thumbnails
+  PIXEL_BUFFER,        // PboRing GL_PIXEL_UNPACK_BUFFERs
+  GPU_TEXTURE,         // array layers holding an image
+  GPU_TEXTURE_SLACK,   // array layers allocated but empty
+  MEMORY_CATEGORY_COUNT
+};
+
+struct MEMORY_CATEGORY_STATS {
+  size_t live_;
+  size_t peak_;
+  uint64_t allocations_;
+};
+
+// Live bytes held for one image, per category
+struct IMAGE_MEMORY {
+  std::string name_;
+  size_t bytes_[MEMORY_CATEGORY_COUNT];
+  size_t Total(void) const;
+};
+
+struct MEMORY_STATS {
+  MEMORY_CATEGORY_STATS categories_[MEMORY_CATEGORY_COUNT];
+  size_t cpuLive_, cpuPeak_;
+  size_t gpuLive_, gpuPeak_;
+  std::vector<IMAGE_MEMORY> images_;   // largest first
+};
+
+/*
+ * MemoryTracker
+ *    Process wide accounting of the viewer's pixel buffers and GL
+ *    allocations: live and peak bytes per category and overall (CPU and
+ *    GPU peaks are of the sums, not sums of the peaks), and live bytes per
+ *    image. Allocations report through TrackedAllocation; an empty image
+ *    name is memory shared by all images (e.g. the PBO ring).
+ *    Thread safe.
+ */
+class MemoryTracker {
+public:
+  static MemoryTracker& Instance(void);
+
+  void Add(MEMORY_CATEGORY category, const std::string& image, size_t bytes);
+  void Remove(MEMORY_CATEGORY category, const std::string& image, size_t bytes);
+
+  MEMORY_STATS Stats(void);
+  // Peaks restart from the live values
+  void ResetPeaks(void);
+
+  // Short multi line summary, for the log and the debug overlay
+  static std::string Format(const MEMORY_STATS& stats, uint32_t maxImages = 3);
+  static const char* CategoryName(MEMORY_CATEGORY category);
+  static constexpr MEMORY_CATEGORY kFirstGpuCategory = PIXEL_BUFFER;
+
+private:
+  MemoryTracker();
+
+  std::mutex lock_;
+  MEMORY_CATEGORY_STATS categories_[MEMORY_CATEGORY_COUNT];
+  size_t cpuLive_, cpuPeak_;
+  size_t gpuLive_, gpuPeak_;
+  std::unordered_map<std::string, IMAGE_MEMORY> images_;
+};
+
+/*
+ * TrackedAllocation
+ *    Accounts bytes for as long as it lives: hold one next to (or inside)
+ *    the buffer it describes. Movable, so it can follow the buffer.
+ */
+class TrackedAllocation {
+public:
+  TrackedAllocation() : category_(STAGING), bytes_(0) {}
+  TrackedAllocation(MEMORY_CATEGORY category, const std::string& image,
+                    size_t bytes);
+  ~TrackedAllocation() { Reset(); }
+  TrackedAllocation(TrackedAllocation&& other);
+  TrackedAllocation& operator=(TrackedAllocation&& other);
+  TrackedAllocation(const TrackedAllocation&) = delete;
+  TrackedAllocation& operator=(const TrackedAllocation&) = delete;
+
+  // The buffer grew or shrank in place
+  void Resize(size_t bytes);
+  void Reset(void) { Resize(0); }
+  size_t Bytes(void) const { return bytes_; }
+  const std::string& Image(void) const { return image_; }
+
+private:
+  MEMORY_CATEGORY category_;
+  std::string image_;
+  size_t bytes_;
+};
+
+#endif // __MEMORY_TRACKER_H__
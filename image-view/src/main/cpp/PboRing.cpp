@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "PboRing.h"
+#include "android_debug.h"
+
+PboRing::PboRing(uint32_t count) :
+    slots_(count, SLOT { 0, 0, nullptr, false, false }),
+    memory_(MEMORY_CATEGORY::PIXEL_BUFFER, "", 0) {
+}
+
+PboRing::~PboRing() {
+  // buffers are owned by the context; Reset() must have run while it was
+  // current
+}
+
+int32_t PboRing::Acquire(size_t size, uint8_t** mapped) {
+  for (size_t idx = 0; idx < slots_.size(); idx++) {
+    SLOT& slot = slots_[idx];
+    if (slot.busy_) {
+      continue;
+    }
+    if (slot.fence_) {
+      // non blocking: a slot the GPU still reads from is skipped
+      GLenum status = glClientWaitSync(slot.fence_, 0, 0);
+      if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+        continue;
+      }
+      glDeleteSync(slot.fence_);
+      slot.fence_ = nullptr;
+    }
+
+    if (!slot.buffer_) {
+      glGenBuffers(1, &slot.buffer_);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer_);
+    if (slot.size_ < size) {
+      glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+      memory_.Resize(memory_.Bytes() - slot.size_ + size);
+      slot.size_ = size;
+    }
+    void* ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (!ptr) {
+      LOGE("glMapBufferRange(%zu) failed: %#x", size, glGetError());
+      return -1;
+    }
+    slot.mapped_ = true;
+    slot.busy_ = true;
+    *mapped = static_cast<uint8_t*>(ptr);
+    return static_cast<int32_t>(idx);
+  }
+  return -1;
+}
+
+bool PboRing::BindForUpload(int32_t slot) {
+  ASSERT(slot >= 0 && slot < static_cast<int32_t>(slots_.size()),
+         "invalid PBO slot %d", slot);
+  SLOT& s = slots_[slot];
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s.buffer_);
+  bool status = true;
+  if (s.mapped_) {
+    // GL_FALSE: the content got corrupted (e.g. display mode change)
+    status = (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE);
+    s.mapped_ = false;
+  }
+  if (!status) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+  return status;
+}
+
+void PboRing::Release(int32_t slot) {
+  SLOT& s = slots_[slot];
+  s.fence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  s.busy_ = false;
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void PboRing::Unbind(void) {
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void PboRing::Abandon(int32_t slot) {
+  SLOT& s = slots_[slot];
+  if (s.mapped_) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s.buffer_);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    s.mapped_ = false;
+  }
+  s.busy_ = false;
+}
+
+void PboRing::Reset(void) {
+  for (size_t idx = 0; idx < slots_.size(); idx++) {
+    SLOT& s = slots_[idx];
+    Abandon(static_cast<int32_t>(idx));
+    if (s.fence_) {
+      glDeleteSync(s.fence_);
+    }
+    if (s.buffer_) {
+      glDeleteBuffers(1, &s.buffer_);
+    }
+    s = SLOT { 0, 0, nullptr, false, false };
+  }
+  memory_.Reset();
+}
+
+/*
+ * Trim()
+ *    A buffer the GPU still reads from is only deleted by GL once it is
+ *    done with it, so the fence can go with it.
+ */
+void PboRing::Trim(void) {
+  for (auto& s : slots_) {
+    if (s.busy_ || !s.buffer_) {
+      continue;
+    }
+    if (s.fence_) {
+      glDeleteSync(s.fence_);
+    }
+    glDeleteBuffers(1, &s.buffer_);
+    memory_.Resize(memory_.Bytes() - s.size_);
+    s = SLOT { 0, 0, nullptr, false, false };
+  }
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __PBO_RING_H__
+#define __PBO_RING_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <GLES3/gl32.h>
+#include "MemoryTracker.h"
+
+/*
+ * PboRing
+ *    A small set of GL_PIXEL_UNPACK_BUFFERs for texture uploads. A slot is
+ *    mapped on the GL thread, filled by any thread, then unmapped and used
+ *    as glTexImage2D source on the GL thread; a fence keeps the slot busy
+ *    until the GPU has consumed it.
+ *    All methods are GL thread only.
+ */
+class PboRing {
+public:
+  explicit PboRing(uint32_t count = kDefaultSlotCount);
+  ~PboRing();
+
+  // Free slot of at least size bytes, mapped for writing; -1 if every slot
+  // is in flight
+  int32_t Acquire(size_t size, uint8_t** mapped);
+  // Unmaps and binds the slot as GL_PIXEL_UNPACK_BUFFER; texture uploads
+  // then take offsets into it
+  bool BindForUpload(int32_t slot);
+  // After the uploads from the slot are issued: fences it and unbinds
+  void Release(int32_t slot);
+  // Unbinds without releasing, when uploads from the slot go on in a later
+  // frame
+  static void Unbind(void);
+  // Gives a mapped slot back without uploading from it
+  void Abandon(int32_t slot);
+
+  // Unmaps and deletes all buffers (before the context goes away)
+  void Reset(void);
+  // Deletes the buffers of idle slots (memory pressure); the next
+  // Acquire() of such a slot allocates again
+  void Trim(void);
+
+  static constexpr uint32_t kDefaultSlotCount = 3;
+
+private:
+  struct SLOT {
+    GLuint buffer_;
+    size_t size_;
+    GLsync fence_;
+    bool mapped_;
+    bool busy_;
+  };
+  std::vector<SLOT> slots_;
+  TrackedAllocation memory_;   // PIXEL_BUFFER bytes of all slots
+};
+
+#endif // __PBO_RING_H__
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "PixelCache.h"
+#include "CacheFile.h"
+#include "CacheTrim.h"
+#include "android_debug.h"
+
+#define PIXEL_CACHE_DIR      "pixels"
+#define PIXEL_FILE_SUFFIX    ".pixels"
+#define PIXEL_FILE_MAGIC     "PXLS"
+#define PIXEL_FILE_VERSION   2   // 1: R8G8B8A8 only
+
+/*
+ * File layout: PIXEL_FILE_HEADER, zero padding up to dataOffset_ (a page
+ * boundary, as mmap() wants), then dataSize_ bytes of pixels
+ */
+struct PIXEL_FILE_HEADER {
+  char     magic_[4];
+  uint32_t version_;
+  uint64_t contentHash_;
+  int32_t  space_;
+  uint32_t format_;
+  uint32_t maxWidth_, maxHeight_;
+  uint32_t mipmaps_;
+  uint32_t width_, height_, levels_;
+  uint32_t layout_;           // TEXEL_LAYOUT
+  uint64_t dataOffset_;
+  uint64_t dataSize_;
+};
+
+MAPPED_PIXELS::~MAPPED_PIXELS() {
+  if (map_) {
+    munmap(map_, mapSize_);
+  }
+}
+
+PixelCache::PixelCache(const std::string& dir, size_t budget) :
+    budget_(budget) {
+  dir_ = dir;
+  if (dir_.length() && dir_.back() != '/') {
+    dir_.push_back('/');
+  }
+  dir_ += PIXEL_CACHE_DIR;
+}
+
+std::string PixelCache::FilePath(const PIXEL_CACHE_KEY& key) {
+  std::string name(key.name_);
+  for (auto& ch : name) {
+    if (ch == '/') {
+      ch = '_';
+    }
+  }
+  char suffix[64];
+  snprintf(suffix, sizeof(suffix), ".%d.%ux%u%s" PIXEL_FILE_SUFFIX,
+           key.space_, key.maxWidth_, key.maxHeight_,
+           key.mipmaps_ ? ".mip" : "");
+  return dir_ + "/" + name + suffix;
+}
+
+/*
+ * Load()
+ *    MAP_POPULATE reads the pixels in on the calling (loader) thread, so
+ *    the upload on the GL thread does not fault pages in.
+ */
+std::shared_ptr<const MAPPED_PIXELS> PixelCache::Load(
+    const PIXEL_CACHE_KEY& key) {
+  std::string path = FilePath(key);
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  PIXEL_FILE_HEADER header;
+  struct stat st;
+  bool valid = pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+               fstat(fd, &st) == 0 &&
+               !memcmp(header.magic_, PIXEL_FILE_MAGIC, 4) &&
+               header.version_ == PIXEL_FILE_VERSION &&
+               header.contentHash_ == key.contentHash_ &&
+               header.space_ == key.space_ &&
+               header.format_ == key.format_ &&
+               header.maxWidth_ == key.maxWidth_ &&
+               header.maxHeight_ == key.maxHeight_ &&
+               header.mipmaps_ == (key.mipmaps_ ? 1u : 0u) &&
+               header.levels_ >= 1 && header.levels_ <= 32 &&
+               (header.layout_ == TEXEL_GRAY || header.layout_ == TEXEL_RGB ||
+                header.layout_ == TEXEL_RGBA) &&
+               header.dataOffset_ % pageSize == 0 &&
+               header.dataSize_ == TexelChainSize(
+                   header.width_, header.height_, header.levels_,
+                   static_cast<TEXEL_LAYOUT>(header.layout_), false) &&
+               static_cast<uint64_t>(st.st_size) >=
+                   header.dataOffset_ + header.dataSize_;
+
+  auto pixels = std::make_shared<MAPPED_PIXELS>();
+  if (valid) {
+    void* map = mmap(nullptr, header.dataSize_, PROT_READ,
+                     MAP_PRIVATE | MAP_POPULATE, fd,
+                     static_cast<off_t>(header.dataOffset_));
+    if (map != MAP_FAILED) {
+      pixels->map_ = map;
+      pixels->mapSize_ = header.dataSize_;
+      pixels->data_ = static_cast<const uint8_t*>(map);
+      pixels->width_ = header.width_;
+      pixels->height_ = header.height_;
+      pixels->levels_ = header.levels_;
+      pixels->layout_ = static_cast<TEXEL_LAYOUT>(header.layout_);
+      pixels->memory_ = TrackedAllocation(MEMORY_CATEGORY::MAPPED_FILE,
+                                          key.name_, header.dataSize_);
+      futimens(fd, nullptr);   // most recently used
+    } else {
+      LOGW("mmap(%s) failed: %s", path.c_str(), strerror(errno));
+      valid = false;
+    }
+  }
+  close(fd);
+
+  if (!valid) {
+    LOGI("Cached pixels %s are stale", path.c_str());
+    unlink(path.c_str());
+    return nullptr;
+  }
+  return pixels;
+}
+
+/*
+ * Store()
+ *    The blocks are allocated up front (posix_fallocate()): a full disk
+ *    fails here instead of raising SIGBUS while filling the mapping.
+ */
+bool PixelCache::Store(const PIXEL_CACHE_KEY& key, uint32_t width,
+                       uint32_t height, uint32_t levels, TEXEL_LAYOUT layout,
+                       const std::function<void(uint8_t*)>& fill) {
+  mkdir(dir_.c_str(), 0700);
+  size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  PIXEL_FILE_HEADER header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic_, PIXEL_FILE_MAGIC, 4);
+  header.version_ = PIXEL_FILE_VERSION;
+  header.contentHash_ = key.contentHash_;
+  header.space_ = key.space_;
+  header.format_ = key.format_;
+  header.maxWidth_ = key.maxWidth_;
+  header.maxHeight_ = key.maxHeight_;
+  header.mipmaps_ = key.mipmaps_ ? 1 : 0;
+  header.width_ = width;
+  header.height_ = height;
+  header.levels_ = levels;
+  header.layout_ = layout;
+  header.dataOffset_ = (sizeof(header) + pageSize - 1) / pageSize * pageSize;
+  size_t size = TexelChainSize(width, height, levels, layout, false);
+  header.dataSize_ = size;
+
+  std::string path = FilePath(key);
+  bool status = WriteCacheFile(path, [&](int fd) {
+    if (posix_fallocate(fd, 0, static_cast<off_t>(
+            header.dataOffset_ + header.dataSize_)) != 0 ||
+        pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+      return false;
+    }
+    void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                     static_cast<off_t>(header.dataOffset_));
+    if (map == MAP_FAILED) {
+      return false;
+    }
+    TrackedAllocation memory(MEMORY_CATEGORY::MAPPED_FILE, key.name_, size);
+    fill(static_cast<uint8_t*>(map));
+    munmap(map, size);
+    return true;
+  });
+  if (!status) {
+    LOGW("Cannot write cached pixels %s", path.c_str());
+    return false;
+  }
+  Trim();
+  return true;
+}
+
+void PixelCache::Budget(size_t bytes) {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    budget_ = bytes;
+  }
+  Trim();
+}
+
+void PixelCache::Trim(void) {
+  std::lock_guard<std::mutex> guard(lock_);
+  TrimCacheDir(dir_, PIXEL_FILE_SUFFIX, budget_);
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __PIXEL_CACHE_H__
+#define __PIXEL_CACHE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "common.h"
+#include "MemoryTracker.h"
+#include "TextureFormat.h"
+
+/*
+ * Upload ready pixels of a texture, mapped from a cache file: a
+ * TexelChainSize() mip chain in layout_ as AssetTexture::FillTextures()
+ * writes it. Unmapped with the last reference.
+ */
+struct MAPPED_PIXELS {
+  uint32_t width_, height_, levels_;
+  TEXEL_LAYOUT layout_;
+  const uint8_t* data_;
+
+  MAPPED_PIXELS() : width_(0), height_(0), levels_(0), layout_(TEXEL_RGBA),
+                    data_(nullptr), map_(nullptr), mapSize_(0) {}
+  ~MAPPED_PIXELS();
+  MAPPED_PIXELS(const MAPPED_PIXELS&) = delete;
+  MAPPED_PIXELS& operator=(const MAPPED_PIXELS&) = delete;
+
+  void* map_;
+  size_t mapSize_;
+  TrackedAllocation memory_;   // MAPPED_FILE bytes of the mapping
+};
+
+/*
+ * What the pixels were made from; a file written for another key is
+ * dropped
+ */
+struct PIXEL_CACHE_KEY {
+  std::string name_;          // asset
+  uint64_t contentHash_;      // AssetContentHash() of the asset
+  DISPLAY_COLORSPACE space_;
+  uint32_t format_;           // GL internal format of TEXEL_RGBA pixels
+  uint32_t maxWidth_, maxHeight_;   // decode-time downscale limits
+  bool mipmaps_;
+};
+
+/*
+ * PixelCache
+ *    Color transformed textures persisted under dir/pixels, one file per
+ *    image: a header padded to a page, then the raw pixels, so that a hit
+ *    is a single mmap() the GL thread uploads from, with no decoding or
+ *    transform. Files are written through a shared mapping as well.
+ *    The directory is kept under a byte budget, least recently used files
+ *    (by modification time, refreshed on every hit) going first.
+ *    Thread safe.
+ */
+class PixelCache {
+public:
+  explicit PixelCache(const std::string& dir, size_t budget = kDefaultBudget);
+
+  std::shared_ptr<const MAPPED_PIXELS> Load(const PIXEL_CACHE_KEY& key);
+  // fill writes the pixels (TexelChainSize() bytes in layout) into the
+  // file's mapping
+  bool Store(const PIXEL_CACHE_KEY& key, uint32_t width, uint32_t height,
+             uint32_t levels, TEXEL_LAYOUT layout,
+             const std::function<void(uint8_t*)>& fill);
+
+  void Budget(size_t bytes);
+  // Deletes least recently used files until the directory fits the budget
+  void Trim(void);
+
+  static constexpr size_t kDefaultBudget = 256 * 1024 * 1024;
+
+private:
+  std::string FilePath(const PIXEL_CACHE_KEY& key);
+
+  std::string dir_;
+  std::mutex lock_;   // Trim() and the budget
+  size_t budget_;
+};
+
+#endif // __PIXEL_CACHE_H__
@@ -0,0 +1,363 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "PngRowReader.h"
+#include "android_debug.h"
+
+#define PNG_INPUT_BUFFER_SIZE  (64 * 1024)
+
+static uint32_t BigEndian32(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+PngRowReader::PngRowReader(const READ_FUNC& read) :
+    read_(read), inflating_(false), width_(0), height_(0), bitDepth_(0),
+    colorType_(0), profile_(PNG_PROFILE_NONE), channels_(0), rowBytes_(0), pixelBytes_(0),
+    hasKey_(false), idatRemaining_(0), idatDone_(false), y_(0) {
+  memset(&stream_, 0, sizeof(stream_));
+  for (auto& entry : palette_) {
+    entry[0] = entry[1] = entry[2] = 0;
+    entry[3] = 255;
+  }
+  key_[0] = key_[1] = key_[2] = 0;
+}
+
+PngRowReader::~PngRowReader() {
+  if (inflating_) {
+    inflateEnd(&stream_);
+  }
+}
+
+bool PngRowReader::ReadFully(void* buf, size_t size) {
+  uint8_t* dst = static_cast<uint8_t*>(buf);
+  while (size) {
+    int64_t count = read_(dst, size);
+    if (count <= 0) {
+      return false;
+    }
+    dst += count;
+    size -= static_cast<size_t>(count);
+  }
+  return true;
+}
+
+bool PngRowReader::Skip(size_t size) {
+  uint8_t buf[4096];
+  while (size) {
+    size_t count = std::min(size, sizeof(buf));
+    if (!ReadFully(buf, count)) {
+      return false;
+    }
+    size -= count;
+  }
+  return true;
+}
+
+bool PngRowReader::ReadChunkHeader(uint32_t* length, char* type) {
+  uint8_t header[8];
+  if (!ReadFully(header, sizeof(header))) {
+    return false;
+  }
+  *length = BigEndian32(header);
+  memcpy(type, header + 4, 4);
+  return true;
+}
+
+/*
+ * Open()
+ *    Takes IHDR, PLTE and tRNS; other chunks before the first IDAT are
+ *    skipped. CRCs are not checked, as with stb_image.
+ */
+bool PngRowReader::Open(void) {
+  static const uint8_t kSignature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+  uint8_t signature[8];
+  if (!ReadFully(signature, sizeof(signature)) ||
+      memcmp(signature, kSignature, sizeof(kSignature))) {
+    LOGE("Not a PNG file");
+    return false;
+  }
+
+  bool hasHeader = false;
+  while (true) {
+    uint32_t length;
+    char type[4];
+    if (!ReadChunkHeader(&length, type)) {
+      LOGE("PNG file ends before its image data");
+      return false;
+    }
+    if (!memcmp(type, "IDAT", 4)) {
+      if (!hasHeader) {
+        LOGE("PNG image data before IHDR");
+        return false;
+      }
+      idatRemaining_ = length;
+      break;
+    }
+
+    // color chunks are only noted, the data is skipped below
+    PNG_PROFILE profile = !memcmp(type, "iCCP", 4) ? PNG_PROFILE_ICC :
+                          !memcmp(type, "sRGB", 4) ? PNG_PROFILE_SRGB :
+                          (!memcmp(type, "gAMA", 4) || !memcmp(type, "cHRM", 4)) ?
+                              PNG_PROFILE_GAMMA : PNG_PROFILE_NONE;
+    profile_ = std::max(profile_, profile);
+
+    if (!memcmp(type, "IHDR", 4) && length == 13) {
+      uint8_t ihdr[13];
+      if (!ReadFully(ihdr, sizeof(ihdr))) {
+        return false;
+      }
+      width_ = BigEndian32(ihdr);
+      height_ = BigEndian32(ihdr + 4);
+      bitDepth_ = ihdr[8];
+      colorType_ = ihdr[9];
+      if (ihdr[12]) {
+        LOGE("Interlaced PNGs cannot be streamed");
+        return false;
+      }
+      hasHeader = true;
+    } else if (!memcmp(type, "PLTE", 4) && length % 3 == 0 && length <= 768) {
+      uint8_t plte[768];
+      if (!ReadFully(plte, length)) {
+        return false;
+      }
+      for (uint32_t idx = 0; idx < length / 3; idx++) {
+        memcpy(palette_[idx], plte + idx * 3, 3);
+      }
+    } else if (!memcmp(type, "tRNS", 4) && hasHeader) {
+      uint8_t trns[256];
+      if (length > sizeof(trns) || !ReadFully(trns, length)) {
+        return false;
+      }
+      if (colorType_ == 3) {
+        for (uint32_t idx = 0; idx < length; idx++) {
+          palette_[idx][3] = trns[idx];
+        }
+      } else if ((colorType_ == 0 && length == 2) ||
+                 (colorType_ == 2 && length == 6)) {
+        for (uint32_t idx = 0; idx < length / 2; idx++) {
+          key_[idx] = static_cast<uint16_t>((trns[idx * 2] << 8) | trns[idx * 2 + 1]);
+        }
+        hasKey_ = true;
+      }
+    } else if (!memcmp(type, "IEND", 4)) {
+      LOGE("PNG file without image data");
+      return false;
+    } else if (!Skip(length)) {
+      return false;
+    }
+    if (!Skip(4)) {   // CRC
+      return false;
+    }
+  }
+
+  switch (colorType_) {
+    case 0: channels_ = 1; break;
+    case 2: channels_ = 3; break;
+    case 3: channels_ = 1; break;
+    case 4: channels_ = 2; break;
+    case 6: channels_ = 4; break;
+    default:
+      LOGE("Unknown PNG color type %u", colorType_);
+      return false;
+  }
+  bool validDepth = (bitDepth_ == 8) ||
+                    (bitDepth_ == 16 && colorType_ != 3) ||
+                    ((bitDepth_ == 1 || bitDepth_ == 2 || bitDepth_ == 4) &&
+                     (colorType_ == 0 || colorType_ == 3));
+  if (!validDepth || !width_ || !height_) {
+    LOGE("Invalid PNG: %ux%u, %u bits, color type %u", width_, height_,
+         bitDepth_, colorType_);
+    return false;
+  }
+  rowBytes_ = (static_cast<uint64_t>(width_) * channels_ * bitDepth_ + 7) / 8;
+  pixelBytes_ = std::max(1u, channels_ * bitDepth_ / 8);
+
+  if (inflateInit(&stream_) != Z_OK) {
+    return false;
+  }
+  inflating_ = true;
+  input_.resize(PNG_INPUT_BUFFER_SIZE);
+  row_.resize(rowBytes_ + 1);
+  prev_.assign(rowBytes_ + 1, 0);
+  y_ = 0;
+  return true;
+}
+
+/*
+ * FillInput()
+ *    Next piece of the zlib stream, which runs on across IDAT chunks
+ */
+bool PngRowReader::FillInput(void) {
+  while (!idatRemaining_) {
+    uint32_t length;
+    char type[4];
+    if (idatDone_ || !Skip(4) || !ReadChunkHeader(&length, type)) {
+      return false;
+    }
+    if (memcmp(type, "IDAT", 4)) {
+      idatDone_ = true;
+      return false;
+    }
+    idatRemaining_ = length;
+  }
+  size_t size = std::min(input_.size(), static_cast<size_t>(idatRemaining_));
+  if (!ReadFully(input_.data(), size)) {
+    return false;
+  }
+  idatRemaining_ -= static_cast<uint32_t>(size);
+  stream_.next_in = input_.data();
+  stream_.avail_in = static_cast<uInt>(size);
+  return true;
+}
+
+bool PngRowReader::ReadRow(uint8_t* rgba) {
+  if (!inflating_ || y_ >= height_) {
+    return false;
+  }
+  stream_.next_out = row_.data();
+  stream_.avail_out = static_cast<uInt>(row_.size());
+  while (stream_.avail_out) {
+    if (!stream_.avail_in && !FillInput()) {
+      LOGE("PNG image data ends at row %u of %u", y_, height_);
+      return false;
+    }
+    int status = inflate(&stream_, Z_NO_FLUSH);
+    if (status == Z_STREAM_END) {
+      if (stream_.avail_out) {
+        LOGE("PNG image data ends at row %u of %u", y_, height_);
+        return false;
+      }
+      break;
+    }
+    if (status != Z_OK) {
+      LOGE("PNG inflate error %d at row %u", status, y_);
+      return false;
+    }
+  }
+  if (row_[0] > 4) {
+    LOGE("Invalid PNG filter %u at row %u", row_[0], y_);
+    return false;
+  }
+  Unfilter();
+  Expand(rgba);
+  row_.swap(prev_);
+  y_++;
+  return true;
+}
+
+/*
+ * Unfilter()
+ *    Undoes the row's filter (PNG spec, 9.2) in place, prev_ being the
+ *    previous row already unfiltered (zeros for the first one)
+ */
+void PngRowReader::Unfilter(void) {
+  uint8_t* cur = row_.data() + 1;
+  const uint8_t* prior = prev_.data() + 1;
+  size_t bpp = pixelBytes_;
+  switch (row_[0]) {
+    case 1:   // Sub
+      for (size_t idx = bpp; idx < rowBytes_; idx++) {
+        cur[idx] = static_cast<uint8_t>(cur[idx] + cur[idx - bpp]);
+      }
+      break;
+    case 2:   // Up
+      for (size_t idx = 0; idx < rowBytes_; idx++) {
+        cur[idx] = static_cast<uint8_t>(cur[idx] + prior[idx]);
+      }
+      break;
+    case 3:   // Average
+      for (size_t idx = 0; idx < rowBytes_; idx++) {
+        uint32_t left = (idx >= bpp) ? cur[idx - bpp] : 0;
+        cur[idx] = static_cast<uint8_t>(cur[idx] + ((left + prior[idx]) >> 1));
+      }
+      break;
+    case 4:   // Paeth
+      for (size_t idx = 0; idx < rowBytes_; idx++) {
+        int32_t a = (idx >= bpp) ? cur[idx - bpp] : 0;
+        int32_t b = prior[idx];
+        int32_t c = (idx >= bpp) ? prior[idx - bpp] : 0;
+        int32_t p = a + b - c;
+        int32_t pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+        int32_t pred = (pa <= pb && pa <= pc) ? a : ((pb <= pc) ? b : c);
+        cur[idx] = static_cast<uint8_t>(cur[idx] + pred);
+      }
+      break;
+    default:  // None
+      break;
+  }
+}
+
+void PngRowReader::Expand(uint8_t* rgba) {
+  const uint8_t* src = row_.data() + 1;
+  if (bitDepth_ < 8) {
+    // packed gray levels or palette indices, most significant bits first
+    uint32_t mask = (1u << bitDepth_) - 1;
+    for (uint32_t x = 0; x < width_; x++, rgba += 4) {
+      uint32_t bit = x * bitDepth_;
+      uint32_t val = (src[bit >> 3] >> (8 - bitDepth_ - (bit & 7))) & mask;
+      if (colorType_ == 3) {
+        memcpy(rgba, palette_[val], 4);
+      } else {
+        rgba[0] = rgba[1] = rgba[2] = static_cast<uint8_t>(val * 255 / mask);
+        rgba[3] = (hasKey_ && val == key_[0]) ? 0 : 255;
+      }
+    }
+    return;
+  }
+
+  // 8 bit samples, or the high byte of 16 bit ones
+  const uint32_t step = bitDepth_ / 8;
+  auto sample8 = [src, step](uint32_t idx) -> uint8_t {
+    return src[idx * step];
+  };
+  auto sample = [src, step](uint32_t idx) -> uint32_t {
+    return (step == 2) ? static_cast<uint32_t>((src[idx * 2] << 8) | src[idx * 2 + 1])
+                       : src[idx];
+  };
+  for (uint32_t x = 0; x < width_; x++, rgba += 4) {
+    uint32_t base = x * channels_;
+    switch (colorType_) {
+      case 0:
+        rgba[0] = rgba[1] = rgba[2] = sample8(base);
+        rgba[3] = (hasKey_ && sample(base) == key_[0]) ? 0 : 255;
+        break;
+      case 2:
+        rgba[0] = sample8(base);
+        rgba[1] = sample8(base + 1);
+        rgba[2] = sample8(base + 2);
+        rgba[3] = (hasKey_ && sample(base) == key_[0] &&
+                   sample(base + 1) == key_[1] &&
+                   sample(base + 2) == key_[2]) ? 0 : 255;
+        break;
+      case 3:
+        memcpy(rgba, palette_[src[x]], 4);
+        break;
+      case 4:
+        rgba[0] = rgba[1] = rgba[2] = sample8(base);
+        rgba[3] = sample8(base + 1);
+        break;
+      default:
+        rgba[0] = sample8(base);
+        rgba[1] = sample8(base + 1);
+        rgba[2] = sample8(base + 2);
+        rgba[3] = sample8(base + 3);
+        break;
+    }
+  }
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __PNG_ROW_READER_H__
+#define __PNG_ROW_READER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <zlib.h>
+
+// Color information a PNG declares, strongest first when it has several
+enum PNG_PROFILE : uint32_t {
+  PNG_PROFILE_NONE,           // nothing: the viewer assumes Display P3
+  PNG_PROFILE_GAMMA,          // gAMA / cHRM only
+  PNG_PROFILE_SRGB,           // sRGB chunk
+  PNG_PROFILE_ICC,            // embedded ICC profile (iCCP)
+};
+
+/*
+ * PngRowReader
+ *    Decodes a PNG top to bottom, one row at a time, to R8G8B8A8 (the
+ *    layout stb_image gives SourceImageCache): 16 bit samples keep their
+ *    high byte, gray and palette images are expanded, tRNS becomes alpha.
+ *    Memory is two rows plus the inflate state, whatever the image size,
+ *    so images too large to decode at once can be streamed.
+ *    Interlaced (Adam7) files are refused: their first rows only come at
+ *    the end of the data.
+ */
+class PngRowReader {
+public:
+  // read(buf, size): up to size bytes of the file into buf, <= 0 at the end
+  using READ_FUNC = std::function<int64_t(void* buf, size_t size)>;
+
+  explicit PngRowReader(const READ_FUNC& read);
+  ~PngRowReader();
+  PngRowReader(const PngRowReader&) = delete;
+  PngRowReader& operator=(const PngRowReader&) = delete;
+
+  // Reads the chunks up to the image data
+  bool Open(void);
+  uint32_t Width(void) const { return width_; }
+  uint32_t Height(void) const { return height_; }
+  PNG_PROFILE Profile(void) const { return profile_; }
+  // Next row, Width() R8G8B8A8 pixels
+  bool ReadRow(uint8_t* rgba);
+
+private:
+  bool ReadFully(void* buf, size_t size);
+  bool Skip(size_t size);
+  bool ReadChunkHeader(uint32_t* length, char* type);
+  bool FillInput(void);
+  void Unfilter(void);
+  void Expand(uint8_t* rgba);
+
+  READ_FUNC read_;
+  z_stream stream_;
+  bool inflating_;
+
+  uint32_t width_, height_;
+  uint32_t bitDepth_, colorType_;
+  PNG_PROFILE profile_;
+  uint32_t channels_;
+  size_t rowBytes_;           // packed samples of a row, no filter byte
+  size_t pixelBytes_;         // filter distance
+  uint8_t palette_[256][4];
+  bool hasKey_;               // tRNS color key of gray / RGB images
+  uint16_t key_[3];
+
+  std::vector<uint8_t> input_;
+  uint32_t idatRemaining_;    // of the current IDAT chunk
+  bool idatDone_;
+  std::vector<uint8_t> row_, prev_;   // filter byte + rowBytes_
+  uint32_t y_;
+};
+
+#endif // __PNG_ROW_READER_H__
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "QuadRenderer.h"
+#include "android_debug.h"
+
+QuadRenderer::QuadRenderer() :
+    vao_(0), buffer_(0), boundVao_(0), program_(0) {
+}
+
+QuadRenderer::~QuadRenderer() {
+  // the geometry is owned by the context; Destroy() must have run while it
+  // was current
+}
+
+/*
+ * Create()
+ *    Corners of the unit quad as a triangle strip, in location 0 (vCorner)
+ */
+bool QuadRenderer::Create(void) {
+  static const GLfloat corners[] = { 0.0f, 0.0f,  1.0f, 0.0f,
+                                     0.0f, 1.0f,  1.0f, 1.0f };
+  Destroy();
+  glGenVertexArrays(1, &vao_);
+  glGenBuffers(1, &buffer_);
+  BindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 2, nullptr);
+  glEnableVertexAttribArray(0);
+  GLenum error = glGetError();
+  if (error != GL_NO_ERROR) {
+    LOGE("Quad geometry failed: %#x", error);
+    Destroy();
+    return false;
+  }
+  return true;
+}
+
+void QuadRenderer::Destroy(void) {
+  if (vao_) {
+    glDeleteVertexArrays(1, &vao_);
+    glDeleteBuffers(1, &buffer_);
+  }
+  vao_ = buffer_ = 0;
+  boundVao_ = 0;
+  program_ = 0;
+}
+
+void QuadRenderer::Draw(ShaderProgram& program, const GLfloat screen[4],
+                        const GLfloat tex[4], GLfloat layer) {
+  BindVertexArray(vao_);
+  UseProgram(program.getProgram());
+  program.setQuad(screen, tex, layer);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+void QuadRenderer::BindVertexArray(GLuint vao) {
+  if (vao != boundVao_) {
+    glBindVertexArray(vao);
+    boundVao_ = vao;
+  }
+}
+
+void QuadRenderer::UseProgram(GLuint program) {
+  if (program != program_) {
+    glUseProgram(program);
+    program_ = program;
+  }
+}
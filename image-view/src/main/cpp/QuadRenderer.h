@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __QUAD_RENDERER_H__
+#define __QUAD_RENDERER_H__
+
+#include <GLES3/gl32.h>
+#include "ShaderProgram.h"
+
+/*
+ * QuadRenderer
+ *    Draws the viewer's quads: one static unit quad (a VBO in a VAO, made
+ *    once per context by Create()) placed by each program's uniforms
+ *    (ShaderProgram::setQuad()). Keeps track of the vertex array bound and
+ *    the program in use, so that binds which change nothing are skipped;
+ *    other draws (the grid) bind through it too. Showing the same view as
+ *    the frame before comes down to a glUseProgram() and a glDrawArrays()
+ *    per half. GL thread only.
+ */
+class QuadRenderer {
+public:
+  QuadRenderer();
+  ~QuadRenderer();
+
+  // With the context current, after the programs are linked
+  bool Create(void);
+  // Deletes the geometry (before the context goes away)
+  void Destroy(void);
+
+  // screen and tex are left, top, right, bottom (VIEW_RECT)
+  void Draw(ShaderProgram& program, const GLfloat screen[4],
+            const GLfloat tex[4], GLfloat layer);
+  void BindVertexArray(GLuint vao);
+  void UseProgram(GLuint program);
+
+private:
+  GLuint vao_;
+  GLuint buffer_;
+  GLuint boundVao_;
+  GLuint program_;   // in use
+};
+
+#endif // __QUAD_RENDERER_H__
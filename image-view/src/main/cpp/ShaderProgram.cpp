@@ -14,32 +14,13 @@
  * limitations under the License.
  *
  */
+#include <cstring>
 #include <vector>
-#include "gldebug.h"
 #include "android_debug.h"
 #include "ShaderProgram.h"
+#include "ShaderSource.h"
 
 
-static const char gVertexShader[] =
-    "#version 300 es                         \n"
-    "layout (location = 0) in vec4 vPosition;\n"
-    "layout (location = 1) in vec2 vTexture;\n"
-    "out vec2 vertex_tex;   \n"
-    "void main() {          \n"
-    "  gl_Position = vPosition;\n"
-    "  vertex_tex = vTexture;              \n"
-    "}\n";
-
-static const char gFragmentShader[] =
-    "#version 300 es         \n"
-    "precision mediump float;\n"
-    "in vec2 vertex_tex;     \n"
-    "uniform sampler2D samplerObj; \n"
-    "layout(location = 0) out vec4 oColor;      \n"
-    "void main() { \n"
-    "    oColor = texture(samplerObj, vertex_tex); \n"
-    "} \n";
-
 GLuint loadShader(GLenum shaderType, const char* pSource) {
   GLuint shader = glCreateShader(shaderType);
   if (shader) {
@@ -67,6 +48,12 @@ GLuint loadShader(GLenum shaderType, const char* pSource) {
 GLuint ShaderProgram::createProgram(void) {
   return createProgram(gVertexShader, gFragmentShader);
 }
+GLuint ShaderProgram::createGamutClipProgram(void) {
+  return createProgram(gVertexShader, gGamutClipFragmentShader);
+}
+GLuint ShaderProgram::createGridProgram(void) {
+  return createProgram(gGridVertexShader, gGridFragmentShader);
+}
 GLuint ShaderProgram::createProgram(const char* pVertexSource, const char* pFragmentSource) {
   GLuint vertexShader = loadShader(GL_VERTEX_SHADER, pVertexSource);
   if (!vertexShader) {
@@ -99,16 +86,72 @@ GLuint ShaderProgram::createProgram(const char* pVertexSource, const char* pFrag
       gProgram_ = 0;
       ASSERT(false, "Link Program failed");
     } else {
-      gvPositionHandle_ = glGetAttribLocation(gProgram_, "vPosition");
-      gvTxtHandle_  = glGetAttribLocation(gProgram_, "vTexture");
+      // -1 for the uniforms a program does not have; glUniform*() ignores it
+      samplerLoc_ = glGetUniformLocation(gProgram_, "samplerObj");
+      layerLoc_ = glGetUniformLocation(gProgram_, "textureLayer");
+      screenRectLoc_ = glGetUniformLocation(gProgram_, "screenRect");
+      texRectLoc_ = glGetUniformLocation(gProgram_, "texRect");
+      toClipLoc_ = glGetUniformLocation(gProgram_, "toClipGamut");
+      fromClipLoc_ = glGetUniformLocation(gProgram_, "fromClipGamut");
+      encodeGammaLoc_ = glGetUniformLocation(gProgram_, "encodeGamma");
+      quadSet_ = clipSet_ = false;
+      // everything samples texture unit 0
+      glUseProgram(gProgram_);
+      glUniform1i(samplerLoc_, 0);
+      glUseProgram(0);
     }
   }
 
   return gProgram_;
 }
 
-GLint ShaderProgram::getSamplerLoc(void) {
+/*
+ * setQuad()
+ *    screen and tex are left, top, right, bottom (VIEW_RECT)
+ */
+void ShaderProgram::setQuad(const GLfloat screen[4], const GLfloat tex[4],
+                            GLfloat layer) {
   ASSERT(gProgram_, "Shader is not created");
-  return glGetUniformLocation(gProgram_, "samplerObj");
+  if (!quadSet_ || memcmp(screen_, screen, sizeof(screen_))) {
+    glUniform4fv(screenRectLoc_, 1, screen);
+    memcpy(screen_, screen, sizeof(screen_));
+  }
+  if (!quadSet_ || memcmp(tex_, tex, sizeof(tex_))) {
+    glUniform4fv(texRectLoc_, 1, tex);
+    memcpy(tex_, tex, sizeof(tex_));
+  }
+  if (!quadSet_ || layer_ != layer) {
+    glUniform1f(layerLoc_, layer);
+    layer_ = layer;
+  }
+  quadSet_ = true;
 }
 
+
+/*
+ * setGamutClip()
+ *    Uniforms of a createGamutClipProgram() program, which must be in use.
+ *    encodeGamma 0: sampled texels and output are linear (sRGB formats)
+ */
+void ShaderProgram::setGamutClip(const android::mat3& toClip,
+                                 const android::mat3& fromClip,
+                                 float encodeGamma) {
+  ASSERT(gProgram_, "Shader is not created");
+  GLfloat matrices[2][9];
+  for (int c = 0; c < 3; c++) {
+    for (int r = 0; r < 3; r++) {
+      matrices[0][c * 3 + r] = toClip[c][r];    // both column major
+      matrices[1][c * 3 + r] = fromClip[c][r];
+    }
+  }
+  if (clipSet_ && !memcmp(clipMatrices_, matrices, sizeof(matrices)) &&
+      encodeGamma_ == encodeGamma) {
+    return;
+  }
+  glUniformMatrix3fv(toClipLoc_, 1, GL_FALSE, matrices[0]);
+  glUniformMatrix3fv(fromClipLoc_, 1, GL_FALSE, matrices[1]);
+  glUniform1f(encodeGammaLoc_, encodeGamma);
+  memcpy(clipMatrices_, matrices, sizeof(matrices));
+  encodeGamma_ = encodeGamma;
+  clipSet_ = true;
+}
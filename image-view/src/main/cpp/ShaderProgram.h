@@ -18,20 +18,49 @@
 #define __SHADER_PROGRAM_H__
 
 #include <GLES3/gl32.h>
+#include "ColorSpaceMatrices.h"
 
+/*
+ * ShaderProgram
+ *    A linked program and its uniform locations, looked up once at link
+ *    time. Remembers the values it was last given (setQuad(),
+ *    setGamutClip()) and only uploads what changed: GL keeps uniforms per
+ *    program, so a view drawn like the frame before costs no glUniform*().
+ */
 class ShaderProgram {
 public:
   ShaderProgram() {};
   GLuint createProgram(void);
+  // Samples one texture and clips it to another gamut (setGamutClip())
+  GLuint createGamutClipProgram(void);
+  // Thumbnails of the grid, one instance per cell (gGridVertexShader)
+  GLuint createGridProgram(void);
   GLuint createProgram(const char* pVertexSource, const char* pFragmentSource);
-  GLuint getAttribLocation() const { return gvPositionHandle_; }
-  GLuint getAttribLocationTex() const { return gvTxtHandle_; }
   GLuint getProgram() const { return gProgram_; }
-  GLint  getSamplerLoc(void);
+  GLint  getSamplerLoc(void) const { return samplerLoc_; }
+  GLint  getLayerLoc(void) const { return layerLoc_; }
+  // Placement of the unit quad (gVertexShader); the program must be in use
+  void   setQuad(const GLfloat screen[4], const GLfloat tex[4], GLfloat layer);
+  void   setGamutClip(const android::mat3& toClip,
+                      const android::mat3& fromClip, float encodeGamma);
 private:
   GLuint gProgram_;
-  GLuint gvPositionHandle_;
-  GLuint gvTxtHandle_;
+  GLint samplerLoc_;
+  GLint layerLoc_;
+  GLint screenRectLoc_;
+  GLint texRectLoc_;
+  GLint toClipLoc_;
+  GLint fromClipLoc_;
+  GLint encodeGammaLoc_;
+
+  // last uploaded values, valid once quadSet_ / clipSet_
+  bool quadSet_;
+  GLfloat screen_[4];
+  GLfloat tex_[4];
+  GLfloat layer_;
+  bool clipSet_;
+  GLfloat clipMatrices_[2][9];
+  GLfloat encodeGamma_;
 };
 
 #endif // __SHADER_PROGRAM_H__
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __SHADER_SOURCE_H__
+#define __SHADER_SOURCE_H__
+
+/*
+ * GLSL sources of the viewer's programs; plain data so that host tools
+ * (tools/GamutClipCheck.cpp, tools/DrawBench.cpp) build exactly the shaders
+ * the app runs.
+ */
+
+/*
+ * Every quad is the same static unit quad (QuadRenderer): vCorner goes
+ * from 0, 0 (left, top) to 1, 1 (right, bottom), and the uniforms place
+ * it: screenRect in clip space, texRect in normalized texture coordinates,
+ * both left, top, right, bottom (VIEW_RECT)
+ */
+static const char gVertexShader[] =
+    "#version 300 es\n"
+    "layout (location = 0) in vec2 vCorner;\n"
+    "uniform vec4 screenRect;\n"
+    "uniform vec4 texRect;\n"
+    "out vec2 vertex_tex;\n"
+    "void main() {\n"
+    "  gl_Position = vec4(mix(screenRect.xy, screenRect.zw, vCorner), 0.0, 1.0);\n"
+    "  vertex_tex = mix(texRect.xy, texRect.zw, vCorner);\n"
+    "}\n";
+
+/*
+ * Images live in texture arrays (TextureArrayPool): textureLayer picks one
+ */
+static const char gFragmentShader[] =
+    "#version 300 es         \n"
+    "precision mediump float;\n"
+    "in vec2 vertex_tex;     \n"
+    "uniform mediump sampler2DArray samplerObj; \n"
+    "uniform float textureLayer; \n"
+    "layout(location = 0) out vec4 oColor;      \n"
+    "void main() { \n"
+    "    oColor = texture(samplerObj, vec3(vertex_tex, textureLayer)); \n"
+    "} \n";
+
+/*
+ * Shows the texture clipped to another gamut: linear RGB goes through
+ * toClipGamut, is clamped to [0, 1] and comes back with fromClipGamut.
+ * With sRGB textures and framebuffer (encodeGamma 0) the GPU linearizes
+ * texels and encodes the output; when the EOTF is bypassed (P3
+ * passthrough) the shader does both with the app's transfer function:
+ *   linear = c / 12.92                                c < 0.04045
+ *            ((c + 0.055) / 1.055) ^ (1 / encodeGamma)  otherwise
+ */
+static const char gGamutClipFragmentShader[] =
+    "#version 300 es\n"
+    "precision highp float;\n"
+    "in vec2 vertex_tex;\n"
+    "uniform mediump sampler2DArray samplerObj;\n"
+    "uniform float textureLayer;\n"
+    "uniform mat3 toClipGamut;\n"
+    "uniform mat3 fromClipGamut;\n"
+    "uniform float encodeGamma;\n"
+    "layout(location = 0) out vec4 oColor;\n"
+    "vec3 Decode(vec3 c) {\n"
+    "  vec3 curve = pow((c + 0.055) / 1.055, vec3(1.0 / encodeGamma));\n"
+    "  return mix(curve, c / 12.92, lessThan(c, vec3(0.04045)));\n"
+    "}\n"
+    "vec3 Encode(vec3 c) {\n"
+    "  c = clamp(c, 0.0, 1.0);\n"
+    "  vec3 curve = 1.055 * pow(c, vec3(encodeGamma)) - 0.055;\n"
+    "  return mix(curve, c * 12.92, lessThan(c, vec3(0.0031308)));\n"
+    "}\n"
+    "void main() {\n"
+    "  vec4 color = texture(samplerObj, vec3(vertex_tex, textureLayer));\n"
+    "  vec3 rgb = (encodeGamma > 0.0) ? Decode(color.rgb) : color.rgb;\n"
+    "  rgb = fromClipGamut * clamp(toClipGamut * rgb, 0.0, 1.0);\n"
+    "  rgb = (encodeGamma > 0.0) ? Encode(rgb) : rgb;\n"
+    "  oColor = vec4(rgb, color.a);\n"
+    "}\n";
+
+/*
+ * Grid of thumbnails, all cells in one instanced draw: each instance is a
+ * cell, its screen rectangle (clip space) and atlas rectangle given per
+ * instance; the corner comes from gl_VertexID (a 4 vertex strip), so
+ * there is no per vertex data at all
+ */
+static const char gGridVertexShader[] =
+    "#version 300 es\n"
+    "layout (location = 0) in vec4 cellScreen;\n"
+    "layout (location = 1) in vec4 cellTexture;\n"
+    "out vec2 vertex_tex;\n"
+    "void main() {\n"
+    "  vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));\n"
+    "  gl_Position = vec4(mix(cellScreen.xy, cellScreen.zw, corner), 0.0, 1.0);\n"
+    "  vertex_tex = mix(cellTexture.xy, cellTexture.zw, corner);\n"
+    "}\n";
+
+static const char gGridFragmentShader[] =
+    "#version 300 es\n"
+    "precision mediump float;\n"
+    "in vec2 vertex_tex;\n"
+    "uniform mediump sampler2D samplerObj;\n"
+    "layout(location = 0) out vec4 oColor;\n"
+    "void main() {\n"
+    "  oColor = texture(samplerObj, vertex_tex);\n"
+    "}\n";
+
+#endif // __SHADER_SOURCE_H__
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#include <stb/stb_image.h>
+#include <cstdlib>
+#include <vector>
+
+#include "SourceImageCache.h"
+#include "ImageScaler.h"
+#include "AssetUtil.h"
+#include "android_debug.h"
+
+SOURCE_IMAGE::~SOURCE_IMAGE() {
+  if (pixels_) {
+    stbi_image_free(pixels_);
+  }
+}
+
+SourceImageCache::SourceImageCache(size_t budget) :
+    size_(0), budget_(budget) {
+}
+
+std::shared_ptr<const SOURCE_IMAGE> SourceImageCache::Find(
+    const std::string& name) {
+  std::lock_guard<std::mutex> guard(lock_);
+  auto it = entries_.find(name);
+  if (it == entries_.end()) {
+    return nullptr;
+  }
+  lru_.splice(lru_.begin(), lru_, it->second.lru_);
+  return it->second.image_;
+}
+
+std::shared_ptr<const SOURCE_IMAGE> SourceImageCache::Get(
+    AAssetManager* mgr, const std::string& name,
+    uint32_t maxWidth, uint32_t maxHeight) {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    auto it = entries_.find(name);
+    if (it != entries_.end() && it->second.maxWidth_ == maxWidth &&
+        it->second.maxHeight_ == maxHeight) {
+      lru_.splice(lru_.begin(), lru_, it->second.lru_);
+      return it->second.image_;
+    }
+  }
+
+  // Decode outside of the lock: it is the expensive part
+  std::vector<uint8_t> fileData;
+  std::string assetName(name);
+  if (!AssetReadFile(mgr, assetName, fileData)) {
+    return nullptr;
+  }
+  TrackedAllocation file(MEMORY_CATEGORY::ASSET_FILE, name, fileData.size());
+  std::shared_ptr<SOURCE_IMAGE> image = std::make_shared<SOURCE_IMAGE>();
+  int width, height, n;
+  image->pixels_ = stbi_load_from_memory(fileData.data(), fileData.size(),
+                                         &width, &height, &n, 4);
+  if (!image->pixels_) {
+    LOGE("Failed to decode %s: %s", name.c_str(), stbi_failure_reason());
+    return nullptr;
+  }
+  image->width_ = image->fullWidth_ = static_cast<uint32_t>(width);
+  image->height_ = image->fullHeight_ = static_cast<uint32_t>(height);
+  image->memory_ = TrackedAllocation(MEMORY_CATEGORY::DECODED_IMAGE, name,
+                                     image->Size());
+  Downscale(image.get(), maxWidth, maxHeight);
+  // after the downscale: fewer pixels, and averages keep gray and opaque
+  image->traits_ = AnalyzeImage(image->pixels_, image->width_, image->height_,
+                                static_cast<uint32_t>(n));
+
+  std::lock_guard<std::mutex> guard(lock_);
+  auto it = entries_.find(name);
+  if (it != entries_.end()) {
+    if (it->second.maxWidth_ == maxWidth && it->second.maxHeight_ == maxHeight) {
+      // decoded by another thread in the meantime
+      lru_.splice(lru_.begin(), lru_, it->second.lru_);
+      return it->second.image_;
+    }
+    size_ -= it->second.image_->Size();
+    lru_.erase(it->second.lru_);
+    entries_.erase(it);
+  }
+  lru_.push_front(name);
+  entries_[name] = ENTRY { image, maxWidth, maxHeight, lru_.begin() };
+  size_ += image->Size();
+  Trim();
+  return image;
+}
+
+/*
+ * ScaledSize()
+ *    Each axis is limited on its own: the viewer stretches images to its
+ *    quads anyway, so only the pixels that end up on screen are kept.
+ */
+void SourceImageCache::ScaledSize(uint32_t width, uint32_t height,
+                                  uint32_t maxWidth, uint32_t maxHeight,
+                                  uint32_t* scaledWidth, uint32_t* scaledHeight) {
+  *scaledWidth = (maxWidth && width > maxWidth) ? maxWidth : width;
+  *scaledHeight = (maxHeight && height > maxHeight) ? maxHeight : height;
+}
+
+void SourceImageCache::Downscale(SOURCE_IMAGE* image,
+                                 uint32_t maxWidth, uint32_t maxHeight) {
+  uint32_t width, height;
+  ScaledSize(image->width_, image->height_, maxWidth, maxHeight,
+             &width, &height);
+  if (width == image->width_ && height == image->height_) {
+    return;
+  }
+  // stbi_image_free() in ~SOURCE_IMAGE is plain free()
+  size_t size = static_cast<size_t>(width) * height * 4;
+  uint8_t* pixels = static_cast<uint8_t*>(malloc(size));
+  if (!pixels) {
+    LOGW("No memory to downscale, keeping %ux%u", image->width_, image->height_);
+    return;
+  }
+  // both copies are alive until the swap
+  TrackedAllocation scaled(MEMORY_CATEGORY::DECODED_IMAGE,
+                           image->memory_.Image(), size);
+  ScaleImageLinear(image->pixels_, image->width_, image->height_,
+                   pixels, width, height);
+  stbi_image_free(image->pixels_);
+  image->pixels_ = pixels;
+  image->width_ = width;
+  image->height_ = height;
+  image->memory_ = std::move(scaled);
+}
+
+void SourceImageCache::Clear(void) {
+  std::lock_guard<std::mutex> guard(lock_);
+  entries_.clear();
+  lru_.clear();
+  size_ = 0;
+}
+
+void SourceImageCache::Budget(size_t bytes) {
+  std::lock_guard<std::mutex> guard(lock_);
+  budget_ = bytes;
+  Trim();
+}
+
+size_t SourceImageCache::Size(void) {
+  std::lock_guard<std::mutex> guard(lock_);
+  return size_;
+}
+
+/*
+ * Trim()
+ *    Called with lock_ held. The most recent image is always kept, even
+ *    when it alone is over budget.
+ */
+void SourceImageCache::Trim(void) {
+  while (size_ > budget_ && lru_.size() > 1) {
+    auto it = entries_.find(lru_.back());
+    size_ -= it->second.image_->Size();
+    entries_.erase(it);
+    lru_.pop_back();
+  }
+}
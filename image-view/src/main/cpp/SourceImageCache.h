@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __SOURCE_IMAGE_CACHE_H__
+#define __SOURCE_IMAGE_CACHE_H__
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <android/asset_manager.h>
+#include "MemoryTracker.h"
+#include "TextureFormat.h"
+
+/*
+ * Decoded asset pixels, R8G8B8A8 packed, before any color transform;
+ * fullWidth_ x fullHeight_ is the asset size before a decode-time downscale.
+ * traits_ keep what the pixels need of a texture (ChooseTexelLayout()).
+ */
+struct SOURCE_IMAGE {
+  uint8_t* pixels_;
+  uint32_t width_, height_;
+  uint32_t fullWidth_, fullHeight_;
+  IMAGE_TRAITS traits_;
+  TrackedAllocation memory_;   // DECODED_IMAGE bytes of pixels_
+
+  SOURCE_IMAGE() : pixels_(nullptr), width_(0), height_(0),
+                   fullWidth_(0), fullHeight_(0),
+                   traits_ { 4, true, false } {}
+  ~SOURCE_IMAGE();
+  SOURCE_IMAGE(const SOURCE_IMAGE&) = delete;
+  SOURCE_IMAGE& operator=(const SOURCE_IMAGE&) = delete;
+  size_t Size(void) const { return static_cast<size_t>(width_) * height_ * 4; }
+};
+
+/*
+ * SourceImageCache
+ *    Keeps decoded source images so that re-creating textures (display
+ *    color space switch) only re-runs the color transform and the upload.
+ *    Least recently used images are dropped above the byte budget; images
+ *    handed out stay alive until their last user releases them.
+ *    Thread safe.
+ */
+class SourceImageCache {
+public:
+  explicit SourceImageCache(size_t budget = kDefaultBudget);
+
+  // Decoded image for the asset, decoding it on a miss. nullptr on failure.
+  // Non zero maxWidth / maxHeight shrink larger images right after decoding
+  // (ScaleImageLinear()); an image cached with other limits is decoded again
+  std::shared_ptr<const SOURCE_IMAGE> Get(AAssetManager* mgr,
+                                          const std::string& name,
+                                          uint32_t maxWidth = 0,
+                                          uint32_t maxHeight = 0);
+  // The decoded image if it is cached (under any limits), never decoding
+  std::shared_ptr<const SOURCE_IMAGE> Find(const std::string& name);
+  void Clear(void);
+
+  // Size Get() gives a width x height image for these limits
+  static void ScaledSize(uint32_t width, uint32_t height,
+                         uint32_t maxWidth, uint32_t maxHeight,
+                         uint32_t* scaledWidth, uint32_t* scaledHeight);
+
+  void Budget(size_t bytes);
+  size_t Budget(void) const { return budget_; }
+  size_t Size(void);
+
+  static constexpr size_t kDefaultBudget = 64 * 1024 * 1024;
+
+private:
+  void Trim(void);
+  static void Downscale(SOURCE_IMAGE* image, uint32_t maxWidth,
+                        uint32_t maxHeight);
+
+  using LRU_LIST = std::list<std::string>;   // front: most recently used
+  struct ENTRY {
+    std::shared_ptr<const SOURCE_IMAGE> image_;
+    uint32_t maxWidth_, maxHeight_;
+    LRU_LIST::iterator lru_;
+  };
+
+  std::mutex lock_;
+  std::unordered_map<std::string, ENTRY> entries_;
+  LRU_LIST lru_;
+  size_t size_;
+  size_t budget_;
+};
+
+#endif // __SOURCE_IMAGE_CACHE_H__
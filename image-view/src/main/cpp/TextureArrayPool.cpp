@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include "TextureArrayPool.h"
+#include "TextureFormat.h"
+#include "android_debug.h"
+
+TextureArrayPool::TextureArrayPool() :
+    drawBound_(0), slack_(MEMORY_CATEGORY::GPU_TEXTURE_SLACK, "", 0) {
+}
+
+TextureArrayPool::~TextureArrayPool() {
+  // arrays are owned by the context; Reset() must have run while it was
+  // current
+}
+
+/*
+ * Plan()
+ *    Two passes: count the images of every size, then cut each size into
+ *    groups of up to kMaxLayers in gallery order. Sizes seen once stay out
+ *    of the groups.
+ */
+void TextureArrayPool::Plan(const std::vector<TEXTURE_LAYOUT>& sizes) {
+  using SIZE_KEY = std::tuple<uint32_t, uint32_t, uint32_t>;
+  struct SIZE_GROUPS {
+    uint32_t count_;
+    uint32_t remaining_;   // images not placed yet
+    int32_t group_;        // open group
+    uint32_t filled_;      // its layers handed out
+    uint32_t layers_;
+  };
+  std::map<SIZE_KEY, SIZE_GROUPS> groups;
+  for (auto& size : sizes) {
+    if (size.width_) {
+      SIZE_GROUPS& group = groups[SIZE_KEY(size.width_, size.height_, size.levels_)];
+      group.count_++;
+      group.remaining_++;
+    }
+  }
+
+  int32_t groupCount = 0;
+  plan_.assign(sizes.size(), PLAN { TEXTURE_LAYOUT { 0, 0, 0, 0 }, -1, 0, 1 });
+  for (size_t idx = 0; idx < sizes.size(); idx++) {
+    PLAN& plan = plan_[idx];
+    plan.size_ = sizes[idx];
+    if (!plan.size_.width_) {
+      continue;
+    }
+    SIZE_GROUPS& size = groups[SIZE_KEY(plan.size_.width_, plan.size_.height_,
+                                        plan.size_.levels_)];
+    if (size.count_ < 2) {
+      continue;   // the only image of its size
+    }
+    if (size.layers_ == 0 || size.filled_ == size.layers_) {
+      size.group_ = groupCount++;
+      size.layers_ = std::min(size.remaining_, kMaxLayers);
+      size.filled_ = 0;
+    }
+    plan.group_ = size.group_;
+    plan.layer_ = size.filled_++;
+    plan.layers_ = size.layers_;
+    size.remaining_--;
+  }
+  LOGI("Texture arrays: %zu images in %d groups of up to %u layers",
+       sizes.size(), groupCount, kMaxLayers);
+}
+
+/*
+ * Acquire()
+ *    The planned layer when the image came out at the planned size,
+ *    otherwise a single layer array of its own. The group's array takes
+ *    the format of the image that allocates it; images of the group
+ *    coming in another format (texel layout, ETC2 copy) get single layer
+ *    arrays too rather than a second array of mostly empty layers.
+ */
+bool TextureArrayPool::Acquire(uint32_t idx, const TEXTURE_LAYOUT& layout,
+                               ARRAY_LAYER* layer) {
+  int32_t group = -1;
+  uint32_t layers = 1;
+  *layer = ARRAY_LAYER { 0, 0 };
+  if (idx < plan_.size()) {
+    const PLAN& plan = plan_[idx];
+    if (plan.group_ >= 0 && plan.size_.width_ == layout.width_ &&
+        plan.size_.height_ == layout.height_ &&
+        plan.size_.levels_ == layout.levels_) {
+      group = plan.group_;
+      layers = plan.layers_;
+      layer->layer_ = plan.layer_;
+    }
+  }
+
+  if (group >= 0) {
+    auto it = std::find_if(arrays_.begin(), arrays_.end(),
+                           [group](const ARRAY& array) {
+                             return array.group_ == group;
+                           });
+    if (it != arrays_.end() && it->layout_ == layout) {
+      it->used_++;
+      layer->texture_ = it->texture_;
+      UpdateSlack();
+      return true;
+    }
+    if (it != arrays_.end()) {
+      group = -1;
+      layers = 1;
+      layer->layer_ = 0;
+    }
+  }
+  GLuint texture = CreateArray(layout, layers);
+  if (!texture) {
+    return false;
+  }
+  arrays_.push_back(ARRAY { texture, layout, group, layers, 1 });
+  layer->texture_ = texture;
+  UpdateSlack();
+  return true;
+}
+
+void TextureArrayPool::Release(const ARRAY_LAYER& layer) {
+  auto it = std::find_if(arrays_.begin(), arrays_.end(),
+                         [&layer](const ARRAY& array) {
+                           return array.texture_ == layer.texture_;
+                         });
+  if (it == arrays_.end()) {
+    return;
+  }
+  if (--it->used_ == 0) {
+    DeleteArray(it->texture_);
+    arrays_.erase(it);
+  }
+  UpdateSlack();
+}
+
+void TextureArrayPool::Reset(void) {
+  for (auto& array : arrays_) {
+    DeleteArray(array.texture_);
+  }
+  arrays_.clear();
+  drawBound_ = 0;
+  slack_.Reset();
+}
+
+/*
+ * UpdateSlack()
+ *    Layers in use are accounted by the images holding them (AssetTexture);
+ *    the pool accounts for the rest of its arrays
+ */
+void TextureArrayPool::UpdateSlack(void) {
+  size_t bytes = 0;
+  for (auto& array : arrays_) {
+    bytes += LayerBytes(array.layout_) * (array.layers_ - array.used_);
+  }
+  slack_.Resize(bytes);
+}
+
+void TextureArrayPool::DeleteArray(GLuint texture) {
+  // deleting a bound texture unbinds it; GL may hand its name out again
+  if (texture == drawBound_) {
+    drawBound_ = 0;
+  }
+  glDeleteTextures(1, &texture);
+}
+
+void TextureArrayPool::BindForDraw(GLuint texture) {
+  if (texture != drawBound_) {
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    drawBound_ = texture;
+  }
+}
+
+void TextureArrayPool::BindForUpload(GLuint texture) {
+  glActiveTexture(kUploadUnit);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+}
+
+void TextureArrayPool::UnbindUpload(void) {
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+size_t TextureArrayPool::AllocatedBytes(void) const {
+  size_t bytes = 0;
+  for (auto& array : arrays_) {
+    bytes += LayerBytes(array.layout_) * array.layers_;
+  }
+  return bytes;
+}
+
+size_t TextureArrayPool::LayerBytes(const TEXTURE_LAYOUT& layout) {
+  bool compressed;
+  TEXEL_LAYOUT texels = FormatTexelLayout(layout.format_, &compressed);
+  return TexelChainSize(layout.width_, layout.height_, layout.levels_, texels,
+                        compressed);
+}
+
+/*
+ * CreateArray()
+ *    Immutable storage for all layers and levels; layers are filled later
+ *    with glTexSubImage3D() / glCompressedTexSubImage3D(). Single channel
+ *    (TEXEL_GRAY) arrays sample their red channel as gray.
+ */
+GLuint TextureArrayPool::CreateArray(const TEXTURE_LAYOUT& layout,
+                                     uint32_t layers) {
+  GLuint texture;
+  glGenTextures(1, &texture);
+  BindForUpload(texture);
+  glTexStorage3D(GL_TEXTURE_2D_ARRAY, layout.levels_, layout.format_,
+                 layout.width_, layout.height_, layers);
+  GLenum error = glGetError();
+  if (error != GL_NO_ERROR) {
+    LOGE("glTexStorage3D(%ux%u, %u levels, %u layers, %#x) failed: %#x",
+         layout.width_, layout.height_, layout.levels_, layers,
+         layout.format_, error);
+    UnbindUpload();
+    glDeleteTextures(1, &texture);
+    return 0;
+  }
+  glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                  (layout.levels_ > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  bool compressed;
+  if (FormatTexelLayout(layout.format_, &compressed) == TEXEL_GRAY) {
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_G, GL_RED);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_B, GL_RED);
+  }
+  UnbindUpload();
+  return texture;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __TEXTURE_ARRAY_POOL_H__
+#define __TEXTURE_ARRAY_POOL_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <GLES3/gl32.h>
+#include "MemoryTracker.h"
+
+// Storage of one image: size, mip levels and sized internal format
+struct TEXTURE_LAYOUT {
+  uint32_t width_, height_;
+  uint32_t levels_;
+  GLenum format_;
+  bool operator==(const TEXTURE_LAYOUT& other) const {
+    return width_ == other.width_ && height_ == other.height_ &&
+           levels_ == other.levels_ && format_ == other.format_;
+  }
+};
+
+// Where an image lives: layer of a GL_TEXTURE_2D_ARRAY (texture_ 0: nowhere)
+struct ARRAY_LAYER {
+  GLuint texture_;
+  uint32_t layer_;
+};
+
+/*
+ * TextureArrayPool
+ *    GL_TEXTURE_2D_ARRAY storage for the gallery. Plan() takes the texture
+ *    size every image is expected to get and groups images of the same
+ *    size, kMaxLayers at a time in gallery order (neighbours, which are
+ *    viewed and prefetched together, share an array). Each image of a
+ *    group has a fixed layer; the array (immutable storage for the whole
+ *    group) is allocated when the first of its layers is acquired and
+ *    deleted when the last one is released, so layers fill in as images
+ *    load. The shaders pick the image with a layer uniform: moving between
+ *    images of one array binds nothing.
+ *    Images of their own size, whose decoded size missed the plan, or
+ *    whose format differs from the one their group's array was allocated
+ *    in, get a single layer array.
+ *    All methods are GL thread only.
+ */
+class TextureArrayPool {
+public:
+  TextureArrayPool();
+  ~TextureArrayPool();
+
+  // sizes[idx]: width_, height_ and levels_ expected for image idx
+  // (format_ ignored); width_ 0 when unknown
+  void Plan(const std::vector<TEXTURE_LAYOUT>& sizes);
+  // Layer for image idx with that layout, allocating its array when needed
+  bool Acquire(uint32_t idx, const TEXTURE_LAYOUT& layout, ARRAY_LAYER* layer);
+  void Release(const ARRAY_LAYER& layer);
+
+  // Binds the array on the active unit (texture unit 0) for drawing, unless
+  // it is bound there already
+  void BindForDraw(GLuint texture);
+  // Uploads and array creation bind on kUploadUnit, leaving the draw
+  // binding alone; UnbindUpload() makes unit 0 active again
+  static void BindForUpload(GLuint texture);
+  static void UnbindUpload(void);
+
+  // Deletes all arrays (before the context goes away)
+  void Reset(void);
+
+  // GPU memory held by the arrays, empty layers included
+  size_t AllocatedBytes(void) const;
+  uint32_t ArrayCount(void) const {
+    return static_cast<uint32_t>(arrays_.size());
+  }
+
+  static size_t LayerBytes(const TEXTURE_LAYOUT& layout);
+  static constexpr uint32_t kMaxLayers = 4;
+  static constexpr GLenum kUploadUnit = GL_TEXTURE1;
+
+private:
+  struct PLAN {
+    TEXTURE_LAYOUT size_;
+    int32_t group_;     // -1: single layer array
+    uint32_t layer_;
+    uint32_t layers_;   // of the group
+  };
+  struct ARRAY {
+    GLuint texture_;
+    TEXTURE_LAYOUT layout_;
+    int32_t group_;
+    uint32_t layers_;
+    uint32_t used_;
+  };
+  GLuint CreateArray(const TEXTURE_LAYOUT& layout, uint32_t layers);
+  void DeleteArray(GLuint texture);
+  void UpdateSlack(void);
+
+  std::vector<PLAN> plan_;
+  std::vector<ARRAY> arrays_;
+  GLuint drawBound_;   // on texture unit 0
+  TrackedAllocation slack_;   // GPU_TEXTURE_SLACK: layers nobody holds
+};
+
+#endif // __TEXTURE_ARRAY_POOL_H__
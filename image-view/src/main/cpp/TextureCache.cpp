@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "TextureCache.h"
+
+TextureCache::TextureCache(size_t budget) :
+    size_(0), budget_(budget), hits_(0), misses_(0), evictions_(0) {
+}
+
+void TextureCache::Viewed(uint32_t idx, bool resident) {
+  auto it = entries_.find(idx);
+  if (resident && it != entries_.end()) {
+    hits_++;
+    lru_.splice(lru_.begin(), lru_, it->second.lru_);
+  } else {
+    misses_++;
+  }
+}
+
+void TextureCache::Uploaded(uint32_t idx, size_t bytes) {
+  auto it = entries_.find(idx);
+  if (it != entries_.end()) {
+    size_ -= it->second.bytes_;
+    it->second.bytes_ = bytes;
+    lru_.splice(lru_.begin(), lru_, it->second.lru_);
+  } else {
+    lru_.push_front(idx);
+    entries_[idx] = ENTRY { bytes, lru_.begin() };
+  }
+  size_ += bytes;
+}
+
+void TextureCache::Removed(uint32_t idx) {
+  auto it = entries_.find(idx);
+  if (it == entries_.end()) {
+    return;
+  }
+  size_ -= it->second.bytes_;
+  lru_.erase(it->second.lru_);
+  entries_.erase(it);
+}
+
+void TextureCache::Clear(void) {
+  entries_.clear();
+  lru_.clear();
+  size_ = 0;
+}
+
+std::vector<uint32_t> TextureCache::Trim(
+    const std::function<bool(uint32_t)>& pinned) {
+  std::vector<uint32_t> evicted;
+  auto it = lru_.end();
+  while (size_ > budget_ && it != lru_.begin()) {
+    --it;
+    uint32_t idx = *it;
+    if (pinned(idx)) {
+      continue;
+    }
+    auto entry = entries_.find(idx);
+    size_ -= entry->second.bytes_;
+    entries_.erase(entry);
+    it = lru_.erase(it);
+    evicted.push_back(idx);
+    evictions_++;
+  }
+  return evicted;
+}
+
+TEXTURE_CACHE_STATS TextureCache::Stats(void) const {
+  return TEXTURE_CACHE_STATS {
+      hits_, misses_, evictions_,
+      static_cast<uint32_t>(entries_.size()), size_, budget_
+  };
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __TEXTURE_CACHE_H__
+#define __TEXTURE_CACHE_H__
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+struct TEXTURE_CACHE_STATS {
+  uint64_t hits_;         // image shown with its textures resident
+  uint64_t misses_;       // image shown before its textures were (re)loaded
+  uint64_t evictions_;
+  uint32_t residentCount_;
+  size_t   residentBytes_;
+  size_t   budget_;
+};
+
+/*
+ * TextureCache
+ *    Residency bookkeeping for the engine's textures: which texture indices
+ *    are on the GPU, how many bytes they take, and in which order they were
+ *    last viewed. The engine owns the GL objects and releases whatever
+ *    Trim() hands back.
+ */
+class TextureCache {
+public:
+  explicit TextureCache(size_t budget = kDefaultBudget);
+
+  void Budget(size_t bytes) { budget_ = bytes; }
+  size_t Budget(void) const { return budget_; }
+
+  // An image was shown; counts a hit or a miss
+  void Viewed(uint32_t idx, bool resident);
+  // Textures of idx were (re)uploaded and take bytes of GPU memory
+  void Uploaded(uint32_t idx, size_t bytes);
+  void Removed(uint32_t idx);
+  void Clear(void);
+
+  // Least recently viewed indices to release until the budget is met;
+  // pinned indices (the working set) are never returned
+  std::vector<uint32_t> Trim(const std::function<bool(uint32_t)>& pinned);
+
+  TEXTURE_CACHE_STATS Stats(void) const;
+
+  static constexpr size_t kDefaultBudget = 128 * 1024 * 1024;
+
+private:
+  using LRU_LIST = std::list<uint32_t>;   // front: most recently viewed
+  struct ENTRY {
+    size_t bytes_;
+    LRU_LIST::iterator lru_;
+  };
+  std::unordered_map<uint32_t, ENTRY> entries_;
+  LRU_LIST lru_;
+  size_t size_;
+  size_t budget_;
+  uint64_t hits_, misses_, evictions_;
+};
+
+#endif // __TEXTURE_CACHE_H__
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <cstring>
+
+#include "TextureFormat.h"
+#include "ImageScaler.h"
+#include "Etc2Codec.h"
+
+IMAGE_TRAITS AnalyzeImage(const uint8_t* pixels, uint32_t width,
+                          uint32_t height, uint32_t channels) {
+  IMAGE_TRAITS traits { channels, false, true };
+  // gray files are gray; transparency may come from a tRNS chunk, so
+  // alpha is always looked at
+  bool checkGray = (channels > 2);
+  size_t count = static_cast<size_t>(width) * height;
+  for (size_t idx = 0; idx < count; idx++, pixels += 4) {
+    traits.alpha_ = traits.alpha_ || pixels[3] != 0xFF;
+    if (checkGray) {
+      traits.gray_ = traits.gray_ && pixels[0] == pixels[1] &&
+                     pixels[1] == pixels[2];
+    }
+    if (traits.alpha_ && (!checkGray || !traits.gray_)) {
+      break;
+    }
+  }
+  return traits;
+}
+
+TEXEL_LAYOUT ChooseTexelLayout(const IMAGE_TRAITS& traits,
+                               DISPLAY_COLORSPACE space, bool srgbR8) {
+  if (traits.alpha_) {
+    return TEXEL_RGBA;
+  }
+  if (traits.gray_ &&
+      (srgbR8 || space == DISPLAY_COLORSPACE::P3_PASSTHROUGH)) {
+    return TEXEL_GRAY;
+  }
+  return TEXEL_RGB;
+}
+
+GLenum TexelFormat(TEXEL_LAYOUT layout, DISPLAY_COLORSPACE space,
+                   bool compressed) {
+  bool linear = (space == DISPLAY_COLORSPACE::P3_PASSTHROUGH);
+  if (compressed) {
+    if (layout == TEXEL_RGBA) {
+      return linear ? GL_COMPRESSED_RGBA8_ETC2_EAC
+                    : GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC;
+    }
+    return linear ? GL_COMPRESSED_RGB8_ETC2 : GL_COMPRESSED_SRGB8_ETC2;
+  }
+  switch (layout) {
+    case TEXEL_GRAY:
+      return linear ? GL_R8 : GL_SR8_EXT;
+    case TEXEL_RGB:
+      return linear ? GL_RGB8 : GL_SRGB8;
+    default:
+      return linear ? GL_RGBA8 : GL_SRGB8_ALPHA8;
+  }
+}
+
+GLenum TexelUploadFormat(TEXEL_LAYOUT layout) {
+  switch (layout) {
+    case TEXEL_GRAY:
+      return GL_RED;
+    case TEXEL_RGB:
+      return GL_RGB;
+    default:
+      return GL_RGBA;
+  }
+}
+
+TEXEL_LAYOUT FormatTexelLayout(GLenum format, bool* compressed) {
+  *compressed = false;
+  switch (format) {
+    case GL_COMPRESSED_RGBA8_ETC2_EAC:
+    case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+      *compressed = true;
+      return TEXEL_RGBA;
+    case GL_COMPRESSED_RGB8_ETC2:
+    case GL_COMPRESSED_SRGB8_ETC2:
+      *compressed = true;
+      return TEXEL_RGB;
+    case GL_R8:
+    case GL_SR8_EXT:
+      return TEXEL_GRAY;
+    case GL_RGB8:
+    case GL_SRGB8:
+      return TEXEL_RGB;
+    default:
+      return TEXEL_RGBA;
+  }
+}
+
+size_t TexelImageSize(uint32_t width, uint32_t height, TEXEL_LAYOUT layout,
+                      bool compressed) {
+  if (compressed) {
+    return Etc2ImageSize(width, height, layout == TEXEL_RGBA);
+  }
+  return static_cast<size_t>(width) * height * layout;
+}
+
+size_t TexelChainSize(uint32_t width, uint32_t height, uint32_t levels,
+                      TEXEL_LAYOUT layout, bool compressed) {
+  if (compressed) {
+    return Etc2ChainSize(width, height, levels, layout == TEXEL_RGBA);
+  }
+  // MipChainSize() is in R8G8B8A8 pixels
+  return MipChainSize(width, height, levels) / 4 * layout;
+}
+
+void PackTexels(const uint8_t* src, size_t count, TEXEL_LAYOUT layout,
+                uint8_t* dst) {
+  switch (layout) {
+    case TEXEL_GRAY:
+      for (size_t idx = 0; idx < count; idx++) {
+        dst[idx] = src[idx * 4];
+      }
+      break;
+    case TEXEL_RGB:
+      // dst never runs ahead of src: in place is fine front to back
+      for (size_t idx = 0; idx < count; idx++) {
+        dst[idx * 3] = src[idx * 4];
+        dst[idx * 3 + 1] = src[idx * 4 + 1];
+        dst[idx * 3 + 2] = src[idx * 4 + 2];
+      }
+      break;
+    default:
+      if (dst != src) {
+        memcpy(dst, src, count * 4);
+      }
+      break;
+  }
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __TEXTURE_FORMAT_H__
+#define __TEXTURE_FORMAT_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <GLES3/gl32.h>
+#include "common.h"
+
+// GL_EXT_texture_sRGB_R8: single channel sRGB textures
+#ifndef GL_SR8_EXT
+#define GL_SR8_EXT 0x8FBD
+#endif
+
+/*
+ * What an image needs from its texture, found once it is decoded:
+ * channels_ as stored in the file (1: gray, 2: gray + alpha, 3: RGB,
+ * 4: RGBA), and what its pixels turned out to use
+ */
+struct IMAGE_TRAITS {
+  uint32_t channels_;
+  bool alpha_;                  // some pixel is not opaque
+  bool gray_;                   // R == G == B everywhere
+};
+
+/*
+ * Texel layout of an uncompressed texture, as many bytes per texel as
+ * the value: TEXEL_GRAY is sampled through a swizzle (red into green and
+ * blue), TEXEL_RGB has opaque alpha
+ */
+enum TEXEL_LAYOUT : uint32_t {
+  TEXEL_GRAY = 1,
+  TEXEL_RGB = 3,
+  TEXEL_RGBA = 4,
+};
+
+/*
+ * AnalyzeImage()
+ *     Traits of a decoded R8G8B8A8 image; the scan stops as soon as the
+ *     image is known to be colored and translucent
+ */
+IMAGE_TRAITS AnalyzeImage(const uint8_t* pixels, uint32_t width,
+                          uint32_t height, uint32_t channels);
+
+/*
+ * ChooseTexelLayout()
+ *     The smallest layout showing the image unchanged in that display_
+ *     color space. A gray image only gets TEXEL_GRAY when the format
+ *     exists: GL_R8 is core, GL_SR8_EXT needs srgbR8.
+ */
+TEXEL_LAYOUT ChooseTexelLayout(const IMAGE_TRAITS& traits,
+                               DISPLAY_COLORSPACE space, bool srgbR8);
+
+/*
+ * Sized internal format for the layout in that display_ color space
+ * (EOTF bypassed or not, see AssetTexture::InternalFormat()); compressed
+ * is ETC2: RGBA8 with EAC alpha for TEXEL_RGBA, RGB8 otherwise
+ */
+GLenum TexelFormat(TEXEL_LAYOUT layout, DISPLAY_COLORSPACE space,
+                   bool compressed);
+// glTexSubImage3D() format of the layout's pixels
+GLenum TexelUploadFormat(TEXEL_LAYOUT layout);
+// Layout of an internal format TexelFormat() returns
+TEXEL_LAYOUT FormatTexelLayout(GLenum format, bool* compressed);
+
+/*
+ * Bytes of a width x height image, and of a mip chain laid out like
+ * MipChainSize(), in that layout: packed rows of pixels, or ETC2 blocks
+ */
+size_t TexelImageSize(uint32_t width, uint32_t height, TEXEL_LAYOUT layout,
+                      bool compressed);
+size_t TexelChainSize(uint32_t width, uint32_t height, uint32_t levels,
+                      TEXEL_LAYOUT layout, bool compressed);
+
+/*
+ * PackTexels()
+ *     count R8G8B8A8 pixels from src into dst in the layout (the red
+ *     channel of TEXEL_GRAY). src and dst may be the same buffer.
+ */
+void PackTexels(const uint8_t* src, size_t count, TEXEL_LAYOUT layout,
+                uint8_t* dst);
+
+#endif // __TEXTURE_FORMAT_H__
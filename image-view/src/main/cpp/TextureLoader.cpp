@@ -0,0 +1,581 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <sys/stat.h>
+
+#include "TextureLoader.h"
+#include "AssetUtil.h"
+#include "CacheTrim.h"
+#include "ImageScaler.h"
+#include "android_debug.h"
+
+#define PYRAMID_DIR "pyramids"
+#define PYRAMID_FILE_SUFFIX ".tiles"
+
+static std::mutex gPyramidTrimLock;   // workers build concurrently
+
+TextureLoader::TextureLoader(AAssetManager* mgr, SourceImageCache& cache,
+                             ImageIndex& index, const char* cacheDir,
+                             uint32_t threadCount) :
+    mgr_(mgr), cache_(cache), index_(index),
+    cacheDir_(cacheDir ? cacheDir : ""),
+    pixelCache_(cacheDir_), filling_(0), generation_(0), exiting_(false) {
+  if (!threadCount) {
+    // leave one core to the GL thread
+    uint32_t cores = std::thread::hardware_concurrency();
+    threadCount = std::max(1u, std::min(cores ? cores - 1 : 1, 4u));
+  }
+  for (uint32_t idx = 0; idx < threadCount; idx++) {
+    workers_.emplace_back(&TextureLoader::WorkerLoop, this);
+  }
+}
+
+TextureLoader::~TextureLoader() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    exiting_ = true;
+    jobs_.clear();
+    indexJobs_.clear();
+  }
+  wakeup_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void TextureLoader::Submit(const TEXTURE_JOB& job, bool urgent) {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (job.stage_ == TEXTURE_STAGE::INDEX) {
+      indexJobs_.push_back(job);
+    } else if (urgent) {
+      jobs_.push_front(job);
+    } else {
+      jobs_.push_back(job);
+    }
+    if (job.stage_ == TEXTURE_STAGE::DECODE) {
+      pending_.insert(job.index_);
+    }
+  }
+  wakeup_.notify_one();
+}
+
+bool TextureLoader::IsPending(uint32_t index) {
+  std::lock_guard<std::mutex> guard(lock_);
+  return pending_.count(index) != 0;
+}
+
+void TextureLoader::Finished(uint32_t index) {
+  std::lock_guard<std::mutex> guard(lock_);
+  auto it = pending_.find(index);
+  if (it != pending_.end()) {
+    pending_.erase(it);
+  }
+}
+
+void TextureLoader::Cancel(void) {
+  std::unique_lock<std::mutex> guard(lock_);
+  generation_++;
+  jobs_.clear();
+  indexJobs_.clear();
+  results_.clear();
+  pending_.clear();
+  idle_.wait(guard, [this] { return filling_ == 0; });
+}
+
+void TextureLoader::CancelQueued(
+    const std::function<bool(const TEXTURE_JOB&)>& match, TEXTURE_STAGE stage) {
+  std::lock_guard<std::mutex> guard(lock_);
+  for (auto it = jobs_.begin(); it != jobs_.end();) {
+    if (it->stage_ == stage && match(*it)) {
+      // one entry each: a running job of that index keeps its own
+      auto pending = pending_.find(it->index_);
+      if (it->HoldsPending() && pending != pending_.end()) {
+        pending_.erase(pending);
+      }
+      it = jobs_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void TextureLoader::Promote(uint32_t index) {
+  std::lock_guard<std::mutex> guard(lock_);
+  auto it = std::find_if(jobs_.begin(), jobs_.end(),
+                         [index](const TEXTURE_JOB& job) {
+                           return job.index_ == index &&
+                                  job.stage_ != TEXTURE_STAGE::INDEX;
+                         });
+  if (it != jobs_.end() && it != jobs_.begin()) {
+    TEXTURE_JOB job = *it;
+    jobs_.erase(it);
+    jobs_.push_front(job);
+  }
+}
+
+bool TextureLoader::PopReady(TEXTURE_RESULT* result) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (results_.empty()) {
+    return false;
+  }
+  *result = std::move(results_.front());
+  results_.pop_front();
+  return true;
+}
+
+void TextureLoader::WorkerLoop(void) {
+  std::unique_lock<std::mutex> guard(lock_);
+  while (true) {
+    wakeup_.wait(guard, [this] {
+      return exiting_ || !jobs_.empty() || !indexJobs_.empty();
+    });
+    if (exiting_) {
+      return;
+    }
+    std::deque<TEXTURE_JOB>& queue = jobs_.empty() ? indexJobs_ : jobs_;
+    TEXTURE_RESULT result;
+    result.job_ = queue.front();
+    queue.pop_front();
+    uint32_t generation = generation_;
+    TEXTURE_JOB& job = result.job_;
+    bool filling = (job.stage_ == TEXTURE_STAGE::FILL ||
+                    job.stage_ == TEXTURE_STAGE::TILE);
+    if (filling) {
+      filling_++;
+    }
+
+    bool indexed = false;   // a new ImageIndex record
+    guard.unlock();
+    switch (job.stage_) {
+      case TEXTURE_STAGE::DECODE:
+        if (job.tiled_) {
+          job.pyramid_ = LoadPyramid(job);
+          result.status_ = (job.pyramid_ != nullptr);
+          break;
+        }
+        if (LoadCached(job)) {
+          result.status_ = true;
+          break;
+        }
+        job.source_ = cache_.Get(mgr_, job.name_, job.maxWidth_, job.maxHeight_);
+        result.status_ = (job.source_ != nullptr);
+        if (result.status_) {
+          job.layout_ = ChooseTexelLayout(job.source_->traits_, job.space_,
+                                          job.srgbR8_);
+        }
+        break;
+      case TEXTURE_STAGE::FILL:
+        AssetTexture::FillTextures(*job.source_, job.space_, job.levels_,
+                                   job.dst_, job.layout_);
+        result.status_ = true;
+        break;
+      case TEXTURE_STAGE::STORE:
+        result.status_ = job.compress_ ? EncodeCompressed(job)
+                                       : StorePixels(job);
+        break;
+      case TEXTURE_STAGE::TILE:
+        result.status_ = FillTile(job);
+        break;
+      case TEXTURE_STAGE::PREVIEW:
+        // no preview (e.g. an interlaced PNG) is not an error: the
+        // texture comes anyway
+        job.preview_ = LoadPreview(job, &indexed);
+        result.status_ = true;
+        break;
+      case TEXTURE_STAGE::INDEX:
+        indexed = IndexImage(job);
+        result.status_ = true;
+        break;
+      case TEXTURE_STAGE::THUMBNAIL:
+        job.preview_ = LoadThumbnail(job, &indexed);
+        result.status_ = (job.preview_ != nullptr);
+        break;
+    }
+    if (!result.status_) {
+      LOGE("Failed to prepare texture %s", job.name_.c_str());
+    }
+    guard.lock();
+
+    if (filling && !--filling_) {
+      idle_.notify_all();
+    }
+    if (indexed && indexJobs_.empty()) {
+      guard.unlock();
+      index_.Save();
+      guard.lock();
+    }
+    if (job.stage_ == TEXTURE_STAGE::INDEX) {
+      continue;
+    }
+    if (generation != generation_) {
+      continue;   // cancelled while running
+    }
+    results_.push_back(std::move(result));
+  }
+}
+
+COMPRESSED_TEXTURE_KEY TextureLoader::CacheKey(const TEXTURE_JOB& job) {
+  return COMPRESSED_TEXTURE_KEY {
+      job.name_, ContentHash(job.name_), job.space_,
+      job.maxWidth_, job.maxHeight_, job.mipmaps_
+  };
+}
+
+/*
+ * ContentHash()
+ *    The asset is hashed once per run; hashes_ is shared by the workers
+ */
+uint64_t TextureLoader::ContentHash(const std::string& name) {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    auto it = hashes_.find(name);
+    if (it != hashes_.end()) {
+      return it->second;
+    }
+  }
+  uint64_t hash = AssetContentHash(mgr_, name);
+  std::lock_guard<std::mutex> guard(lock_);
+  hashes_[name] = hash;
+  return hash;
+}
+
+PIXEL_CACHE_KEY TextureLoader::PixelKey(const TEXTURE_JOB& job) {
+  return PIXEL_CACHE_KEY {
+      job.name_, ContentHash(job.name_), job.space_,
+      AssetTexture::InternalFormat(job.space_),
+      job.maxWidth_, job.maxHeight_, job.mipmaps_
+  };
+}
+
+bool TextureLoader::LoadCached(TEXTURE_JOB& job) {
+  if (job.compress_) {
+    auto texture = std::make_shared<COMPRESSED_TEXTURE>();
+    if (!LoadCompressedTexture(cacheDir_.c_str(), CacheKey(job), texture.get())) {
+      return false;
+    }
+    job.compressed_ = texture;
+    return true;
+  }
+  job.pixels_ = pixelCache_.Load(PixelKey(job));
+  return job.pixels_ != nullptr;
+}
+
+/*
+ * LoadPyramid()
+ *    The pyramid file of the asset in the cache directory, built on the
+ *    first view (seconds for the largest images; later launches only open
+ *    it). The asset is streamed, never decoded whole. A new pyramid trims
+ *    the directory to TilePyramid::kCacheBudget, least recently opened
+ *    files first.
+ */
+std::shared_ptr<const TilePyramid> TextureLoader::LoadPyramid(
+    const TEXTURE_JOB& job) {
+  uint64_t hash = ContentHash(job.name_);
+  std::string dir = cacheDir_;
+  if (!dir.empty() && dir.back() != '/') {
+    dir += '/';
+  }
+  dir += PYRAMID_DIR;
+  mkdir(dir.c_str(), 0700);
+  std::string file = job.name_;
+  std::replace(file.begin(), file.end(), '/', '_');
+  std::string path = dir + "/" + file + PYRAMID_FILE_SUFFIX;
+
+  auto pyramid = std::make_shared<TilePyramid>();
+  if (pyramid->Open(path, hash)) {
+    return pyramid;
+  }
+  AAsset* asset = AAssetManager_open(mgr_, job.name_.c_str(),
+                                     AASSET_MODE_STREAMING);
+  if (!asset) {
+    return nullptr;
+  }
+  PngRowReader reader([asset](void* buf, size_t size) -> int64_t {
+    return AAsset_read(asset, buf, size);
+  });
+  bool status = reader.Open() &&
+                TilePyramid::Build(reader, job.name_, path, hash);
+  AAsset_close(asset);
+  if (!status || !pyramid->Open(path, hash)) {
+    return nullptr;
+  }
+  // a pyramid deleted while open stays readable until it is closed
+  std::lock_guard<std::mutex> guard(gPyramidTrimLock);
+  TrimCacheDir(dir, PYRAMID_FILE_SUFFIX, TilePyramid::kCacheBudget);
+  return pyramid;
+}
+
+/*
+ * FillTile()
+ *    Tile pixels are transformed where they land, in the mapped buffer
+ */
+bool TextureLoader::FillTile(TEXTURE_JOB& job) {
+  if (!job.pyramid_->ReadTile(job.tile_, job.dst_)) {
+    return false;
+  }
+  AssetTexture::TransformPixels(job.dst_, job.dst_, TilePyramid::kTileStride,
+                                TilePyramid::kTileStride, job.space_);
+  return true;
+}
+
+/*
+ * PREVIEW_LEVEL
+ *    LoadPreview() state of one halving step: each pair of rows of a level
+ *    makes a row of the next one (as PyramidWriter does)
+ */
+struct PREVIEW_LEVEL {
+  uint32_t width_, height_;
+  std::vector<uint8_t> pending_;   // even row
+  std::vector<uint8_t> half_;      // next level row being made
+};
+
+static void AddPreviewRow(std::vector<PREVIEW_LEVEL>& levels, uint32_t level,
+                          uint32_t y, const uint8_t* row, uint8_t* dst) {
+  PREVIEW_LEVEL& info = levels[level];
+  size_t rowSize = static_cast<size_t>(info.width_) * 4;
+  if (level + 1 == levels.size()) {
+    memcpy(dst + y * rowSize, row, rowSize);
+    return;
+  }
+  if (info.height_ == 1) {
+    HalveRowsLinear(row, row, info.width_, info.half_.data());
+    AddPreviewRow(levels, level + 1, 0, info.half_.data(), dst);
+  } else if (y & 1) {
+    HalveRowsLinear(info.pending_.data(), row, info.width_, info.half_.data());
+    AddPreviewRow(levels, level + 1, y / 2, info.half_.data(), dst);
+  } else if (y + 1 < info.height_) {
+    // the last row of an odd height is dropped, as the odd last column
+    memcpy(info.pending_.data(), row, rowSize);
+  }
+}
+
+/*
+ * StreamPreview()
+ *    The asset streamed a row at a time (PngRowReader) and halved in
+ *    linear light (HalveRowsLinear()) until it fits kPreviewSize: no full
+ *    size image is ever held. It still inflates the whole file, but skips
+ *    the large allocation, the full transform, the mip chain and most of
+ *    the upload. The pixels are as the asset has them, with its full
+ *    size and color profile.
+ */
+std::shared_ptr<PREVIEW_IMAGE> TextureLoader::StreamPreview(
+    const std::string& name, PNG_PROFILE* profile, uint32_t* fullWidth,
+    uint32_t* fullHeight) {
+  AAsset* asset = AAssetManager_open(mgr_, name.c_str(),
+                                     AASSET_MODE_STREAMING);
+  if (!asset) {
+    return nullptr;
+  }
+  PngRowReader reader([asset](void* buf, size_t size) -> int64_t {
+    return AAsset_read(asset, buf, size);
+  });
+  std::shared_ptr<PREVIEW_IMAGE> preview;
+  if (reader.Open() && reader.Width() && reader.Height()) {
+    std::vector<PREVIEW_LEVEL> levels;
+    uint32_t width = reader.Width(), height = reader.Height();
+    while (true) {
+      levels.push_back(PREVIEW_LEVEL { width, height });
+      if (width <= kPreviewSize && height <= kPreviewSize) {
+        break;
+      }
+      levels.back().pending_.resize(static_cast<size_t>(width) * 4);
+      width = std::max(1u, width / 2);
+      height = std::max(1u, height / 2);
+      levels.back().half_.resize(static_cast<size_t>(width) * 4);
+    }
+
+    preview = std::make_shared<PREVIEW_IMAGE>();
+    preview->width_ = width;
+    preview->height_ = height;
+    preview->pixels_.resize(static_cast<size_t>(width) * height * 4);
+    preview->memory_ = TrackedAllocation(MEMORY_CATEGORY::STAGING, name,
+                                         preview->pixels_.size());
+    std::vector<uint8_t> row(static_cast<size_t>(reader.Width()) * 4);
+    for (uint32_t y = 0; y < reader.Height(); y++) {
+      if (!reader.ReadRow(row.data())) {
+        preview = nullptr;
+        break;
+      }
+      AddPreviewRow(levels, 0, y, row.data(), preview->pixels_.data());
+    }
+    *profile = reader.Profile();
+    *fullWidth = reader.Width();
+    *fullHeight = reader.Height();
+  }
+  AAsset_close(asset);
+  return preview;
+}
+
+/*
+ * LoadPreview()
+ *    StreamPreview() color transformed for the display; an image not in
+ *    the index yet gets its record from the untransformed pixels on the
+ *    way (*indexed), saving its INDEX job another pass over the file.
+ */
+std::shared_ptr<const PREVIEW_IMAGE> TextureLoader::LoadPreview(
+    const TEXTURE_JOB& job, bool* indexed) {
+  auto start = std::chrono::steady_clock::now();
+  PNG_PROFILE profile;
+  uint32_t width, height;
+  std::shared_ptr<PREVIEW_IMAGE> preview = StreamPreview(job.name_, &profile,
+                                                         &width, &height);
+  if (!preview) {
+    return nullptr;
+  }
+  if (!index_.Find(job.name_)) {
+    index_.Add(job.name_, ImageIndex::MakeRecord(
+        AssetFileSize(mgr_, job.name_), width, height, profile,
+        preview->pixels_.data(), preview->width_, preview->height_));
+    *indexed = true;
+  }
+  AssetTexture::TransformPixels(preview->pixels_.data(),
+                                preview->pixels_.data(), preview->width_,
+                                preview->height_, job.space_);
+  LOGI("Preview %s: %ux%u in %.1f ms", job.name_.c_str(), preview->width_,
+       preview->height_, std::chrono::duration<double, std::milli>(
+           std::chrono::steady_clock::now() - start).count());
+  return preview;
+}
+
+/*
+ * IndexImage()
+ *    Unless a PREVIEW got there first
+ */
+bool TextureLoader::IndexImage(const TEXTURE_JOB& job) {
+  if (index_.Find(job.name_)) {
+    return false;
+  }
+  PNG_PROFILE profile;
+  uint32_t width, height;
+  std::shared_ptr<PREVIEW_IMAGE> preview = StreamPreview(job.name_, &profile,
+                                                         &width, &height);
+  if (!preview) {
+    LOGW("Cannot index %s", job.name_.c_str());
+    return false;
+  }
+  index_.Add(job.name_, ImageIndex::MakeRecord(
+      AssetFileSize(mgr_, job.name_), width, height, profile,
+      preview->pixels_.data(), preview->width_, preview->height_));
+  return true;
+}
+
+/*
+ * LoadThumbnail()
+ *    The decoded image the viewer left in the source image cache is
+ *    shrunk as it is (ScaleImageLinear(), NEON); any other image is
+ *    streamed (StreamPreview(), no full size decode) and its preview
+ *    shrunk, indexing it on the way when it is not yet. Stretched to a
+ *    square, as the viewer stretches images to its quads.
+ */
+std::shared_ptr<const PREVIEW_IMAGE> TextureLoader::LoadThumbnail(
+    const TEXTURE_JOB& job, bool* indexed) {
+  const uint32_t size = job.thumbnailSize_;
+  std::shared_ptr<PREVIEW_IMAGE> thumbnail = std::make_shared<PREVIEW_IMAGE>();
+  thumbnail->width_ = thumbnail->height_ = size;
+  thumbnail->pixels_.resize(static_cast<size_t>(size) * size * 4);
+  thumbnail->memory_ = TrackedAllocation(MEMORY_CATEGORY::STAGING, job.name_,
+                                         thumbnail->pixels_.size());
+
+  std::shared_ptr<const SOURCE_IMAGE> source = cache_.Find(job.name_);
+  if (source) {
+    ScaleImageLinear(source->pixels_, source->width_, source->height_,
+                     thumbnail->pixels_.data(), size, size);
+  } else {
+    PNG_PROFILE profile;
+    uint32_t width, height;
+    std::shared_ptr<PREVIEW_IMAGE> preview = StreamPreview(
+        job.name_, &profile, &width, &height);
+    if (!preview) {
+      return nullptr;
+    }
+    if (!index_.Find(job.name_)) {
+      index_.Add(job.name_, ImageIndex::MakeRecord(
+          AssetFileSize(mgr_, job.name_), width, height, profile,
+          preview->pixels_.data(), preview->width_, preview->height_));
+      *indexed = true;
+    }
+    ScaleImageLinear(preview->pixels_.data(), preview->width_,
+                     preview->height_, thumbnail->pixels_.data(), size, size);
+  }
+  AssetTexture::TransformPixels(thumbnail->pixels_.data(),
+                                thumbnail->pixels_.data(), size, size,
+                                job.space_);
+  return thumbnail;
+}
+
+/*
+ * StorePixels()
+ *    Redoes FillTextures() (the PBO copy was write only), straight into the
+ *    cache file's mapping. False when the cache write failed: the texture
+ *    itself is already up, so the engine only drops the result.
+ */
+bool TextureLoader::StorePixels(TEXTURE_JOB& job) {
+  const SOURCE_IMAGE& source = *job.source_;
+  bool status = pixelCache_.Store(
+      PixelKey(job), source.width_, source.height_, job.levels_, job.layout_,
+      [&job, &source](uint8_t* dst) {
+        AssetTexture::FillTextures(source, job.space_, job.levels_, dst,
+                                   job.layout_);
+      });
+  if (!status) {
+    LOGW("Failed to cache pixels of %s", job.name_.c_str());
+  }
+  return status;
+}
+
+/*
+ * EncodeCompressed()
+ *    Redoes FillTextures() into memory (the PBO copy was write only) and
+ *    compresses every mip level: RGBA8 blocks when the image has alpha,
+ *    half size RGB8 ones otherwise (gray images too: there is no sRGB
+ *    single channel ETC2 format).
+ */
+bool TextureLoader::EncodeCompressed(TEXTURE_JOB& job) {
+  auto start = std::chrono::steady_clock::now();
+  const SOURCE_IMAGE& source = *job.source_;
+  std::vector<uint8_t> staging(AssetTexture::StagingSize(
+      source.width_, source.height_, job.levels_));
+  TrackedAllocation stagingMemory(MEMORY_CATEGORY::STAGING, job.name_,
+                                  staging.size());
+  AssetTexture::FillTextures(source, job.space_, job.levels_, staging.data());
+
+  auto texture = std::make_shared<COMPRESSED_TEXTURE>();
+  texture->width_ = source.width_;
+  texture->height_ = source.height_;
+  texture->levels_ = job.levels_;
+  texture->alpha_ = (job.layout_ == TEXEL_RGBA);
+  texture->data_.resize(texture->Size());
+  texture->memory_ = TrackedAllocation(MEMORY_CATEGORY::COMPRESSED_DATA,
+                                       job.name_, texture->data_.size());
+  EncodeEtc2Chain(staging.data(), source.width_, source.height_, job.levels_,
+                  texture->data_.data(), texture->alpha_);
+
+  double ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+  LOGI("ETC2 %s: %ux%u, %u levels%s in %.1f ms", job.name_.c_str(),
+       source.width_, source.height_, job.levels_,
+       texture->alpha_ ? "" : " (RGB8)", ms);
+  if (!SaveCompressedTexture(cacheDir_.c_str(), CacheKey(job), *texture)) {
+    LOGW("Failed to cache compressed %s", job.name_.c_str());
+  }
+  job.compressed_ = texture;
+  return true;
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __TEXTURE_LOADER_H__
+#define __TEXTURE_LOADER_H__
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <android/asset_manager.h>
+
+#include "AssetTexture.h"
+#include "SourceImageCache.h"
+#include "CompressedTextureCache.h"
+#include "PixelCache.h"
+#include "TilePyramid.h"
+#include "ImageIndex.h"
+
+/*
+ * A texture to prepare, in stages:
+ *   DECODE: load it from the disk cache: its ETC2 version with compress_,
+ *           its mapped transformed pixels (PixelCache) otherwise; on a miss
+ *           read and decode the asset (through the source image cache) and
+ *           pick the texel layout_ its content needs (ChooseTexelLayout())
+ *   FILL:   color transform it into dst_, a pixel unpack buffer the GL
+ *           thread mapped once the decoded size was known, packed in
+ *           layout_
+ *   STORE:  (background, after the upload) put the transformed texture in
+ *           the disk cache: ETC2 compressed with compress_ (the engine
+ *           swaps it in), as is otherwise
+ *   PREVIEW: (alongside DECODE, for the image on screen) a small version,
+ *           streamed from the asset and color transformed into preview_,
+ *           shown until the texture is in; indexes the image too when it
+ *           is not yet
+ *   INDEX:  (background, once per asset) stream it to make its ImageIndex
+ *           record; nothing goes back to the engine
+ *   THUMBNAIL: (grid mode) a ThumbnailAtlas::kCellSize square version,
+ *           color transformed into preview_: scaled from the decoded
+ *           image when the source image cache has it, from the streamed
+ *           preview otherwise
+ * Images too large for one texture are tiled_ instead:
+ *   DECODE: open the image's TilePyramid on disk, building it first from
+ *           the streamed PNG when there is none
+ *   TILE:   read tile_ from the pyramid into dst_, a mapped pixel unpack
+ *           buffer, and color transform it there
+ */
+enum TEXTURE_STAGE {
+  DECODE,
+  FILL,
+  STORE,
+  TILE,
+  PREVIEW,
+  INDEX,
+  THUMBNAIL,
+};
+
+// PREVIEW and THUMBNAIL result: a small color transformed R8G8B8A8 image
+struct PREVIEW_IMAGE {
+  uint32_t width_, height_;
+  std::vector<uint8_t> pixels_;
+  TrackedAllocation memory_;    // STAGING bytes of pixels_
+};
+
+struct TEXTURE_JOB {
+  uint32_t index_;              // into the engine's texture list
+  std::string name_;
+  DISPLAY_COLORSPACE space_;    // display color space to prepare it for
+  TEXTURE_STAGE stage_ = TEXTURE_STAGE::DECODE;
+  uint32_t maxWidth_ = 0, maxHeight_ = 0;        // DECODE: downscale limits
+  bool mipmaps_ = false;
+  bool compress_ = false;                        // ETC2 or pixel cache
+  bool srgbR8_ = false;                          // GL_SR8_EXT available
+  TEXEL_LAYOUT layout_ = TEXEL_RGBA;             // set by DECODE
+  uint32_t levels_ = 1;                          // FILL: mip levels
+  std::shared_ptr<const COMPRESSED_TEXTURE> compressed_;   // DECODE, STORE
+  std::shared_ptr<const MAPPED_PIXELS> pixels_;  // DECODE: cached pixels
+  std::shared_ptr<const SOURCE_IMAGE> source_;   // set by DECODE
+  int32_t slot_ = -1;                            // FILL, TILE: PboRing slot
+  uint8_t* dst_ = nullptr;                       // FILL, TILE: mapped slot
+  bool tiled_ = false;                           // DECODE: pyramid_ only
+  std::shared_ptr<const TilePyramid> pyramid_;   // DECODE (tiled_), TILE
+  TILE_ID tile_ = TILE_ID { 0, 0, 0 };           // TILE
+  std::shared_ptr<const PREVIEW_IMAGE> preview_; // PREVIEW, THUMBNAIL
+                                                 // nullptr: none
+  uint32_t thumbnailSize_ = 0;                   // THUMBNAIL
+
+  // DECODE and FILL jobs keep index_ pending until the engine's Finished()
+  bool HoldsPending(void) const {
+    return stage_ == TEXTURE_STAGE::DECODE || stage_ == TEXTURE_STAGE::FILL;
+  }
+};
+
+struct TEXTURE_RESULT {
+  TEXTURE_JOB job_;
+  bool status_;
+};
+
+/*
+ * TextureLoader
+ *    Worker threads reading, decoding (DECODE jobs) and color transforming
+ *    (FILL jobs, AssetTexture::FillTextures(); TILE jobs) textures. Jobs
+ *    run in submission order; the GL thread collects finished ones with
+ *    PopReady(), maps buffers for FILL and uploads the results itself.
+ *    INDEX jobs wait in a queue of their own, run only when no other job
+ *    is queued; the index is saved when the last of them is done.
+ *    A texture index is pending from its DECODE submission until the
+ *    engine calls Finished() for it.
+ */
+class TextureLoader {
+public:
+  TextureLoader(AAssetManager* mgr, SourceImageCache& cache,
+                ImageIndex& index, const char* cacheDir,
+                uint32_t threadCount = 0);
+  ~TextureLoader();
+
+  // queued at the back, or at the front when urgent (e.g. the visible image)
+  void Submit(const TEXTURE_JOB& job, bool urgent = false);
+  bool IsPending(uint32_t index);
+  void Finished(uint32_t index);
+
+  // Drops queued jobs and results and waits for running FILL and TILE jobs,
+  // so that no worker writes into mapped buffers afterwards
+  void Cancel(void);
+  // Drops queued jobs of that stage (DECODE, STORE or THUMBNAIL) matching
+  // the predicate
+  void CancelQueued(const std::function<bool(const TEXTURE_JOB&)>& match,
+                    TEXTURE_STAGE stage = TEXTURE_STAGE::DECODE);
+  // Moves a queued job (not INDEX) to the front
+  void Promote(uint32_t index);
+
+  bool PopReady(TEXTURE_RESULT* result);
+
+  // Longest side of PREVIEW images
+  static constexpr uint32_t kPreviewSize = 256;
+
+private:
+  void WorkerLoop(void);
+  COMPRESSED_TEXTURE_KEY CacheKey(const TEXTURE_JOB& job);
+  uint64_t ContentHash(const std::string& name);
+  PIXEL_CACHE_KEY PixelKey(const TEXTURE_JOB& job);
+  bool LoadCached(TEXTURE_JOB& job);
+  std::shared_ptr<const TilePyramid> LoadPyramid(const TEXTURE_JOB& job);
+  bool FillTile(TEXTURE_JOB& job);
+  std::shared_ptr<PREVIEW_IMAGE> StreamPreview(const std::string& name,
+                                              PNG_PROFILE* profile,
+                                              uint32_t* fullWidth,
+                                              uint32_t* fullHeight);
+  std::shared_ptr<const PREVIEW_IMAGE> LoadPreview(const TEXTURE_JOB& job,
+                                                   bool* indexed);
+  bool IndexImage(const TEXTURE_JOB& job);
+  std::shared_ptr<const PREVIEW_IMAGE> LoadThumbnail(const TEXTURE_JOB& job,
+                                                     bool* indexed);
+  bool EncodeCompressed(TEXTURE_JOB& job);
+  bool StorePixels(TEXTURE_JOB& job);
+
+  AAssetManager* mgr_;
+  SourceImageCache& cache_;
+  ImageIndex& index_;
+  std::string cacheDir_;
+  PixelCache pixelCache_;
+  std::unordered_map<std::string, uint64_t> hashes_;   // AssetContentHash()
+
+  std::mutex lock_;
+  std::condition_variable wakeup_;
+  std::condition_variable idle_;
+  std::deque<TEXTURE_JOB> jobs_;
+  std::deque<TEXTURE_JOB> indexJobs_;   // INDEX, when jobs_ is empty
+  std::deque<TEXTURE_RESULT> results_;
+  std::multiset<uint32_t> pending_;
+  uint32_t filling_;                    // running FILL and TILE jobs
+  uint32_t generation_;                 // bumped by Cancel()
+  bool exiting_;
+  std::vector<std::thread> workers_;
+};
+
+#endif // __TEXTURE_LOADER_H__
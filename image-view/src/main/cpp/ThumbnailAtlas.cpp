@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "ThumbnailAtlas.h"
+#include "TextureArrayPool.h"
+#include "android_debug.h"
+
+ThumbnailAtlas::ThumbnailAtlas() :
+    texture_(0), space_(DISPLAY_COLORSPACE::INVALID), frame_(0) {
+}
+
+ThumbnailAtlas::~ThumbnailAtlas() {
+  // the texture is owned by the context; Reset() must have run while it
+  // was current
+}
+
+bool ThumbnailAtlas::Create(DISPLAY_COLORSPACE space) {
+  Reset();
+  const uint32_t A = kCellSize * kColumns;
+  GLenum format = AssetTexture::InternalFormat(space);
+  glGenTextures(1, &texture_);
+  glBindTexture(GL_TEXTURE_2D, texture_);
+  glTexStorage2D(GL_TEXTURE_2D, 1, format, A, A);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  if (glGetError() != GL_NO_ERROR) {
+    LOGE("Cannot allocate a %ux%u thumbnail atlas", A, A);
+    Reset();
+    return false;
+  }
+  space_ = space;
+  cells_.assign(kCells, CELL { 0, 0, 0, false });
+  memory_ = TrackedAllocation(MEMORY_CATEGORY::GPU_TEXTURE, "",
+      TextureArrayPool::LayerBytes(TEXTURE_LAYOUT { A, A, 1, format }));
+  return true;
+}
+
+void ThumbnailAtlas::Reset(void) {
+  if (texture_) {
+    glDeleteTextures(1, &texture_);
+    texture_ = 0;
+  }
+  space_ = DISPLAY_COLORSPACE::INVALID;
+  cells_.clear();
+  resident_.clear();
+  loading_.clear();
+  memory_.Reset();
+}
+
+/*
+ * Find()
+ *    Half a texel in from the thumbnail's edges: linear filtering never
+ *    reaches into the next cell
+ */
+bool ThumbnailAtlas::Find(uint32_t idx, GLfloat* rect, bool* final) {
+  auto it = resident_.find(idx);
+  if (it == resident_.end()) {
+    return false;
+  }
+  CELL& cell = cells_[it->second];
+  cell.used_ = frame_;
+  const float A = static_cast<float>(kCellSize * kColumns);
+  float x = static_cast<float>((it->second % kColumns) * kCellSize);
+  float y = static_cast<float>((it->second / kColumns) * kCellSize);
+  rect[0] = (x + 0.5f) / A;
+  rect[1] = (y + 0.5f) / A;
+  rect[2] = (x + cell.size_ - 0.5f) / A;
+  rect[3] = (y + cell.size_ - 0.5f) / A;
+  *final = (cell.size_ == kCellSize);
+  return true;
+}
+
+bool ThumbnailAtlas::IsLoading(uint32_t idx) const {
+  return loading_.count(idx) != 0;
+}
+
+void ThumbnailAtlas::Loading(uint32_t idx, bool loading) {
+  if (loading) {
+    loading_.insert(idx);
+  } else {
+    loading_.erase(idx);
+  }
+}
+
+void ThumbnailAtlas::StopLoading(const std::function<bool(uint32_t)>& match) {
+  for (auto it = loading_.begin(); it != loading_.end();) {
+    if (match(*it)) {
+      it = loading_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void ThumbnailAtlas::Upload(uint32_t idx, uint32_t size, const uint8_t* pixels) {
+  if (!texture_ || size > kCellSize) {
+    return;
+  }
+  uint32_t target = 0;
+  auto it = resident_.find(idx);
+  if (it != resident_.end()) {
+    target = it->second;
+    if (cells_[target].size_ == kCellSize && size < kCellSize) {
+      return;   // the final thumbnail is in already
+    }
+  } else {
+    // a free cell, or the least recently used one
+    for (uint32_t candidate = 0; candidate < cells_.size(); candidate++) {
+      if (!cells_[candidate].valid_) {
+        target = candidate;
+        break;
+      }
+      if (cells_[candidate].used_ < cells_[target].used_) {
+        target = candidate;
+      }
+    }
+    if (cells_[target].valid_) {
+      resident_.erase(cells_[target].idx_);
+    }
+    resident_[idx] = target;
+  }
+  cells_[target] = CELL { idx, size, frame_, true };
+
+  glBindTexture(GL_TEXTURE_2D, texture_);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, (target % kColumns) * kCellSize,
+                  (target / kColumns) * kCellSize, size, size, GL_RGBA,
+                  GL_UNSIGNED_BYTE, pixels);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
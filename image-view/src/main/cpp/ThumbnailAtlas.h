@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __THUMBNAIL_ATLAS_H__
+#define __THUMBNAIL_ATLAS_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <GLES3/gl32.h>
+#include "AssetTexture.h"
+#include "MemoryTracker.h"
+
+/*
+ * ThumbnailAtlas
+ *    GPU side of the grid: one GL_TEXTURE_2D of kColumns x kColumns cells
+ *    of kCellSize pixels, one image's thumbnail each, so the whole grid is
+ *    drawn from a single texture. A cell holds either the final thumbnail
+ *    (kCellSize square) or a smaller stand in (the ImageIndex thumbnail)
+ *    in its top left corner until the final one comes. When all cells are
+ *    taken, the one least recently found (BeginFrame() starts a frame)
+ *    makes room. Thumbnails between their request and upload are loading.
+ *    All methods are GL thread only.
+ */
+class ThumbnailAtlas {
+public:
+  ThumbnailAtlas();
+  ~ThumbnailAtlas();
+
+  // Allocates the atlas for thumbnails prepared for that display color
+  // space (AssetTexture::InternalFormat()), without any thumbnail
+  bool Create(DISPLAY_COLORSPACE space);
+  // Deletes the texture (before the context goes away, or under memory
+  // pressure while the grid is not shown)
+  void Reset(void);
+  GLuint Texture(void) const { return texture_; }
+  // INVALID until Create()
+  DISPLAY_COLORSPACE Space(void) const { return space_; }
+
+  void BeginFrame(void) { frame_++; }
+  // Texture coordinates (left, top, right, bottom) of image idx's
+  // thumbnail, marking it used this frame; *final false for a stand in
+  bool Find(uint32_t idx, GLfloat* rect, bool* final);
+  bool IsLoading(uint32_t idx) const;
+  void Loading(uint32_t idx, bool loading);
+  // Forgets the loads matching (their jobs were dropped)
+  void StopLoading(const std::function<bool(uint32_t)>& match);
+  // Uploads size x size R8G8B8A8 pixels as image idx's thumbnail: final
+  // when size is kCellSize, a stand in otherwise (never over a final one)
+  void Upload(uint32_t idx, uint32_t size, const uint8_t* pixels);
+
+  static constexpr uint32_t kCellSize = 128;
+  static constexpr uint32_t kColumns = 16;
+  static constexpr uint32_t kCells = kColumns * kColumns;
+
+private:
+  struct CELL {
+    uint32_t idx_;
+    uint32_t size_;     // of the thumbnail in it
+    uint64_t used_;     // frame_ it was last found in
+    bool valid_;
+  };
+
+  GLuint texture_;
+  DISPLAY_COLORSPACE space_;
+  uint64_t frame_;
+  std::vector<CELL> cells_;
+  std::unordered_map<uint32_t, uint32_t> resident_;   // image -> cell
+  std::unordered_set<uint32_t> loading_;
+  TrackedAllocation memory_;   // GPU_TEXTURE bytes of the atlas
+};
+
+#endif // __THUMBNAIL_ATLAS_H__
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "TileCache.h"
+#include "TextureArrayPool.h"
+#include "android_debug.h"
+
+TileCache::TileCache() : texture_(0), space_(DISPLAY_COLORSPACE::INVALID), frame_(0) {
+}
+
+TileCache::~TileCache() {
+  // the array is owned by the context; Reset() must have run while it was
+  // current
+}
+
+/*
+ * Key()
+ *    Image index, level and tile position packed into 64 bits: 20 bits of
+ *    image, 6 of level, 19 each of column and row (2^19 tiles is 134M
+ *    pixels a side)
+ */
+uint64_t TileCache::Key(uint32_t idx, const TILE_ID& tile) {
+  return (static_cast<uint64_t>(idx & 0xFFFFF) << 44) |
+         (static_cast<uint64_t>(tile.level_ & 0x3F) << 38) |
+         (static_cast<uint64_t>(tile.x_ & 0x7FFFF) << 19) |
+         static_cast<uint64_t>(tile.y_ & 0x7FFFF);
+}
+
+bool TileCache::Create(DISPLAY_COLORSPACE space) {
+  Reset();
+  const uint32_t S = TilePyramid::kTileStride;
+  GLenum format = AssetTexture::InternalFormat(space);
+  glGenTextures(1, &texture_);
+  TextureArrayPool::BindForUpload(texture_);
+  glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, format, S, S, kTileLayers);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  TextureArrayPool::UnbindUpload();
+  if (glGetError() != GL_NO_ERROR) {
+    LOGE("Cannot allocate %u tile layers", kTileLayers);
+    Reset();
+    return false;
+  }
+  space_ = space;
+  layers_.assign(kTileLayers, LAYER { 0, 0, false });
+  memory_ = TrackedAllocation(MEMORY_CATEGORY::GPU_TEXTURE, "",
+      TextureArrayPool::LayerBytes(TEXTURE_LAYOUT { S, S, 1, format }) *
+          kTileLayers);
+  return true;
+}
+
+void TileCache::Reset(void) {
+  if (texture_) {
+    glDeleteTextures(1, &texture_);
+    texture_ = 0;
+  }
+  space_ = DISPLAY_COLORSPACE::INVALID;
+  layers_.clear();
+  resident_.clear();
+  loading_.clear();
+  memory_.Reset();
+}
+
+bool TileCache::Find(uint32_t idx, const TILE_ID& tile, uint32_t* layer) {
+  auto it = resident_.find(Key(idx, tile));
+  if (it == resident_.end()) {
+    return false;
+  }
+  layers_[it->second].used_ = frame_;
+  *layer = it->second;
+  return true;
+}
+
+bool TileCache::IsLoading(uint32_t idx, const TILE_ID& tile) const {
+  return loading_.count(Key(idx, tile)) != 0;
+}
+
+void TileCache::Loading(uint32_t idx, const TILE_ID& tile, bool loading) {
+  if (loading) {
+    loading_.insert(Key(idx, tile));
+  } else {
+    loading_.erase(Key(idx, tile));
+  }
+}
+
+void TileCache::Upload(uint32_t idx, const TILE_ID& tile, const uint8_t* bits) {
+  if (!texture_) {
+    return;
+  }
+  uint64_t key = Key(idx, tile);
+  uint32_t layer = 0;
+  auto it = resident_.find(key);
+  if (it != resident_.end()) {
+    layer = it->second;
+  } else {
+    // a free layer, or the least recently used one
+    for (uint32_t candidate = 0; candidate < layers_.size(); candidate++) {
+      if (!layers_[candidate].valid_) {
+        layer = candidate;
+        break;
+      }
+      if (layers_[candidate].used_ < layers_[layer].used_) {
+        layer = candidate;
+      }
+    }
+    if (layers_[layer].valid_) {
+      resident_.erase(layers_[layer].key_);
+    }
+    layers_[layer] = LAYER { key, frame_, true };
+    resident_[key] = layer;
+  }
+
+  const uint32_t S = TilePyramid::kTileStride;
+  TextureArrayPool::BindForUpload(texture_);
+  glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, S, S, 1,
+                  GL_RGBA, GL_UNSIGNED_BYTE, bits);
+  TextureArrayPool::UnbindUpload();
+}
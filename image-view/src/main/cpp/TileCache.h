@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __TILE_CACHE_H__
+#define __TILE_CACHE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <GLES3/gl32.h>
+#include "AssetTexture.h"
+#include "TilePyramid.h"
+#include "MemoryTracker.h"
+
+/*
+ * TileCache
+ *    GPU side of tiled images (TilePyramid): one GL_TEXTURE_2D_ARRAY of
+ *    kTileLayers tile sized layers, whatever the image size. Tiles are
+ *    uploaded into a layer when first needed; when all layers are taken
+ *    the tile least recently found (BeginFrame() starts a frame) makes
+ *    room. Tiles between their request and upload are loading.
+ *    All methods are GL thread only.
+ */
+class TileCache {
+public:
+  TileCache();
+  ~TileCache();
+
+  // Allocates the layers for tiles prepared for that display color space
+  // (AssetTexture::InternalFormat()), without any tile
+  bool Create(DISPLAY_COLORSPACE space);
+  // Deletes the array (before the context goes away, or when no tiled
+  // image is shown)
+  void Reset(void);
+  GLuint Texture(void) const { return texture_; }
+  // INVALID until Create()
+  DISPLAY_COLORSPACE Space(void) const { return space_; }
+
+  void BeginFrame(void) { frame_++; }
+  // Layer of a resident tile of image idx, marking it used this frame
+  bool Find(uint32_t idx, const TILE_ID& tile, uint32_t* layer);
+  bool IsLoading(uint32_t idx, const TILE_ID& tile) const;
+  void Loading(uint32_t idx, const TILE_ID& tile, bool loading);
+  // Uploads kTileStride x kTileStride R8G8B8A8 pixels as the tile; with a
+  // pixel unpack buffer bound, bits is the offset into that buffer
+  void Upload(uint32_t idx, const TILE_ID& tile, const uint8_t* bits);
+
+  static constexpr uint32_t kTileLayers = 96;
+
+private:
+  struct LAYER {
+    uint64_t key_;
+    uint64_t used_;     // frame_ it was last found in
+    bool valid_;
+  };
+  static uint64_t Key(uint32_t idx, const TILE_ID& tile);
+
+  GLuint texture_;
+  DISPLAY_COLORSPACE space_;
+  uint64_t frame_;
+  std::vector<LAYER> layers_;
+  std::unordered_map<uint64_t, uint32_t> resident_;   // key -> layer
+  std::unordered_set<uint64_t> loading_;
+  TrackedAllocation memory_;   // GPU_TEXTURE bytes of the array
+};
+
+#endif // __TILE_CACHE_H__
@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "TilePyramid.h"
+#include "CacheFile.h"
+#include "ImageScaler.h"
+#include "MemoryTracker.h"
+#include "android_debug.h"
+
+#define PYRAMID_FILE_MAGIC     "TILE"
+#define PYRAMID_FILE_VERSION   1
+
+/*
+ * File layout: PYRAMID_FILE_HEADER, then the levels' tiles, each level
+ * row major at its offset_, each tile kTileStride rows of kTileStride
+ * R8G8B8A8 pixels
+ */
+struct PYRAMID_FILE_HEADER {
+  char     magic_[4];
+  uint32_t version_;
+  uint64_t contentHash_;
+  uint32_t tileSize_, tileBorder_;
+  uint32_t levelCount_;
+  uint32_t reserved_;
+  TILE_LEVEL levels_[TilePyramid::kMaxLevels];
+};
+
+/*
+ * PyramidWriter
+ *    Build() state: rows come in top to bottom at level 0; each pair of
+ *    rows of a level makes a row of the next one.
+ */
+class PyramidWriter {
+public:
+  PyramidWriter(int fd, const std::vector<TILE_LEVEL>& levels) :
+      fd_(fd), levels_(levels), status_(true) {
+    for (auto& level : levels_) {
+      pending_.emplace_back(static_cast<size_t>(level.width_) * 4);
+      half_.emplace_back(static_cast<size_t>(std::max(1u, level.width_ / 2)) * 4);
+    }
+    segment_.resize(TilePyramid::kTileStride * 4);
+  }
+
+  void AddRow(uint32_t level, uint32_t y, const uint8_t* row);
+  bool Status(void) const { return status_; }
+  size_t Bytes(void) const {
+    size_t bytes = segment_.size();
+    for (size_t idx = 0; idx < pending_.size(); idx++) {
+      bytes += pending_[idx].size() + half_[idx].size();
+    }
+    return bytes;
+  }
+
+private:
+  void WriteRow(uint32_t level, uint32_t y, const uint8_t* row);
+  void PutTileRow(const TILE_LEVEL& level, uint32_t tileY, uint32_t tileRow,
+                  const uint8_t* row);
+
+  int fd_;
+  const std::vector<TILE_LEVEL>& levels_;
+  std::vector<std::vector<uint8_t>> pending_;   // even row of each level
+  std::vector<std::vector<uint8_t>> half_;      // next level row being made
+  std::vector<uint8_t> segment_;
+  bool status_;
+};
+
+void PyramidWriter::AddRow(uint32_t level, uint32_t y, const uint8_t* row) {
+  WriteRow(level, y, row);
+  if (level + 1 >= levels_.size()) {
+    return;
+  }
+  const TILE_LEVEL& info = levels_[level];
+  size_t rowSize = static_cast<size_t>(info.width_) * 4;
+  if (info.height_ == 1) {
+    HalveRowsLinear(row, row, info.width_, half_[level].data());
+    AddRow(level + 1, 0, half_[level].data());
+  } else if (y & 1) {
+    HalveRowsLinear(pending_[level].data(), row, info.width_,
+                    half_[level].data());
+    AddRow(level + 1, y / 2, half_[level].data());
+  } else if (y + 1 < info.height_) {
+    // the last row of an odd height is dropped, as the odd last column
+    memcpy(pending_[level].data(), row, rowSize);
+  }
+}
+
+/*
+ * WriteRow()
+ *    A row lands in its own tile and, next to a tile boundary or the image
+ *    edge, in the border row of the tile above or below
+ */
+void PyramidWriter::WriteRow(uint32_t level, uint32_t y, const uint8_t* row) {
+  const uint32_t T = TilePyramid::kTileSize, B = TilePyramid::kTileBorder;
+  const TILE_LEVEL& info = levels_[level];
+  uint32_t tileY = y / T;
+  PutTileRow(info, tileY, y - tileY * T + B, row);
+  if (y % T == 0 && tileY > 0) {
+    PutTileRow(info, tileY - 1, T + B, row);
+  }
+  if (y % T == T - 1 && tileY + 1 < info.rows_) {
+    PutTileRow(info, tileY + 1, 0, row);
+  }
+  if (y == 0) {
+    PutTileRow(info, 0, 0, row);
+  }
+  if (y == info.height_ - 1) {
+    PutTileRow(info, tileY, y - tileY * T + B + 1, row);
+  }
+}
+
+void PyramidWriter::PutTileRow(const TILE_LEVEL& level, uint32_t tileY,
+                                uint32_t tileRow, const uint8_t* row) {
+  const uint32_t T = TilePyramid::kTileSize, B = TilePyramid::kTileBorder;
+  const uint32_t S = TilePyramid::kTileStride;
+  for (uint32_t tileX = 0; tileX < level.columns_; tileX++) {
+    // pixels [tileX * T - B, tileX * T + T + B) of the row, clamped
+    int64_t first = static_cast<int64_t>(tileX) * T - B;
+    for (uint32_t idx = 0; idx < S; idx++) {
+      int64_t x = std::min(std::max(first + idx, int64_t(0)),
+                           static_cast<int64_t>(level.width_) - 1);
+      memcpy(&segment_[idx * 4], row + x * 4, 4);
+    }
+    uint64_t tile = static_cast<uint64_t>(tileY) * level.columns_ + tileX;
+    off64_t offset = static_cast<off64_t>(
+        level.offset_ + (tile * S * S + static_cast<uint64_t>(tileRow) * S) * 4);
+    if (pwrite64(fd_, segment_.data(), segment_.size(), offset) !=
+        static_cast<ssize_t>(segment_.size())) {
+      status_ = false;
+    }
+  }
+}
+
+TilePyramid::TilePyramid() : fd_(-1) {
+}
+
+TilePyramid::~TilePyramid() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+std::vector<TILE_LEVEL> TilePyramid::Layout(uint32_t width, uint32_t height) {
+  std::vector<TILE_LEVEL> levels;
+  uint64_t offset = sizeof(PYRAMID_FILE_HEADER);
+  while (levels.size() < kMaxLevels) {
+    TILE_LEVEL level { width, height, (width + kTileSize - 1) / kTileSize,
+                       (height + kTileSize - 1) / kTileSize, offset };
+    levels.push_back(level);
+    offset += static_cast<uint64_t>(level.columns_) * level.rows_ * TileBytes();
+    if (width <= kTileSize && height <= kTileSize) {
+      break;
+    }
+    width = std::max(1u, width / 2);
+    height = std::max(1u, height / 2);
+  }
+  return levels;
+}
+
+bool TilePyramid::Build(PngRowReader& reader, const std::string& name,
+                        const std::string& path, uint64_t contentHash) {
+  auto start = std::chrono::steady_clock::now();
+  uint32_t width = reader.Width(), height = reader.Height();
+  if (!width || !height) {
+    return false;
+  }
+  std::vector<TILE_LEVEL> levels = Layout(width, height);
+  const TILE_LEVEL& last = levels.back();
+  uint64_t size = last.offset_ +
+                  static_cast<uint64_t>(last.columns_) * last.rows_ * TileBytes();
+
+  PYRAMID_FILE_HEADER header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic_, PYRAMID_FILE_MAGIC, 4);
+  header.version_ = PYRAMID_FILE_VERSION;
+  header.contentHash_ = contentHash;
+  header.tileSize_ = kTileSize;
+  header.tileBorder_ = kTileBorder;
+  header.levelCount_ = static_cast<uint32_t>(levels.size());
+  std::copy(levels.begin(), levels.end(), header.levels_);
+
+  bool status = WriteCacheFile(path, [&](int fd) {
+    // blocks allocated up front: a full disk fails here, not half way. 64
+    // bit offsets: pyramids of the largest images pass 2 GB
+    if (posix_fallocate64(fd, 0, static_cast<off64_t>(size)) != 0 ||
+        pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+      return false;
+    }
+    PyramidWriter writer(fd, levels);
+    std::vector<uint8_t> row(static_cast<size_t>(width) * 4);
+    TrackedAllocation memory(MEMORY_CATEGORY::STAGING, name,
+                             row.size() + writer.Bytes());
+    for (uint32_t y = 0; y < height; y++) {
+      if (!reader.ReadRow(row.data())) {
+        return false;
+      }
+      writer.AddRow(0, y, row.data());
+      if (!writer.Status()) {
+        return false;
+      }
+    }
+    return true;
+  });
+  if (!status) {
+    LOGE("Failed to build the tile pyramid of %s", name.c_str());
+    return false;
+  }
+  double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  LOGI("Tile pyramid %s: %ux%u, %zu levels, %llu MB in %.1f s", name.c_str(),
+       width, height, levels.size(),
+       static_cast<unsigned long long>(size >> 20), seconds);
+  return true;
+}
+
+bool TilePyramid::Open(const std::string& path, uint64_t contentHash) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  PYRAMID_FILE_HEADER header;
+  struct stat64 st;
+  bool valid = pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+               fstat64(fd, &st) == 0 &&
+               !memcmp(header.magic_, PYRAMID_FILE_MAGIC, 4) &&
+               header.version_ == PYRAMID_FILE_VERSION &&
+               header.contentHash_ == contentHash &&
+               header.tileSize_ == kTileSize &&
+               header.tileBorder_ == kTileBorder &&
+               header.levelCount_ >= 1 && header.levelCount_ <= kMaxLevels;
+  if (valid) {
+    std::vector<TILE_LEVEL> levels = Layout(header.levels_[0].width_,
+                                            header.levels_[0].height_);
+    const TILE_LEVEL& last = levels.back();
+    valid = levels.size() == header.levelCount_ &&
+            std::equal(levels.begin(), levels.end(), header.levels_,
+                       [](const TILE_LEVEL& a, const TILE_LEVEL& b) {
+                         return !memcmp(&a, &b, sizeof(a));
+                       }) &&
+            static_cast<uint64_t>(st.st_size) >=
+                last.offset_ + static_cast<uint64_t>(last.columns_) *
+                               last.rows_ * TileBytes();
+    if (valid) {
+      levels_ = levels;
+    }
+  }
+  if (!valid) {
+    close(fd);
+    LOGI("Tile pyramid %s is stale", path.c_str());
+    unlink(path.c_str());
+    return false;
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+  fd_ = fd;
+  futimens(fd_, nullptr);   // most recently used
+  return true;
+}
+
+bool TilePyramid::ReadTile(const TILE_ID& tile, uint8_t* dst) const {
+  if (fd_ < 0 || tile.level_ >= levels_.size()) {
+    return false;
+  }
+  const TILE_LEVEL& level = levels_[tile.level_];
+  if (tile.x_ >= level.columns_ || tile.y_ >= level.rows_) {
+    return false;
+  }
+  uint64_t index = static_cast<uint64_t>(tile.y_) * level.columns_ + tile.x_;
+  off64_t offset = static_cast<off64_t>(level.offset_ + index * TileBytes());
+  return pread64(fd_, dst, TileBytes(), offset) ==
+         static_cast<ssize_t>(TileBytes());
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __TILE_PYRAMID_H__
+#define __TILE_PYRAMID_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "PngRowReader.h"
+
+// A tile: level of detail (0: full resolution), column and row
+struct TILE_ID {
+  uint32_t level_, x_, y_;
+};
+
+// One level of detail: image size, tile grid and where its tiles start
+struct TILE_LEVEL {
+  uint32_t width_, height_;
+  uint32_t columns_, rows_;
+  uint64_t offset_;
+};
+
+/*
+ * TilePyramid
+ *    An image too large for one texture, as a file of fixed size tiles at
+ *    every level of detail: level 0 is the image, each next level half the
+ *    previous one (linear light 2x2 averages, HalveRowsLinear()) until it
+ *    fits a single tile. Tiles are kTileSize pixels square plus a
+ *    kTileBorder of their neighbours' pixels (edge pixels repeated at the
+ *    image border), so that linear filtering is seamless across tiles;
+ *    tiles on the right and bottom edges are only partly valid.
+ *    Build() streams the PNG a row at a time, so neither building nor
+ *    reading tiles ever holds more than a few rows or tiles in memory.
+ *    The pixels are the decoded asset, before any color transform.
+ *    ReadTile() is thread safe.
+ */
+class TilePyramid {
+public:
+  TilePyramid();
+  ~TilePyramid();
+  TilePyramid(const TilePyramid&) = delete;
+  TilePyramid& operator=(const TilePyramid&) = delete;
+
+  // Writes the pyramid of the image reader decodes to path (a temporary
+  // file renamed at the end); name is for the log
+  static bool Build(PngRowReader& reader, const std::string& name,
+                    const std::string& path, uint64_t contentHash);
+  // Opens a file Build() wrote from the asset with that content hash,
+  // marking it most recently used (its modification time)
+  bool Open(const std::string& path, uint64_t contentHash);
+
+  uint32_t LevelCount(void) const {
+    return static_cast<uint32_t>(levels_.size());
+  }
+  const TILE_LEVEL& Level(uint32_t level) const { return levels_[level]; }
+  // kTileStride x kTileStride R8G8B8A8 pixels into dst (TileBytes())
+  bool ReadTile(const TILE_ID& tile, uint8_t* dst) const;
+
+  static std::vector<TILE_LEVEL> Layout(uint32_t width, uint32_t height);
+  static size_t TileBytes(void) {
+    return static_cast<size_t>(kTileStride) * kTileStride * 4;
+  }
+  static constexpr uint32_t kTileSize = 256;
+  static constexpr uint32_t kTileBorder = 1;
+  static constexpr uint32_t kTileStride = kTileSize + 2 * kTileBorder;
+  static constexpr uint32_t kMaxLevels = 32;
+  // Of the pyramid directory (TrimCacheDir()): about one 160 MP image
+  static constexpr size_t kCacheBudget = 1024 * 1024 * 1024;
+
+private:
+  int fd_;
+  std::vector<TILE_LEVEL> levels_;
+};
+
+#endif // __TILE_PYRAMID_H__
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <algorithm>
+#include <chrono>
+#include "UploadScheduler.h"
+#include "TextureFormat.h"
+#include "android_debug.h"
+
+UploadScheduler::UploadScheduler(PboRing& pboRing) :
+    pboRing_(pboRing),
+    stats_ { 0, 0, 0, 0, 0.0, 0.0, 0.0, kDefaultFrameBudget } {
+}
+
+void UploadScheduler::Add(const TEXTURE_UPLOAD& upload) {
+  uploads_.push_back(upload);
+}
+
+void UploadScheduler::Run(std::vector<TEXTURE_UPLOAD>* done) {
+  if (uploads_.empty()) {
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+  size_t spent = 0;
+  double ms = 0.0;
+  while (!uploads_.empty() && spent < stats_.frameBudget_ &&
+         ms < kFrameBudgetMs) {
+    TEXTURE_UPLOAD& upload = uploads_.front();
+    upload.frames_++;
+    if (!UploadBands(upload, stats_.frameBudget_ - spent, &spent)) {
+      break;
+    }
+    stats_.textures_++;
+    done->push_back(std::move(upload));
+    uploads_.pop_front();
+    ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+  }
+  ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+  stats_.frames_++;
+  stats_.bytes_ += spent;
+  stats_.lastFrameMs_ = ms;
+  stats_.maxFrameMs_ = std::max(stats_.maxFrameMs_, ms);
+  stats_.totalMs_ += ms;
+}
+
+/*
+ * UploadBands()
+ *    Bands of the upload up to budget bytes (at least one row, or one row
+ *    of ETC2 blocks, when nothing was uploaded this frame yet); true when
+ *    the upload is complete
+ */
+bool UploadScheduler::UploadBands(TEXTURE_UPLOAD& upload, size_t budget,
+                                  size_t* spent) {
+  int32_t slot = upload.job_.slot_;
+  if (slot >= 0 && !pboRing_.BindForUpload(slot)) {
+    LOGW("PBO content lost: %s", upload.job_.name_.c_str());
+    pboRing_.Release(slot);
+    upload.texture_->AbortUpload();
+    upload.status_ = false;
+    return true;
+  }
+
+  size_t used = 0;
+  uint32_t step = upload.compressed_ ? 4 : 1;
+  while (upload.level_ < upload.levels_) {
+    uint32_t w = std::max(1u, upload.width_ >> upload.level_);
+    uint32_t h = std::max(1u, upload.height_ >> upload.level_);
+    size_t stepBytes = TexelImageSize(w, step, upload.layout_,
+                                      upload.compressed_);
+    size_t left = (used < budget) ? budget - used : 0;
+    uint32_t steps = static_cast<uint32_t>(std::min<size_t>(
+        left / stepBytes, h));
+    if (!steps) {
+      if (used || *spent) {
+        break;
+      }
+      steps = 1;
+    }
+    uint32_t rows = std::min(h - upload.row_, steps * step);
+    size_t offset = upload.offset_ + (upload.row_ / step) * stepBytes;
+    upload.texture_->UploadBand(upload.level_, upload.row_, rows,
+                                upload.bits_ + offset);
+    size_t bytes = TexelImageSize(w, rows, upload.layout_, upload.compressed_);
+    used += bytes;
+    stats_.bands_++;
+
+    upload.row_ += rows;
+    if (upload.row_ >= h) {
+      upload.offset_ += TexelImageSize(w, h, upload.layout_,
+                                       upload.compressed_);
+      upload.level_++;
+      upload.row_ = 0;
+    }
+  }
+  *spent += used;
+
+  bool complete = (upload.level_ >= upload.levels_);
+  if (complete) {
+    upload.texture_->EndUpload();
+  }
+  if (slot >= 0) {
+    if (complete) {
+      pboRing_.Release(slot);
+    } else {
+      PboRing::Unbind();
+    }
+  }
+  return complete;
+}
+
+/*
+ * Drop()
+ *    The GPU may still read earlier bands from the PBO: the slot is
+ *    released (fenced), not abandoned
+ */
+void UploadScheduler::Drop(TEXTURE_UPLOAD& upload) {
+  upload.texture_->AbortUpload();
+  if (upload.job_.slot_ >= 0) {
+    pboRing_.BindForUpload(upload.job_.slot_);   // unmaps it if need be
+    pboRing_.Release(upload.job_.slot_);
+  }
+}
+
+void UploadScheduler::Cancel(uint32_t idx,
+                             std::vector<TEXTURE_UPLOAD>* dropped) {
+  for (auto it = uploads_.begin(); it != uploads_.end();) {
+    if (it->job_.index_ == idx) {
+      Drop(*it);
+      if (dropped) {
+        dropped->push_back(*it);
+      }
+      it = uploads_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void UploadScheduler::Clear(void) {
+  for (auto& upload : uploads_) {
+    Drop(upload);
+  }
+  uploads_.clear();
+}
+
+bool UploadScheduler::IsUploading(uint32_t idx) const {
+  return std::any_of(uploads_.begin(), uploads_.end(),
+                     [idx](const TEXTURE_UPLOAD& upload) {
+                       return upload.job_.index_ == idx;
+                     });
+}
+
+void UploadScheduler::FrameBudget(size_t bytes) {
+  stats_.frameBudget_ = std::max<size_t>(bytes, 1);
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __UPLOAD_SCHEDULER_H__
+#define __UPLOAD_SCHEDULER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "AssetTexture.h"
+#include "PboRing.h"
+#include "TextureLoader.h"
+
+// A texture upload, from BeginUpload() until the last band
+struct TEXTURE_UPLOAD {
+  TEXTURE_JOB job_;             // keeps the data alive; with slot_ >= 0,
+                                // bits_ is an offset into that PboRing slot
+  AssetTexture* texture_;
+  const uint8_t* bits_;         // mip chain: FillTextures() or ETC2 layout
+  uint32_t width_, height_, levels_;
+  bool compressed_;
+  TEXEL_LAYOUT layout_;         // TexelImageSize() of the bands
+  uint32_t level_ = 0, row_ = 0;   // next band
+  size_t offset_ = 0;              // of level_ in bits_
+  uint32_t frames_ = 0;            // it uploaded in
+  bool status_ = true;             // false: PBO content lost
+};
+
+struct UPLOAD_STATS {
+  uint64_t frames_;             // that uploaded anything
+  uint64_t bands_;
+  uint64_t bytes_;
+  uint64_t textures_;           // uploads completed
+  double lastFrameMs_;          // of the last frame that uploaded
+  double maxFrameMs_;
+  double totalMs_;
+  size_t frameBudget_;          // bytes
+};
+
+/*
+ * UploadScheduler
+ *    Uploads textures a band of rows at a time, oldest upload first, under
+ *    a per frame budget of frameBudget_ bytes and kFrameBudgetMs: a large
+ *    image loads across several frames instead of stalling one. Each frame
+ *    still uploads at least one band. The time Run() takes is recorded per
+ *    frame (Stats()).
+ *    All methods are GL thread only.
+ */
+class UploadScheduler {
+public:
+  explicit UploadScheduler(PboRing& pboRing);
+
+  // upload.texture_ must be in BeginUpload()
+  void Add(const TEXTURE_UPLOAD& upload);
+  // Uploads this frame's bands; the uploads completed (EndUpload() done, or
+  // aborted with status_ false) are appended to done
+  void Run(std::vector<TEXTURE_UPLOAD>* done);
+  // Drops the uploads of image idx / all uploads (AbortUpload()), giving
+  // their PBO slots back; the dropped ones are appended to dropped
+  void Cancel(uint32_t idx, std::vector<TEXTURE_UPLOAD>* dropped = nullptr);
+  void Clear(void);
+  bool IsUploading(uint32_t idx) const;
+
+  void FrameBudget(size_t bytes);
+  UPLOAD_STATS Stats(void) const { return stats_; }
+
+  static constexpr size_t kDefaultFrameBudget = 4 << 20;
+  static constexpr double kFrameBudgetMs = 4.0;
+
+private:
+  bool UploadBands(TEXTURE_UPLOAD& upload, size_t budget, size_t* spent);
+  void Drop(TEXTURE_UPLOAD& upload);
+
+  PboRing& pboRing_;
+  std::deque<TEXTURE_UPLOAD> uploads_;
+  UPLOAD_STATS stats_;
+};
+
+#endif // __UPLOAD_SCHEDULER_H__
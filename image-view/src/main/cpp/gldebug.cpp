@@ -30,16 +30,13 @@
  * eglConfig ( swapchain ) capability
  */
 void PrintEglConfig(void) {
-  EGLint numConfigs;
   EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
 
   eglInitialize(display, 0, 0);
-  eglGetConfigs(display, nullptr, 0, &numConfigs);
-  std::vector<EGLConfig> supportedConfigs(numConfigs);
-  eglGetConfigs(display, supportedConfigs.data(), numConfigs, &numConfigs);
-  assert(numConfigs);
-  for (auto cfg : supportedConfigs) {
-    PrintEglConfig(display, cfg);
+  std::vector<EGL_CONFIG_INFO> configs = GetEglConfigs(display);
+  assert(configs.size());
+  for (auto& info : configs) {
+    PrintEglConfig(info);
   }
 }
 
@@ -71,22 +68,77 @@ const char* GetEGLSurfaceTypeStr(uint32_t mask) {
   return GetPairStr<uint32_t>(mask, eglSurfaceTypeInfo);
 }
 
-void PrintEglConfig(EGLDisplay display, EGLConfig cfg) {
-  EGLint r, g, b, d, a, s;
-  eglGetConfigAttrib(display, cfg, EGL_RED_SIZE, &r);
-  eglGetConfigAttrib(display, cfg, EGL_GREEN_SIZE, &g);
-  eglGetConfigAttrib(display, cfg, EGL_BLUE_SIZE, &b);
-  eglGetConfigAttrib(display, cfg, EGL_ALPHA_SIZE, &a);
-  eglGetConfigAttrib(display, cfg, EGL_DEPTH_SIZE, &d);
-  eglGetConfigAttrib(display, cfg, EGL_SURFACE_TYPE, &s);
-  LOGI("(%d, %d, %d, %d) and (%d) (%08x)", r, g, b, a, d, s);
+/*
+ * eglConfig attributes kept in EGL_CONFIG_INFO, with the value used when
+ * the attribute is not known to the driver (extension attributes)
+ */
+struct EGL_CONFIG_ATTRIB {
+  EGLint attrib_;
+  const char* name_;
+  EGLint EGL_CONFIG_INFO::* field_;
+  EGLint default_;
+};
+#define MAKE_CONFIG_ATTRIB(attrib, field, val) \
+    { attrib, #attrib, &EGL_CONFIG_INFO::field, val }
+static const std::vector<EGL_CONFIG_ATTRIB> eglConfigAttribInfo {
+    MAKE_CONFIG_ATTRIB(EGL_CONFIG_ID, configId_, 0),
+    MAKE_CONFIG_ATTRIB(EGL_RED_SIZE, r_, 0),
+    MAKE_CONFIG_ATTRIB(EGL_GREEN_SIZE, g_, 0),
+    MAKE_CONFIG_ATTRIB(EGL_BLUE_SIZE, b_, 0),
+    MAKE_CONFIG_ATTRIB(EGL_ALPHA_SIZE, a_, 0),
+    MAKE_CONFIG_ATTRIB(EGL_DEPTH_SIZE, depth_, 0),
+    MAKE_CONFIG_ATTRIB(EGL_SURFACE_TYPE, surfaceType_, 0),
+    MAKE_CONFIG_ATTRIB(EGL_RENDERABLE_TYPE, renderableType_, 0),
+    MAKE_CONFIG_ATTRIB(EGL_COLOR_COMPONENT_TYPE_EXT, componentType_,
+                       EGL_COLOR_COMPONENT_TYPE_FIXED_EXT),
+    MAKE_CONFIG_ATTRIB(EGL_CONFIG_CAVEAT, caveat_, EGL_NONE),
+    MAKE_CONFIG_ATTRIB(EGL_NATIVE_VISUAL_ID, nativeVisualId_, 0),
+};
+
+std::vector<EGL_CONFIG_INFO> GetEglConfigs(EGLDisplay display) {
+  EGLint numConfigs = 0;
+  if (!eglGetConfigs(display, nullptr, 0, &numConfigs) || numConfigs <= 0) {
+    return std::vector<EGL_CONFIG_INFO>();
+  }
+  std::vector<EGLConfig> supportedConfigs(numConfigs);
+  eglGetConfigs(display, supportedConfigs.data(), numConfigs, &numConfigs);
+  supportedConfigs.resize(numConfigs);
+
+  std::vector<EGL_CONFIG_INFO> configs;
+  for (auto cfg : supportedConfigs) {
+    configs.push_back(GetEglConfigInfo(display, cfg));
+  }
+  return configs;
+}
+
+EGL_CONFIG_INFO GetEglConfigInfo(EGLDisplay display, EGLConfig cfg) {
+  EGL_CONFIG_INFO info;
+  info.config_ = cfg;
+  for (auto& attrib : eglConfigAttribInfo) {
+    if (!eglGetConfigAttrib(display, cfg, attrib.attrib_,
+                            &(info.*attrib.field_))) {
+      info.*attrib.field_ = attrib.default_;
+    }
+  }
+  // unknown extension attributes leave EGL_BAD_ATTRIBUTE behind
+  eglGetError();
+  return info;
+}
+
+void PrintEglConfig(const EGL_CONFIG_INFO& info) {
+  LOGI("(%d, %d, %d, %d) and (%d) (%08x)", info.r_, info.g_, info.b_,
+       info.a_, info.depth_, info.surfaceType_);
   for (auto& pair : eglSurfaceTypeInfo) {
-     if (pair.first & s ) {
+     if (pair.first & info.surfaceType_ ) {
        LOGI("SURFACE_TYPE: %s", GetEGLSurfaceTypeStr(pair.first));
      }
   }
 }
 
+void PrintEglConfig(EGLDisplay display, EGLConfig cfg) {
+  PrintEglConfig(GetEglConfigInfo(display, cfg));
+}
+
 /*
  * OpenGL Implementation Info
  */
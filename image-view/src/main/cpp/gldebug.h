@@ -23,9 +23,31 @@
 #include <GLES3/gl32.h>
 #include "android_debug.h"
 #include "mathfu/glsl_mappings.h"
+
+#include <vector>
+
+/*
+ * Snapshot of the eglConfig attributes used to pick a config: one
+ * eglGetConfigs() call fills all of them, see GetEglConfigs().
+ */
+struct EGL_CONFIG_INFO {
+  EGLConfig config_;
+  EGLint configId_;
+  EGLint r_, g_, b_, a_;
+  EGLint depth_;
+  EGLint surfaceType_;
+  EGLint renderableType_;
+  EGLint componentType_;    // FIXED when EGL_EXT_pixel_format_float is absent
+  EGLint caveat_;
+  EGLint nativeVisualId_;
+};
+std::vector<EGL_CONFIG_INFO> GetEglConfigs(EGLDisplay display);
+EGL_CONFIG_INFO GetEglConfigInfo(EGLDisplay display, EGLConfig cfg);
+
 void PrintEGLInfo(EGLDisplay disp);
 void PrintEglConfig(void);
 void PrintEglConfig(EGLDisplay display, EGLConfig cfg);
+void PrintEglConfig(const EGL_CONFIG_INFO& info);
 const char* GetGLErrorStr(uint32_t errorCode);
 void PrintGLInfo(void);
 
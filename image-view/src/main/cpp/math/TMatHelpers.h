@@ -187,41 +187,36 @@ namespace android {
                 // and the determinant is a*A + b*B + c*C (The rule of Sarrus)
                 //
                 // Importantly, our matrices are column-major!
-
-                MATRIX inverted(MATRIX::NO_INIT);
-
-                const T a = x[0][0];
-                const T b = x[1][0];
-                const T c = x[2][0];
-                const T d = x[0][1];
-                const T e = x[1][1];
-                const T f = x[2][1];
-                const T g = x[0][2];
-                const T h = x[1][2];
-                const T i = x[2][2];
+                //
+                // Elements are read through the named x/y/z members and the
+                // result is built in one go so that the inverse can be
+                // evaluated in constant expressions.
+
+                const T a = x[0].x;
+                const T b = x[1].x;
+                const T c = x[2].x;
+                const T d = x[0].y;
+                const T e = x[1].y;
+                const T f = x[2].y;
+                const T g = x[0].z;
+                const T h = x[1].z;
+                const T i = x[2].z;
 
                 // Do the full analytic inverse
                 const T A = e * i - f * h;
                 const T B = f * g - d * i;
                 const T C = d * h - e * g;
-                inverted[0][0] = A;                 // A
-                inverted[0][1] = B;                 // B
-                inverted[0][2] = C;                 // C
-                inverted[1][0] = c * h - b * i;     // D
-                inverted[1][1] = a * i - c * g;     // E
-                inverted[1][2] = b * g - a * h;     // F
-                inverted[2][0] = b * f - c * e;     // G
-                inverted[2][1] = c * d - a * f;     // H
-                inverted[2][2] = a * e - b * d;     // I
+                const T D = c * h - b * i;
+                const T E = a * i - c * g;
+                const T F = b * g - a * h;
+                const T G = b * f - c * e;
+                const T H = c * d - a * f;
+                const T I = a * e - b * d;
 
                 const T det(a * A + b * B + c * C);
-                for (size_t col = 0; col < 3; ++col) {
-                    for (size_t row = 0; row < 3; ++row) {
-                        inverted[col][row] /= det;
-                    }
-                }
-
-                return inverted;
+                return MATRIX(A / det, B / det, C / det,
+                              D / det, E / det, F / det,
+                              G / det, H / det, I / det);
             }
 
 /**
@@ -233,9 +228,13 @@ namespace android {
             template <typename MATRIX>
             inline constexpr MATRIX PURE inverse(const MATRIX& matrix) {
                 static_assert(MATRIX::NUM_ROWS == MATRIX::NUM_COLS, "only square matrices can be inverted");
-                return (MATRIX::NUM_ROWS == 2) ? fastInverse2<MATRIX>(matrix) :
-                       ((MATRIX::NUM_ROWS == 3) ? fastInverse3<MATRIX>(matrix) :
-                        gaussJordanInverse<MATRIX>(matrix));
+                if constexpr (MATRIX::NUM_ROWS == 2) {
+                    return fastInverse2<MATRIX>(matrix);
+                } else if constexpr (MATRIX::NUM_ROWS == 3) {
+                    return fastInverse3<MATRIX>(matrix);
+                } else {
+                    return gaussJordanInverse<MATRIX>(matrix);
+                }
             }
 
             template<typename MATRIX_R, typename MATRIX_A, typename MATRIX_B>
@@ -252,7 +251,9 @@ namespace android {
                 static_assert(MATRIX_R::NUM_ROWS == MATRIX_A::NUM_ROWS,
                               "invalid dimension of matrix multiply result.");
 
-                MATRIX_R res(MATRIX_R::NO_INIT);
+                // res is value-initialized (not NO_INIT) to keep the product
+                // usable in constant expressions.
+                MATRIX_R res;
                 for (size_t col = 0; col < MATRIX_R::NUM_COLS; ++col) {
                     res[col] = lhs * rhs[col];
                 }
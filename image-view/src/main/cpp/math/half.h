@@ -60,9 +60,9 @@ namespace android {
             uint16_t bits;
             explicit constexpr fp16() noexcept : bits(0) { }
             explicit constexpr fp16(uint16_t b) noexcept : bits(b) { }
-            void setS(unsigned int s) noexcept { bits = uint16_t((bits & 0x7FFF) | (s<<15)); }
-            void setE(unsigned int s) noexcept { bits = uint16_t((bits & 0xE3FF) | (s<<10)); }
-            void setM(unsigned int s) noexcept { bits = uint16_t((bits & 0xFC00) | (s<< 0)); }
+            constexpr void setS(unsigned int s) noexcept { bits = uint16_t((bits & 0x7FFF) | (s<<15)); }
+            constexpr void setE(unsigned int s) noexcept { bits = uint16_t((bits & 0xE3FF) | (s<<10)); }
+            constexpr void setM(unsigned int s) noexcept { bits = uint16_t((bits & 0xFC00) | (s<< 0)); }
             constexpr unsigned int getS() const noexcept { return  bits >> 15u; }
             constexpr unsigned int getE() const noexcept { return (bits >> 10u) & 0x1Fu; }
             constexpr unsigned int getM() const noexcept { return  bits         & 0x3FFu; }
@@ -74,9 +74,9 @@ namespace android {
             };
             explicit constexpr fp32() noexcept : bits(0) { }
             explicit constexpr fp32(float f) noexcept : fp(f) { }
-            void setS(unsigned int s) noexcept { bits = uint32_t((bits & 0x7FFFFFFF) | (s<<31)); }
-            void setE(unsigned int s) noexcept { bits = uint32_t((bits & 0x807FFFFF) | (s<<23)); }
-            void setM(unsigned int s) noexcept { bits = uint32_t((bits & 0xFF800000) | (s<< 0)); }
+            constexpr void setS(unsigned int s) noexcept { bits = uint32_t((bits & 0x7FFFFFFF) | (s<<31)); }
+            constexpr void setE(unsigned int s) noexcept { bits = uint32_t((bits & 0x807FFFFF) | (s<<23)); }
+            constexpr void setM(unsigned int s) noexcept { bits = uint32_t((bits & 0xFF800000) | (s<< 0)); }
             constexpr unsigned int getS() const noexcept { return  bits >> 31u; }
             constexpr unsigned int getE() const noexcept { return (bits >> 23u) & 0xFFu; }
             constexpr unsigned int getM() const noexcept { return  bits         & 0x7FFFFFu; }
@@ -124,7 +124,7 @@ namespace android {
                 return m_value[column];
             }
 
-            inline col_type& operator[](size_t column) {
+            inline CONSTEXPR col_type& operator[](size_t column) {
                 assert(column < NUM_COLS);
                 return m_value[column];
             }
@@ -373,12 +373,12 @@ namespace android {
 // matrix * column-vector, result is a vector of the same type than the input vector
         template <typename T, typename U>
         CONSTEXPR typename TMat33<U>::col_type PURE operator *(const TMat33<T>& lhs, const TVec3<U>& rhs) {
-            // Result is initialized to zero.
-            typename TMat33<U>::col_type result;
-            for (size_t col = 0; col < TMat33<T>::NUM_COLS; ++col) {
-                result += lhs[col] * rhs[col];
-            }
-            return result;
+            // Spelled out per component (instead of looping over operator[])
+            // so the product can be evaluated in constant expressions.
+            return typename TMat33<U>::col_type(
+                    lhs[0].x * rhs.x + lhs[1].x * rhs.y + lhs[2].x * rhs.z,
+                    lhs[0].y * rhs.x + lhs[1].y * rhs.y + lhs[2].y * rhs.z,
+                    lhs[0].z * rhs.x + lhs[1].z * rhs.y + lhs[2].z * rhs.z);
         }
 
 // row-vector * matrix, result is a vector of the same type than the input vector
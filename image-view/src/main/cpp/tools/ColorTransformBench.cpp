@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * color-transform-bench: host benchmark of android::ColorSpaceConnector's
+ * batch conversions (ColorSpace.cpp) against the scalar transform() they
+ * replace. For a few connectors (curves given as gamma, parametric and
+ * linear; clamped and extended ranges) it times the scalar, planar and
+ * interleaved paths of transform() and transformLinear(), then reports the
+ * largest batch vs scalar difference over a grid of inputs reaching
+ * outside [0, 1], so that the clamps are covered.
+ *
+ * Usage:
+ *   color-transform-bench [--pixels N] [--iterations N] [--grid N]
+ *                         [--tolerance F]
+ *     --pixels      pixels timed per path (default 1048576)
+ *     --iterations  best of N runs (default 5)
+ *     --grid        grid points per channel over [-0.5, 1.5] (default 41)
+ *     --tolerance   max |batch - scalar| accepted (default 0)
+ * Exits non zero when a batch path is off the scalar one.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "ColorSpace.h"
+
+using android::ColorSpace;
+using android::ColorSpaceConnector;
+using android::float3;
+
+struct CONNECTOR {
+  const char* name_;
+  ColorSpaceConnector connector_;
+};
+
+// Interleaved RGBA; the planar paths take the same values split by channel
+struct PIXELS {
+  std::vector<float> rgba_;
+  std::vector<float> r_, g_, b_;
+  size_t count_;
+};
+
+static PIXELS MakePixels(std::vector<float> rgba) {
+  PIXELS pixels { std::move(rgba), {}, {}, {}, 0 };
+  pixels.count_ = pixels.rgba_.size() / 4;
+  for (size_t idx = 0; idx < pixels.count_; idx++) {
+    pixels.r_.push_back(pixels.rgba_[idx * 4 + 0]);
+    pixels.g_.push_back(pixels.rgba_[idx * 4 + 1]);
+    pixels.b_.push_back(pixels.rgba_[idx * 4 + 2]);
+  }
+  return pixels;
+}
+
+// Mostly in gamut, a tenth a little outside
+static PIXELS RandomPixels(size_t count) {
+  std::vector<float> rgba(count * 4);
+  uint32_t seed = 1;
+  for (size_t idx = 0; idx < rgba.size(); idx++) {
+    seed = seed * 1103515245 + 12345;
+    rgba[idx] = ((seed >> 8) & 0xffff) / 65535.0f * 1.2f - 0.1f;
+  }
+  return MakePixels(std::move(rgba));
+}
+
+static PIXELS GridPixels(uint32_t steps) {
+  std::vector<float> rgba;
+  for (uint32_t r = 0; r < steps; r++) {
+    for (uint32_t g = 0; g < steps; g++) {
+      for (uint32_t b = 0; b < steps; b++) {
+        const float scale = 2.0f / (steps - 1);
+        rgba.push_back(r * scale - 0.5f);
+        rgba.push_back(g * scale - 0.5f);
+        rgba.push_back(b * scale - 0.5f);
+        rgba.push_back(1.0f);
+      }
+    }
+  }
+  return MakePixels(std::move(rgba));
+}
+
+/*
+ * The three paths, writing interleaved RGBA to dst
+ */
+static void Scalar(const ColorSpaceConnector& connector, bool linear,
+                   const PIXELS& src, std::vector<float>& dst) {
+  for (size_t idx = 0; idx < src.count_; idx++) {
+    const float* px = &src.rgba_[idx * 4];
+    float3 v { px[0], px[1], px[2] };
+    float3 out = linear ? connector.transformLinear(v) : connector.transform(v);
+    dst[idx * 4 + 0] = out.r;
+    dst[idx * 4 + 1] = out.g;
+    dst[idx * 4 + 2] = out.b;
+    dst[idx * 4 + 3] = px[3];
+  }
+}
+
+static void Planar(const ColorSpaceConnector& connector, bool linear,
+                   const PIXELS& src, std::vector<float>& dst) {
+  static std::vector<float> r, g, b;
+  r.resize(src.count_);
+  g.resize(src.count_);
+  b.resize(src.count_);
+  if (linear) {
+    connector.transformLinear(src.r_.data(), src.g_.data(), src.b_.data(),
+                              r.data(), g.data(), b.data(), src.count_);
+  } else {
+    connector.transform(src.r_.data(), src.g_.data(), src.b_.data(),
+                        r.data(), g.data(), b.data(), src.count_);
+  }
+  for (size_t idx = 0; idx < src.count_; idx++) {
+    dst[idx * 4 + 0] = r[idx];
+    dst[idx * 4 + 1] = g[idx];
+    dst[idx * 4 + 2] = b[idx];
+    dst[idx * 4 + 3] = src.rgba_[idx * 4 + 3];
+  }
+}
+
+static void Interleaved(const ColorSpaceConnector& connector, bool linear,
+                        const PIXELS& src, std::vector<float>& dst) {
+  if (linear) {
+    connector.transformLinear(src.rgba_.data(), dst.data(), src.count_);
+  } else {
+    connector.transform(src.rgba_.data(), dst.data(), src.count_);
+  }
+}
+
+using PATH = void (*)(const ColorSpaceConnector&, bool, const PIXELS&,
+                      std::vector<float>&);
+
+// Best of iterations, in ms; the planar time includes the copy back to
+// RGBA, small next to the curves
+static double Time(PATH path, const ColorSpaceConnector& connector,
+                   bool linear, const PIXELS& src, uint32_t iterations) {
+  std::vector<float> dst(src.rgba_.size());
+  double bestMs = INFINITY;
+  for (uint32_t i = 0; i < iterations; i++) {
+    auto start = std::chrono::steady_clock::now();
+    path(connector, linear, src, dst);
+    bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count());
+  }
+  return bestMs;
+}
+
+static float MaxDiff(PATH path, const ColorSpaceConnector& connector,
+                     bool linear, const PIXELS& src) {
+  std::vector<float> expected(src.rgba_.size()), batch(src.rgba_.size());
+  Scalar(connector, linear, src, expected);
+  path(connector, linear, src, batch);
+  float diff = 0.0f;
+  for (size_t idx = 0; idx < expected.size(); idx++) {
+    if (std::isnan(expected[idx]) != std::isnan(batch[idx])) {
+      return INFINITY;
+    }
+    if (!std::isnan(expected[idx])) {
+      diff = std::max(diff, std::abs(expected[idx] - batch[idx]));
+    }
+  }
+  return diff;
+}
+
+static void Usage(const char* prog) {
+  fprintf(stderr, "Usage: %s [--pixels N] [--iterations N] [--grid N] "
+          "[--tolerance F]\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+  size_t count = 1 << 20;
+  uint32_t iterations = 5;
+  uint32_t steps = 41;
+  float tolerance = 0.0f;
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg == "--pixels" && i + 1 < argc) {
+      count = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--iterations" && i + 1 < argc) {
+      iterations = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--grid" && i + 1 < argc) {
+      steps = std::max(2, atoi(argv[++i]));
+    } else if (arg == "--tolerance" && i + 1 < argc) {
+      tolerance = std::max(0.0f, static_cast<float>(atof(argv[++i])));
+    } else {
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+
+  const CONNECTOR connectors[] = {
+      { "Display P3 -> sRGB",
+        ColorSpaceConnector(ColorSpace::DisplayP3(), ColorSpace::sRGB()) },
+      { "sRGB -> Display P3",
+        ColorSpaceConnector(ColorSpace::sRGB(), ColorSpace::DisplayP3()) },
+      { "AdobeRGB -> BT2020",
+        ColorSpaceConnector(ColorSpace::AdobeRGB(), ColorSpace::BT2020()) },
+      { "ext. sRGB -> lin. ext. sRGB",
+        ColorSpaceConnector(ColorSpace::extendedSRGB(),
+                            ColorSpace::linearExtendedSRGB()) },
+  };
+  const struct {
+    const char* name_;
+    PATH path_;
+  } batches[] = { { "planar", Planar }, { "interleaved", Interleaved } };
+
+  PIXELS timed = RandomPixels(count);
+  PIXELS grid = GridPixels(steps);
+  fprintf(stdout, "%zu pixels timed, best of %u; %zu grid pixels in "
+          "[-0.5, 1.5]^3 diffed\n", count, iterations, grid.count_);
+  fprintf(stdout, "%-28s %-10s %12s %12s %12s %10s %10s\n", "connector",
+          "", "scalar", "planar", "interleaved", "max diff", "");
+  fprintf(stdout, "%-28s %-10s %12s %12s %12s %10s %10s\n", "", "",
+          "Mpx/s", "Mpx/s", "Mpx/s", "planar", "interl.");
+  bool pass = true;
+  for (const CONNECTOR& connector : connectors) {
+    for (bool linear : { false, true }) {
+      double scalarMs = Time(Scalar, connector.connector_, linear, timed,
+                             iterations);
+      double batchMs[2];
+      float diff[2];
+      for (int path = 0; path < 2; path++) {
+        batchMs[path] = Time(batches[path].path_, connector.connector_,
+                             linear, timed, iterations);
+        diff[path] = MaxDiff(batches[path].path_, connector.connector_,
+                             linear, grid);
+        pass = pass && diff[path] <= tolerance;
+      }
+      fprintf(stdout, "%-28s %-10s %12.2f %12.2f %12.2f %10.3g %10.3g\n",
+              linear ? "" : connector.name_, linear ? "linear" : "transfer",
+              count / scalarMs / 1000.0, count / batchMs[0] / 1000.0,
+              count / batchMs[1] / 1000.0, diff[0], diff[1]);
+    }
+  }
+  fprintf(stdout, pass ? "PASS\n" : "FAIL\n");
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * draw-bench: host tool timing the viewer's frame headless (EGL pbuffer-less
+ * GLES 3 context, e.g. Mesa with EGL_PLATFORM=surfaceless), drawn as
+ * ImageViewEngine::DrawFrame() does in P3 passthrough: the left half as
+ * is, the right half clipped to sRGB. Two ways of drawing it:
+ *   - client arrays: as frames were drawn before QuadRenderer, vertices
+ *     sent from client memory for every quad, uniform locations looked up
+ *     on every use, sampler and attribute arrays set up every frame
+ *   - vao: the app's QuadRenderer and ShaderProgram, a static unit quad
+ *     and uniforms set only when they change
+ * over four scenes: one quad per half (a texture) or --tiles quads per
+ * half (a tiled image zoomed in), with the view still or panning (every
+ * quad moves every frame). Reports per frame the GL calls (GlCallCount.h)
+ * and the CPU time issuing them, then the time until glFinish() returns.
+ *
+ * Usage:
+ *   draw-bench [--frames N] [--tiles N] [--size WxH]
+ *     --frames  frames timed per scene and path (default 2000)
+ *     --tiles   quads per half in the tiled scenes (default 24)
+ *     --size    render target (default 1920x1080)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl32.h>
+
+#include "ColorSpaceMatrices.h"
+#include "QuadRenderer.h"
+#include "ShaderProgram.h"
+#include "ShaderSource.h"
+
+uint64_t gGlCallCount = 0;
+
+#define APP_GAMMA 2.2f
+
+/*
+ * gVertexShader as it was with client arrays: a position and a texture
+ * coordinate per vertex
+ */
+static const char kClientArrayVertexShader[] =
+    "#version 300 es\n"
+    "layout (location = 0) in vec4 vPosition;\n"
+    "layout (location = 1) in vec2 vTexture;\n"
+    "out vec2 vertex_tex;\n"
+    "void main() {\n"
+    "  gl_Position = vPosition;\n"
+    "  vertex_tex = vTexture;\n"
+    "}\n";
+
+// left, top, right, bottom as VIEW_RECT
+struct QUAD {
+  GLfloat screen_[4];
+  GLfloat tex_[4];
+  GLfloat layer_;
+};
+
+struct SCENE {
+  const char* name_;
+  uint32_t quads_;   // per half
+  bool panning_;
+};
+
+struct TIMES {
+  uint64_t calls_;
+  double issueUs_;
+  double frameUs_;
+};
+
+static GLuint CompileShader(GLenum type, const char* source) {
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, nullptr);
+  glCompileShader(shader);
+  GLint compiled = 0;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+  if (!compiled) {
+    char log[1024];
+    glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+    fprintf(stderr, "shader compile failed:\n%s\n", log);
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+static GLuint CreateClientArrayProgram(const char* fragmentSource) {
+  GLuint vs = CompileShader(GL_VERTEX_SHADER, kClientArrayVertexShader);
+  GLuint fs = CompileShader(GL_FRAGMENT_SHADER, fragmentSource);
+  if (!vs || !fs) {
+    return 0;
+  }
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vs);
+  glAttachShader(program, fs);
+  glLinkProgram(program);
+  glDeleteShader(vs);
+  glDeleteShader(fs);
+  GLint linked = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    fprintf(stderr, "program link failed\n");
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+static bool CreateContext(EGLDisplay* display) {
+  *display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (*display == EGL_NO_DISPLAY || !eglInitialize(*display, nullptr, nullptr)) {
+    fprintf(stderr, "no EGL display (try EGL_PLATFORM=surfaceless)\n");
+    return false;
+  }
+  eglBindAPI(EGL_OPENGL_ES_API);
+  const EGLint configAttribs[] = {
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
+      EGL_NONE
+  };
+  EGLConfig config = EGL_NO_CONFIG_KHR;
+  EGLint count = 0;
+  if (!eglChooseConfig(*display, configAttribs, &config, 1, &count) || !count) {
+    config = EGL_NO_CONFIG_KHR;
+  }
+  const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE };
+  EGLContext context = eglCreateContext(*display, config, EGL_NO_CONTEXT,
+                                        contextAttribs);
+  if (context == EGL_NO_CONTEXT ||
+      !eglMakeCurrent(*display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+    fprintf(stderr, "cannot make a surfaceless GLES 3 context current\n");
+    return false;
+  }
+  return true;
+}
+
+/*
+ * SceneQuads()
+ *    count quads tiling each half, as many columns as rows (give or take),
+ *    moved a little every frame when panning
+ */
+static void SceneQuads(const SCENE& scene, uint32_t frame,
+                       std::vector<QUAD> (&halves)[2]) {
+  uint32_t columns = static_cast<uint32_t>(
+      std::ceil(std::sqrt(static_cast<float>(scene.quads_))));
+  uint32_t rows = (scene.quads_ + columns - 1) / columns;
+  float shift = scene.panning_ ? 0.001f * (frame % 64) : 0.0f;
+  for (uint32_t half = 0; half < 2; half++) {
+    halves[half].clear();
+    float left = (half == 0) ? -1.0f : 0.0f;
+    for (uint32_t idx = 0; idx < scene.quads_; idx++) {
+      float x = static_cast<float>(idx % columns) / columns;
+      float y = static_cast<float>(idx / columns) / rows;
+      float w = 1.0f / columns;
+      float h = 1.0f / rows;
+      QUAD quad {
+          { left + x - shift, 1.0f - 2.0f * y,
+            left + x + w - shift, 1.0f - 2.0f * (y + h) },
+          { x + shift, y, x + w + shift, y + h },
+          static_cast<GLfloat>(idx % 4) };
+      halves[half].push_back(quad);
+    }
+  }
+}
+
+static void ClipMatrices(GLfloat (&matrices)[2][9]) {
+  const android::mat3& toClip =
+      android::gamutTransform(android::Gamut::DISPLAY_P3, android::Gamut::SRGB);
+  const android::mat3& fromClip =
+      android::gamutTransform(android::Gamut::SRGB, android::Gamut::DISPLAY_P3);
+  for (int c = 0; c < 3; c++) {
+    for (int r = 0; r < 3; r++) {
+      matrices[0][c * 3 + r] = toClip[c][r];
+      matrices[1][c * 3 + r] = fromClip[c][r];
+    }
+  }
+}
+
+/*
+ * DrawClientArrays()
+ *    One frame the way DrawFrame() / DrawQuad() used to draw it
+ */
+static void DrawClientArrays(const GLuint (&programs)[2],
+                             const std::vector<QUAD> (&halves)[2]) {
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+  glActiveTexture(GL_TEXTURE0 + 0);
+  for (uint32_t half = 0; half < 2; half++) {
+    GLuint program = programs[half];
+    glUseProgram(program);
+    if (half == 1) {
+      GLfloat matrices[2][9];
+      ClipMatrices(matrices);
+      glUniformMatrix3fv(glGetUniformLocation(program, "toClipGamut"),
+                         1, GL_FALSE, matrices[0]);
+      glUniformMatrix3fv(glGetUniformLocation(program, "fromClipGamut"),
+                         1, GL_FALSE, matrices[1]);
+      glUniform1f(glGetUniformLocation(program, "encodeGamma"),
+                  1.0f / APP_GAMMA);
+    }
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glUniform1i(glGetUniformLocation(program, "samplerObj"), 0);
+    for (const QUAD& quad : halves[half]) {
+      const GLfloat* s = quad.screen_;
+      const GLfloat* t = quad.tex_;
+      const GLfloat vertices[] = {
+          s[0], s[3], t[0], t[3],
+          s[2], s[3], t[2], t[3],
+          s[2], s[1], t[2], t[1],
+          s[0], s[1], t[0], t[1] };
+      glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 4,
+                            vertices);
+      glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 4,
+                            vertices + 2);
+      glUniform1f(glGetUniformLocation(program, "textureLayer"), quad.layer_);
+      glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+    }
+  }
+}
+
+/*
+ * DrawQuads()
+ *    One frame as DrawFrame() draws it now
+ */
+static void DrawQuads(QuadRenderer& quads, ShaderProgram (&programs)[2],
+                      const std::vector<QUAD> (&halves)[2]) {
+  glClear(GL_COLOR_BUFFER_BIT);
+  for (uint32_t half = 0; half < 2; half++) {
+    ShaderProgram& program = programs[half];
+    if (half == 1) {
+      quads.UseProgram(program.getProgram());
+      program.setGamutClip(
+          android::gamutTransform(android::Gamut::DISPLAY_P3, android::Gamut::SRGB),
+          android::gamutTransform(android::Gamut::SRGB, android::Gamut::DISPLAY_P3),
+          1.0f / APP_GAMMA);
+    }
+    for (const QUAD& quad : halves[half]) {
+      quads.Draw(program, quad.screen_, quad.tex_, quad.layer_);
+    }
+  }
+}
+
+/*
+ * Measure()
+ *    Averages over frames, after a few frames of warm up
+ */
+template <typename DRAW>
+static TIMES Measure(const SCENE& scene, uint32_t frames, DRAW draw) {
+  const uint32_t kWarmUp = 16;
+  std::vector<QUAD> halves[2];
+  TIMES times { 0, 0.0, 0.0 };
+  for (uint32_t frame = 0; frame < kWarmUp + frames; frame++) {
+    SceneQuads(scene, frame, halves);
+    gGlCallCount = 0;
+    auto start = std::chrono::steady_clock::now();
+    draw(halves);
+    auto issued = std::chrono::steady_clock::now();
+    glFinish();
+    auto finished = std::chrono::steady_clock::now();
+    if (frame < kWarmUp) {
+      continue;
+    }
+    times.calls_ += gGlCallCount;
+    times.issueUs_ += std::chrono::duration<double, std::micro>(
+        issued - start).count();
+    times.frameUs_ += std::chrono::duration<double, std::micro>(
+        finished - start).count();
+  }
+  times.calls_ /= frames;
+  times.issueUs_ /= frames;
+  times.frameUs_ /= frames;
+  return times;
+}
+
+static void Usage(const char* prog) {
+  fprintf(stderr, "Usage: %s [--frames N] [--tiles N] [--size WxH]\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+  uint32_t frames = 2000;
+  uint32_t tiles = 24;
+  uint32_t width = 1920, height = 1080;
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg == "--frames" && i + 1 < argc) {
+      frames = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--tiles" && i + 1 < argc) {
+      tiles = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--size" && i + 1 < argc &&
+               sscanf(argv[i + 1], "%ux%u", &width, &height) == 2 &&
+               width && height) {
+      i++;
+    } else {
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+
+  EGLDisplay display;
+  if (!CreateContext(&display)) {
+    return 1;
+  }
+  fprintf(stdout, "GL_RENDERER: %s, %ux%u, %u frames\n",
+          reinterpret_cast<const char*>(glGetString(GL_RENDERER)),
+          width, height, frames);
+
+  // what DrawFrame() finds bound: a 4 layer image array, its render target
+  const uint32_t kTextureSize = 512;
+  const uint32_t kLayers = 4;
+  std::vector<uint8_t> texels(kTextureSize * kTextureSize * kLayers * 4);
+  for (size_t idx = 0; idx < texels.size(); idx++) {
+    texels[idx] = static_cast<uint8_t>(idx * 7);
+  }
+  GLuint texture, rbo, fbo;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+  glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA8, kTextureSize, kTextureSize,
+                 kLayers);
+  glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, kTextureSize, kTextureSize,
+                  kLayers, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glGenRenderbuffers(1, &rbo);
+  glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glGenFramebuffers(1, &fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, rbo);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    fprintf(stderr, "framebuffer incomplete\n");
+    return 1;
+  }
+  glViewport(0, 0, width, height);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+  GLuint clientArrayPrograms[2] = {
+      CreateClientArrayProgram(gFragmentShader),
+      CreateClientArrayProgram(gGamutClipFragmentShader) };
+  ShaderProgram programs[2];
+  programs[0].createProgram();
+  programs[1].createGamutClipProgram();
+  if (!clientArrayPrograms[0] || !clientArrayPrograms[1] ||
+      !programs[0].getProgram() || !programs[1].getProgram()) {
+    return 1;
+  }
+  QuadRenderer quads;
+
+  std::string tiled = std::to_string(tiles) + " tiles";
+  const SCENE scenes[] = {
+      { "1 quad, still", 1, false },
+      { "1 quad, panning", 1, true },
+      { nullptr, tiles, false },
+      { nullptr, tiles, true },
+  };
+  fprintf(stdout, "%-20s %-14s %10s %11s %11s\n", "per half", "path",
+          "GL calls", "issue us", "frame us");
+  bool status = true;
+  for (const SCENE& scene : scenes) {
+    std::string name = scene.name_ ? scene.name_ :
+        tiled + (scene.panning_ ? ", panning" : ", still");
+    // client arrays need the default vertex array and no array buffer
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    TIMES before = Measure(scene, frames,
+        [&clientArrayPrograms](const std::vector<QUAD> (&halves)[2]) {
+          DrawClientArrays(clientArrayPrograms, halves);
+        });
+    // forgets the program the client array path left in use
+    status = status && quads.Create();
+    TIMES after = Measure(scene, frames,
+        [&quads, &programs](const std::vector<QUAD> (&halves)[2]) {
+          DrawQuads(quads, programs, halves);
+        });
+    status = status && glGetError() == GL_NO_ERROR;
+    fprintf(stdout, "%-20s %-14s %10llu %11.2f %11.2f\n", name.c_str(),
+            "client arrays", static_cast<unsigned long long>(before.calls_),
+            before.issueUs_, before.frameUs_);
+    fprintf(stdout, "%-20s %-14s %10llu %11.2f %11.2f\n", "", "vao",
+            static_cast<unsigned long long>(after.calls_),
+            after.issueUs_, after.frameUs_);
+  }
+
+  quads.Destroy();
+  glDeleteProgram(clientArrayPrograms[0]);
+  glDeleteProgram(clientArrayPrograms[1]);
+  glDeleteProgram(programs[0].getProgram());
+  glDeleteProgram(programs[1].getProgram());
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteFramebuffers(1, &fbo);
+  glDeleteRenderbuffers(1, &rbo);
+  glDeleteTextures(1, &texture);
+  eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  eglTerminate(display);
+  if (!status) {
+    fprintf(stderr, "GL error while drawing\n");
+  }
+  return status ? 0 : 1;
+}
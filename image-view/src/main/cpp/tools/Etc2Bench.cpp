@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * etc2-bench: host benchmark of the app's ETC2 RGBA8 encoder
+ * (Etc2Codec.cpp). For every image it reports the encode time, speed and
+ * the PSNR of the decoded result against the input, for color and alpha.
+ *
+ * Usage:
+ *   etc2-bench [--iterations N] [--synthetic WxH] [image.png ...]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#include <stb/stb_image.h>
+
+#include "Etc2Codec.h"
+
+struct BENCH_IMAGE {
+  std::string name_;
+  uint32_t width_, height_;
+  std::vector<uint8_t> pixels_;   // R8G8B8A8
+};
+
+/*
+ * Smooth gradients with some noise and an alpha ramp: an image with no
+ * assets at hand
+ */
+static BENCH_IMAGE SyntheticImage(uint32_t width, uint32_t height) {
+  BENCH_IMAGE image { "synthetic", width, height,
+                      std::vector<uint8_t>(static_cast<size_t>(width) * height * 4) };
+  uint32_t seed = 1;
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      uint8_t* px = &image.pixels_[(static_cast<size_t>(y) * width + x) * 4];
+      seed = seed * 1103515245 + 12345;
+      px[0] = static_cast<uint8_t>(127 + 120 * sin(x * 0.01 + y * 0.003));
+      px[1] = static_cast<uint8_t>(255 * y / height);
+      px[2] = static_cast<uint8_t>(127 + 100 * cos(x * 0.05) * sin(y * 0.02));
+      px[3] = (x < width / 2) ? 255 : static_cast<uint8_t>(255 * x / width);
+      px[0] = static_cast<uint8_t>(std::min(255, px[0] + int((seed >> 16) % 5)));
+    }
+  }
+  return image;
+}
+
+static bool LoadImage(const char* name, BENCH_IMAGE* image) {
+  int width, height, n;
+  uint8_t* pixels = stbi_load(name, &width, &height, &n, 4);
+  if (!pixels) {
+    fprintf(stderr, "Cannot load %s: %s\n", name, stbi_failure_reason());
+    return false;
+  }
+  image->name_ = name;
+  image->width_ = static_cast<uint32_t>(width);
+  image->height_ = static_cast<uint32_t>(height);
+  image->pixels_.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+  stbi_image_free(pixels);
+  return true;
+}
+
+static double Psnr(double squaredError, size_t count) {
+  if (squaredError == 0.0) {
+    return INFINITY;
+  }
+  return 10.0 * log10(255.0 * 255.0 / (squaredError / count));
+}
+
+static bool Benchmark(const BENCH_IMAGE& image, uint32_t iterations) {
+  std::vector<uint8_t> encoded(Etc2ImageSize(image.width_, image.height_));
+  std::vector<uint8_t> decoded(image.pixels_.size());
+
+  double bestMs = INFINITY;
+  for (uint32_t i = 0; i < iterations; i++) {
+    auto start = std::chrono::steady_clock::now();
+    EncodeEtc2Rgba8(image.pixels_.data(), image.width_, image.height_,
+                    encoded.data());
+    bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count());
+  }
+  if (!DecodeEtc2Rgba8(encoded.data(), image.width_, image.height_,
+                       decoded.data())) {
+    fprintf(stderr, "%s: encoder produced an unsupported block\n",
+            image.name_.c_str());
+    return false;
+  }
+
+  double colorError = 0.0, alphaError = 0.0;
+  for (size_t idx = 0; idx < decoded.size(); idx++) {
+    double d = static_cast<double>(decoded[idx]) - image.pixels_[idx];
+    ((idx & 3) == 3 ? alphaError : colorError) += d * d;
+  }
+  size_t pixels = static_cast<size_t>(image.width_) * image.height_;
+  fprintf(stdout, "%s: %ux%u, %.1f ms, %.2f MPixel/s, "
+          "PSNR RGB %.2f dB, alpha %.2f dB, %zu -> %zu bytes\n",
+          image.name_.c_str(), image.width_, image.height_, bestMs,
+          pixels / bestMs / 1000.0, Psnr(colorError, pixels * 3),
+          Psnr(alphaError, pixels), image.pixels_.size(), encoded.size());
+  return true;
+}
+
+static void Usage(const char* prog) {
+  fprintf(stderr,
+          "Usage: %s [--iterations N] [--synthetic WxH] [image.png ...]\n"
+          "  without images, a 2048x2048 synthetic image is used\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+  uint32_t iterations = 3;
+  std::vector<BENCH_IMAGE> images;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    unsigned width, height;
+    if (arg == "--iterations" && i + 1 < argc) {
+      iterations = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--synthetic" && i + 1 < argc &&
+               sscanf(argv[i + 1], "%ux%u", &width, &height) == 2 &&
+               width && height) {
+      images.push_back(SyntheticImage(width, height));
+      i++;
+    } else if (arg[0] != '-') {
+      BENCH_IMAGE image;
+      if (!LoadImage(argv[i], &image)) {
+        return 1;
+      }
+      images.push_back(std::move(image));
+    } else {
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+  if (images.empty()) {
+    images.push_back(SyntheticImage(2048, 2048));
+  }
+
+  bool status = true;
+  for (auto& image : images) {
+    status = Benchmark(image, iterations) && status;
+  }
+  return status ? 0 : 1;
+}
@@ -0,0 +1,447 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * gamut-clip-check: host tool rendering the app's gamut clip shader
+ * (ShaderSource.h) headless (EGL pbuffer-less GLES 3 context, e.g. Mesa
+ * with EGL_PLATFORM=surfaceless) over a cube of Display P3 colors and
+ * diffing the result against
+ *   - the CPU path the sRGB view used to be made with: P3 -> sRGB -> P3
+ *     through the 8-bit fixed-point pipeline (gamma tables, 10-bit matrix)
+ *   - a float model of the shader math, which the GPU should match to
+ *     rounding
+ * for both display modes: sRGB texture + framebuffer (hardware EOTF) and
+ * P3 passthrough (EOTF in the shader).
+ *
+ * Usage:
+ *   gamut-clip-check [--step N] [--tolerance N]
+ *     --step       distance between cube samples, 8-bit units (default 4)
+ *     --tolerance  max |diff| against the float model (default 2)
+ * Exits non zero when the GPU result is off the float model.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+
+#include "ColorSpaceMatrices.h"
+#include "ShaderSource.h"
+
+#define CLIP_COLOR(color, max) ((color > max) ? max : ((color > 0) ? color : 0))
+#define APP_GAMMA 2.2f
+
+/*
+ * Gamma tables and fixed-point matrix exactly as ColorSpaceTransform.cpp
+ * (see also GamutLutGen.cpp)
+ */
+static void CreateGammaEncodeTable(float gamma, std::vector<uint8_t>& table) {
+  uint32_t maxPixeli = ( 1<<8 ) - 1;
+  float maxPixelf = static_cast<float>(maxPixeli);
+  uint32_t maxLinearVal = static_cast<uint32_t>(0.0031308f * maxPixeli);
+
+  table.resize(0);
+  for(uint32_t idx = 0; idx < maxLinearVal; idx++) {
+    double val = idx * 12.92 + .5f;
+    table.push_back(static_cast<uint8_t>(val));
+  }
+  for (uint32_t idx = maxLinearVal; idx <= maxPixeli; idx++) {
+    double val = (1.055f * pow(idx / maxPixelf, gamma) - 0.055f);
+    val = val * maxPixeli + 0.5f;
+    table.push_back(static_cast<uint8_t>(CLIP_COLOR(val, maxPixelf)));
+  }
+}
+
+static void CreateGammaDecodeTable(float gamma, std::vector<uint8_t>&table) {
+  uint32_t maxPixeli = ( 1<<8 ) - 1;
+  float maxPixelf = static_cast<float>(maxPixeli);
+  uint32_t maxLinearVal = static_cast<uint32_t>(0.04045 * maxPixeli);
+
+  table.resize(0);
+  for(uint32_t idx = 0; idx < maxLinearVal; idx++) {
+    double val = idx / 12.92 + .5f;
+    table.push_back(static_cast<uint8_t>(val));
+  }
+  for (uint32_t idx = maxLinearVal; idx <= maxPixeli; idx++) {
+    double val;
+    val = (idx / maxPixelf + 0.055f) / 1.055f;
+    val = pow(val, gamma) * maxPixeli + 0.5f;
+    table.push_back(static_cast<uint8_t>(CLIP_COLOR(val, maxPixelf)));
+  }
+}
+
+struct FIXED_MATRIX {
+  int32_t m_[3][3];   // [row][col]
+};
+static FIXED_MATRIX ToFixedMatrix(const android::mat3& matrix) {
+  FIXED_MATRIX fixed;
+  for (int r = 0; r < 3; r++) {
+    for (int c = 0; c < 3; c++) {
+      fixed.m_[r][c] = static_cast<int32_t>(matrix[c][r] * 1024 + 0.5f);
+    }
+  }
+  return fixed;
+}
+
+struct CPU_PIPELINE {
+  std::vector<uint8_t> decode_;
+  std::vector<uint8_t> encode_;
+  FIXED_MATRIX toSrgb_;
+  FIXED_MATRIX toP3_;
+};
+
+static void Transform8(const CPU_PIPELINE& cpu, const FIXED_MATRIX& matrix,
+                       const uint8_t* src, uint8_t* dst) {
+  const auto& m = matrix.m_;
+  int32_t lr = cpu.decode_[src[0]];
+  int32_t lg = cpu.decode_[src[1]];
+  int32_t lb = cpu.decode_[src[2]];
+  for (int c = 0; c < 3; c++) {
+    int32_t v = (m[c][0] * lr + m[c][1] * lg + m[c][2] * lb + 512) >> 10;
+    dst[c] = cpu.encode_[CLIP_COLOR(v, 255)];
+  }
+}
+
+/*
+ * Float model of gGamutClipFragmentShader. hardwareEotf: the texture and
+ * framebuffer are sRGB, so the standard sRGB curve linearizes and encodes;
+ * otherwise the shader's own curve (APP_GAMMA).
+ * The APP_GAMMA curve is not continuous where its linear segment ends (a
+ * few 8-bit codes), so a result within float rounding of that point may
+ * land on either side: ShaderModel() returns false for those.
+ */
+static double DecodeChannel(double c, bool hardwareEotf) {
+  if (c < 0.04045) {
+    return c / 12.92;
+  }
+  return pow((c + 0.055) / 1.055, hardwareEotf ? 2.4 : APP_GAMMA);
+}
+static double EncodeChannel(double c, bool hardwareEotf) {
+  if (c < 0.0031308) {
+    return c * 12.92;
+  }
+  return 1.055 * pow(c, hardwareEotf ? 1 / 2.4 : 1 / APP_GAMMA) - 0.055;
+}
+static bool ShaderModel(const android::mat3& toClip, const android::mat3& fromClip,
+                        bool hardwareEotf, const uint8_t* src, uint8_t* dst) {
+  bool stable = true;
+  double linear[3], clipped[3];
+  for (int c = 0; c < 3; c++) {
+    linear[c] = DecodeChannel(src[c] / 255.0, hardwareEotf);
+  }
+  for (int r = 0; r < 3; r++) {
+    double v = 0;
+    for (int c = 0; c < 3; c++) {
+      v += toClip[c][r] * linear[c];
+    }
+    clipped[r] = std::min(1.0, std::max(0.0, v));
+  }
+  for (int r = 0; r < 3; r++) {
+    double v = 0;
+    for (int c = 0; c < 3; c++) {
+      v += fromClip[c][r] * clipped[c];
+    }
+    v = std::min(1.0, std::max(0.0, v));
+    stable = stable && (hardwareEotf || std::abs(v - 0.0031308) > 1e-5);
+    v = EncodeChannel(v, hardwareEotf);
+    dst[r] = static_cast<uint8_t>(v * 255.0 + 0.5);
+  }
+  return stable;
+}
+
+static GLuint CompileShader(GLenum type, const char* source) {
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, nullptr);
+  glCompileShader(shader);
+  GLint compiled = 0;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+  if (!compiled) {
+    char log[1024];
+    glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+    fprintf(stderr, "shader compile failed: %s\n", log);
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+static GLuint CreateClipProgram(void) {
+  GLuint vs = CompileShader(GL_VERTEX_SHADER, gVertexShader);
+  GLuint fs = CompileShader(GL_FRAGMENT_SHADER, gGamutClipFragmentShader);
+  if (!vs || !fs) {
+    return 0;
+  }
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vs);
+  glAttachShader(program, fs);
+  glLinkProgram(program);
+  glDeleteShader(vs);
+  glDeleteShader(fs);
+  GLint linked = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    fprintf(stderr, "program link failed\n");
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+static bool CreateContext(EGLDisplay* display) {
+  *display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (*display == EGL_NO_DISPLAY || !eglInitialize(*display, nullptr, nullptr)) {
+    fprintf(stderr, "no EGL display (try EGL_PLATFORM=surfaceless)\n");
+    return false;
+  }
+  eglBindAPI(EGL_OPENGL_ES_API);
+  const EGLint configAttribs[] = {
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
+      EGL_NONE
+  };
+  // no surface is drawn to: surfaceless platforms may offer no config at all
+  EGLConfig config = EGL_NO_CONFIG_KHR;
+  EGLint count = 0;
+  if (!eglChooseConfig(*display, configAttribs, &config, 1, &count) || !count) {
+    config = EGL_NO_CONFIG_KHR;
+  }
+  const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE };
+  EGLContext context = eglCreateContext(*display, config, EGL_NO_CONTEXT,
+                                        contextAttribs);
+  if (context == EGL_NO_CONTEXT ||
+      !eglMakeCurrent(*display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+    fprintf(stderr, "cannot make a surfaceless GLES 3 context current\n");
+    return false;
+  }
+  return true;
+}
+
+/*
+ * RenderClip()
+ *    Draws the RGBA8 image through the clip program into a same sized
+ *    renderbuffer of the given format and reads it back.
+ */
+static bool RenderClip(GLuint program, GLenum format, float encodeGamma,
+                       uint32_t width, uint32_t height,
+                       const std::vector<uint8_t>& src, std::vector<uint8_t>& dst) {
+  // a single layer array, as TextureArrayPool makes for lone images
+  GLuint tex, rbo, fbo;
+  glGenTextures(1, &tex);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, tex);
+  glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, format, width, height, 1);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, width, height, 1,
+                  GL_RGBA, GL_UNSIGNED_BYTE, src.data());
+
+  glGenRenderbuffers(1, &rbo);
+  glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+  glRenderbufferStorage(GL_RENDERBUFFER, format, width, height);
+  glGenFramebuffers(1, &fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, rbo);
+  bool status = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  if (status) {
+    // the unit quad of QuadRenderer, spread over the whole target
+    const GLfloat corners[] = { 0.0f, 0.0f,  1.0f, 0.0f,
+                                0.0f, 1.0f,  1.0f, 1.0f };
+    glViewport(0, 0, width, height);
+    glUseProgram(program);
+    // same uniforms as ImageViewEngine::DrawFrame()
+    const android::mat3& toClip =
+        android::gamutTransform(android::Gamut::DISPLAY_P3, android::Gamut::SRGB);
+    const android::mat3& fromClip =
+        android::gamutTransform(android::Gamut::SRGB, android::Gamut::DISPLAY_P3);
+    GLfloat m[9];
+    for (int c = 0; c < 3; c++) {
+      for (int r = 0; r < 3; r++) {
+        m[c * 3 + r] = toClip[c][r];
+      }
+    }
+    glUniformMatrix3fv(glGetUniformLocation(program, "toClipGamut"), 1, GL_FALSE, m);
+    for (int c = 0; c < 3; c++) {
+      for (int r = 0; r < 3; r++) {
+        m[c * 3 + r] = fromClip[c][r];
+      }
+    }
+    glUniformMatrix3fv(glGetUniformLocation(program, "fromClipGamut"), 1, GL_FALSE, m);
+    glUniform1f(glGetUniformLocation(program, "encodeGamma"), encodeGamma);
+    glUniform1i(glGetUniformLocation(program, "samplerObj"), 0);
+    glUniform1f(glGetUniformLocation(program, "textureLayer"), 0.0f);
+    glUniform4f(glGetUniformLocation(program, "screenRect"), -1.0f, -1.0f, 1.0f, 1.0f);
+    glUniform4f(glGetUniformLocation(program, "texRect"), 0.0f, 0.0f, 1.0f, 1.0f);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 2, corners);
+    glEnableVertexAttribArray(0);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    dst.resize(src.size());
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, dst.data());
+    status = glGetError() == GL_NO_ERROR;
+  } else {
+    fprintf(stderr, "incomplete framebuffer for format %#x\n", format);
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteFramebuffers(1, &fbo);
+  glDeleteRenderbuffers(1, &rbo);
+  glDeleteTextures(1, &tex);
+  return status;
+}
+
+struct DIFF_STATS {
+  uint32_t maxDiff_ = 0;
+  uint64_t sumDiff_ = 0;
+  uint64_t count_ = 0;
+  uint64_t over_ = 0;   // entries with |diff| > 1
+};
+static void AddDiff(DIFF_STATS& stats, const uint8_t* a, const uint8_t* b) {
+  uint32_t diff = 0;
+  for (int c = 0; c < 3; c++) {
+    diff = std::max(diff, static_cast<uint32_t>(std::abs(a[c] - b[c])));
+  }
+  stats.maxDiff_ = std::max(stats.maxDiff_, diff);
+  stats.sumDiff_ += diff;
+  stats.count_++;
+  stats.over_ += (diff > 1);
+}
+static void PrintDiff(const char* label, const DIFF_STATS& stats) {
+  fprintf(stdout, "  %-22s max %3u, mean %.4f, |diff| > 1: %.2f%%\n", label,
+          stats.maxDiff_, static_cast<double>(stats.sumDiff_) / stats.count_,
+          100.0 * stats.over_ / stats.count_);
+}
+
+static void Usage(const char* prog) {
+  fprintf(stderr, "Usage: %s [--step N] [--tolerance N]\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+  uint32_t step = 4;
+  uint32_t tolerance = 2;
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg == "--step" && i + 1 < argc) {
+      step = std::min(255, std::max(1, atoi(argv[++i])));
+    } else if (arg == "--tolerance" && i + 1 < argc) {
+      tolerance = std::max(0, atoi(argv[++i]));
+    } else {
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+
+  // P3 color cube, one texel per color, in rows of kRowTexels
+  const uint32_t kRowTexels = 1024;
+  std::vector<uint8_t> values;
+  for (uint32_t v = 0; v < 255; v += step) {
+    values.push_back(static_cast<uint8_t>(v));
+  }
+  values.push_back(255);
+  uint32_t axis = static_cast<uint32_t>(values.size());
+  uint32_t colors = axis * axis * axis;
+  uint32_t width = std::min(colors, kRowTexels);
+  uint32_t height = (colors + width - 1) / width;
+  std::vector<uint8_t> cube(width * height * 4, 0);
+  uint8_t* texel = cube.data();
+  for (uint32_t r = 0; r < axis; r++) {
+    for (uint32_t g = 0; g < axis; g++) {
+      for (uint32_t b = 0; b < axis; b++) {
+        texel[0] = values[r];
+        texel[1] = values[g];
+        texel[2] = values[b];
+        texel[3] = 255;
+        texel += 4;
+      }
+    }
+  }
+
+  EGLDisplay display;
+  if (!CreateContext(&display)) {
+    return 1;
+  }
+  fprintf(stdout, "GL_RENDERER: %s, %u colors\n",
+          reinterpret_cast<const char*>(glGetString(GL_RENDERER)), colors);
+  GLuint program = CreateClipProgram();
+  if (!program) {
+    return 1;
+  }
+
+  CPU_PIPELINE cpu;
+  CreateGammaDecodeTable(APP_GAMMA, cpu.decode_);
+  CreateGammaEncodeTable(1.0f / APP_GAMMA, cpu.encode_);
+  const android::mat3& toClip =
+      android::gamutTransform(android::Gamut::DISPLAY_P3, android::Gamut::SRGB);
+  const android::mat3& fromClip =
+      android::gamutTransform(android::Gamut::SRGB, android::Gamut::DISPLAY_P3);
+  cpu.toSrgb_ = ToFixedMatrix(toClip);
+  cpu.toP3_ = ToFixedMatrix(fromClip);
+
+  struct MODE {
+    const char* name_;
+    GLenum format_;
+    float encodeGamma_;
+  } modes[] = {
+      { "sRGB framebuffer", GL_SRGB8_ALPHA8, 0.0f },
+      { "P3 passthrough", GL_RGBA8, 1.0f / APP_GAMMA },
+  };
+
+  bool pass = true;
+  for (const MODE& mode : modes) {
+    std::vector<uint8_t> gpu;
+    if (!RenderClip(program, mode.format_, mode.encodeGamma_,
+                    width, height, cube, gpu)) {
+      fprintf(stderr, "%s: rendering failed\n", mode.name_);
+      return 1;
+    }
+    bool hardwareEotf = (mode.encodeGamma_ == 0.0f);
+    DIFF_STATS vsCpu, vsModel;
+    uint64_t unstable = 0;
+    for (size_t idx = 0; idx < colors * 4; idx += 4) {
+      uint8_t srgb[3], cpuClip[3], model[3];
+      Transform8(cpu, cpu.toSrgb_, &cube[idx], srgb);
+      Transform8(cpu, cpu.toP3_, srgb, cpuClip);
+      AddDiff(vsCpu, &gpu[idx], cpuClip);
+      if (ShaderModel(toClip, fromClip, hardwareEotf, &cube[idx], model)) {
+        AddDiff(vsModel, &gpu[idx], model);
+      } else {
+        unstable++;
+      }
+    }
+    fprintf(stdout, "%s:\n", mode.name_);
+    PrintDiff("vs 8-bit CPU path", vsCpu);
+    PrintDiff("vs float shader model", vsModel);
+    if (unstable) {
+      fprintf(stdout, "  (%llu colors at the curve discontinuity not compared)\n",
+              static_cast<unsigned long long>(unstable));
+    }
+    pass = pass && vsModel.maxDiff_ <= tolerance;
+  }
+
+  glDeleteProgram(program);
+  eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  eglTerminate(display);
+  fprintf(stdout, pass ? "PASS\n" : "FAIL\n");
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,389 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * gamut-lut-gen: host tool generating the full 256x256x256 8-bit mapping
+ * between sRGB and Display P3 with the same fixed-point pipeline the app
+ * uses (8-bit gamma decode table, 10-bit fixed-point matrix, 8-bit gamma
+ * encode table), optionally diffing it against a float reference computed
+ * with android::ColorSpaceConnector.
+ *
+ * This used to run (and LOGD every entry) inside CreateWideColorCtx().
+ *
+ * Usage:
+ *   gamut-lut-gen [--p3-to-srgb] [--threads N] [--bin FILE] [--csv FILE]
+ *                 [--diff]
+ *
+ * Binary file layout (little endian):
+ *   LUT_FILE_HEADER, then size_^3 RGB triplets of uint8_t, indexed by
+ *   (r * size_ + g) * size_ + b.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ColorSpaceMatrices.h"
+
+#define LUT_SIZE     256
+#define LUT_ENTRIES  (LUT_SIZE * LUT_SIZE * LUT_SIZE)
+#define CLIP_COLOR(color, max) ((color > max) ? max : ((color > 0) ? color : 0))
+
+enum LUT_DIRECTION {
+  SRGB_TO_P3 = 0,
+  P3_TO_SRGB,
+  DIRECTION_COUNT
+};
+
+#pragma pack(push, 1)
+struct LUT_FILE_HEADER {
+  char     magic_[4];     // "GLUT"
+  uint32_t version_;      // LUT_FILE_VERSION
+  uint32_t direction_;    // LUT_DIRECTION
+  uint32_t size_;         // entries per axis
+};
+#pragma pack(pop)
+#define LUT_FILE_VERSION 1
+
+/*
+ * CreateGammaEncodeTable():
+ *     sRGB =
+ *        12.92 * LinearRGB            0 < LinearRGB < 0.0031308
+ *        1.055 * power(LinearRGB, gamma)-0.055 0.0031308 <= LinarRGB <= 1.0f
+ */
+static void CreateGammaEncodeTable(float gamma, std::vector<uint8_t>& table) {
+  assert(gamma < 1.0f);
+  uint32_t maxPixeli = ( 1<<8 ) - 1;
+  float maxPixelf = static_cast<float>(maxPixeli);
+
+  uint32_t maxLinearVal = static_cast<uint32_t>(0.0031308f * maxPixeli);
+
+  table.resize(0);
+  for(uint32_t idx = 0; idx < maxLinearVal; idx++) {
+    double val = idx * 12.92 + .5f;
+    table.push_back(static_cast<uint8_t>(val));
+  }
+
+  for (uint32_t idx = maxLinearVal; idx <= maxPixeli; idx++) {
+    double val = (1.055f * pow(idx / maxPixelf, gamma) - 0.055f);
+    val = val * maxPixeli + 0.5f;
+    table.push_back(static_cast<uint8_t>(CLIP_COLOR(val, maxPixelf)));
+  }
+}
+
+/*
+ * CreateGammaDecodeTable()
+ *    Retrieve linear RGB data
+ *    Linear =  sRGB / 12.92    0 <= sRGB < 0.04045
+ *              pow((sRGB + 0.055)/1.055, gamma)
+ */
+static void CreateGammaDecodeTable(float gamma, std::vector<uint8_t>&table) {
+  assert(gamma > 1.0f);
+  uint32_t maxPixeli = ( 1<<8 ) - 1;
+  float maxPixelf = static_cast<float>(maxPixeli);
+
+  uint32_t maxLinearVal = static_cast<uint32_t>(0.04045 * maxPixeli);
+  table.resize(0);
+  for(uint32_t idx = 0; idx < maxLinearVal; idx++) {
+    double val = idx / 12.92 + .5f;
+    table.push_back(static_cast<uint8_t>(val));
+  }
+
+  for (uint32_t idx = maxLinearVal; idx <= maxPixeli; idx++) {
+    double val;
+    val = (idx / maxPixelf + 0.055f) / 1.055f;
+    val = pow(val, gamma) * maxPixeli + 0.5f;
+    table.push_back(static_cast<uint8_t>(CLIP_COLOR(val, maxPixelf)));
+  }
+}
+
+/*
+ * Fixed point (10 bit fraction) version of a 3x3 matrix, rounded the same
+ * way as TransformR8G8B8A8() in ColorSpaceTransform.cpp
+ */
+struct FIXED_MATRIX {
+  int32_t m_[3][3];   // [row][col]
+};
+static FIXED_MATRIX ToFixedMatrix(const android::mat3& matrix) {
+  FIXED_MATRIX fixed;
+  for (int r = 0; r < 3; r++) {
+    for (int c = 0; c < 3; c++) {
+      fixed.m_[r][c] = static_cast<int32_t>(matrix[c][r] * 1024 + 0.5f);
+    }
+  }
+  return fixed;
+}
+
+struct LUT_CONFIG {
+  LUT_DIRECTION direction_;
+  std::vector<uint8_t> decode_;
+  std::vector<uint8_t> encode_;
+  FIXED_MATRIX matrix_;
+};
+
+/*
+ * Float reference of the app pipeline: same primaries and curves, no
+ * intermediate 8-bit quantization.
+ *   decode: x < 0.04045 ? x / 12.92 : ((x + 0.055) / 1.055) ^ 2.2
+ *   encode: 1.055 * x ^ (1 / 2.2) - 0.055
+ */
+static android::ColorSpace ReferenceSpace(android::Gamut gamut, bool source) {
+  const android::GamutPrimaries& p =
+      android::kGamutPrimaries[static_cast<size_t>(gamut)];
+  android::ColorSpace::TransferParameters params {
+      2.2f, 1 / 1.055f, 0.055f / 1.055f, 1 / 12.92f,
+      source ? 0.04045f : 0.0f, 0.0f, 0.0f
+  };
+  return android::ColorSpace(source ? "app decode" : "app encode",
+                             p.primaries, p.whitePoint, params);
+}
+
+struct DIFF_STATS {
+  uint32_t maxDiff_ = 0;
+  uint64_t sumDiff_ = 0;
+  uint64_t histogram_[LUT_SIZE] = {0,};   // entries per max channel |diff|
+};
+
+/*
+ * GenerateSlice()
+ *    Fills entries for red values [rBegin, rEnd) and, when requested,
+ *    diffs them against the float reference.
+ */
+static void GenerateSlice(const LUT_CONFIG& cfg,
+                          const android::ColorSpaceConnector* reference,
+                          uint32_t rBegin, uint32_t rEnd,
+                          uint8_t* lut, DIFF_STATS* stats) {
+  const auto& m = cfg.matrix_.m_;
+  for (uint32_t r = rBegin; r < rEnd; r++) {
+    for (uint32_t g = 0; g < LUT_SIZE; g++) {
+      uint8_t* dst = lut + ((r * LUT_SIZE + g) * LUT_SIZE) * 3;
+      int32_t lr = cfg.decode_[r];
+      int32_t lg = cfg.decode_[g];
+      for (uint32_t b = 0; b < LUT_SIZE; b++) {
+        int32_t lb = cfg.decode_[b];
+        int32_t x = (m[0][0] * lr + m[0][1] * lg + m[0][2] * lb + 512) >> 10;
+        int32_t y = (m[1][0] * lr + m[1][1] * lg + m[1][2] * lb + 512) >> 10;
+        int32_t z = (m[2][0] * lr + m[2][1] * lg + m[2][2] * lb + 512) >> 10;
+        *dst++ = cfg.encode_[CLIP_COLOR(x, 255)];
+        *dst++ = cfg.encode_[CLIP_COLOR(y, 255)];
+        *dst++ = cfg.encode_[CLIP_COLOR(z, 255)];
+      }
+    }
+  }
+
+  if (!reference) {
+    return;
+  }
+
+  // One row of LUT_SIZE blue values at a time through the batch API
+  float rf[LUT_SIZE], gf[LUT_SIZE], bf[LUT_SIZE];
+  for (uint32_t r = rBegin; r < rEnd; r++) {
+    for (uint32_t g = 0; g < LUT_SIZE; g++) {
+      for (uint32_t b = 0; b < LUT_SIZE; b++) {
+        rf[b] = r / 255.0f;
+        gf[b] = g / 255.0f;
+        bf[b] = b / 255.0f;
+      }
+      reference->transform(rf, gf, bf, rf, gf, bf, LUT_SIZE);
+
+      const uint8_t* lutRow = lut + ((r * LUT_SIZE + g) * LUT_SIZE) * 3;
+      for (uint32_t b = 0; b < LUT_SIZE; b++) {
+        int32_t ref[3] = {
+            static_cast<int32_t>(rf[b] * 255.0f + 0.5f),
+            static_cast<int32_t>(gf[b] * 255.0f + 0.5f),
+            static_cast<int32_t>(bf[b] * 255.0f + 0.5f),
+        };
+        uint32_t diff = 0;
+        for (int c = 0; c < 3; c++) {
+          diff = std::max(diff, static_cast<uint32_t>(
+              std::abs(ref[c] - static_cast<int32_t>(lutRow[b * 3 + c]))));
+        }
+        stats->maxDiff_ = std::max(stats->maxDiff_, diff);
+        stats->sumDiff_ += diff;
+        stats->histogram_[diff]++;
+      }
+    }
+  }
+}
+
+static bool WriteBinary(const char* name, LUT_DIRECTION direction,
+                        const std::vector<uint8_t>& lut) {
+  FILE* fp = fopen(name, "wb");
+  if (!fp) {
+    fprintf(stderr, "Cannot open %s\n", name);
+    return false;
+  }
+  LUT_FILE_HEADER header;
+  memcpy(header.magic_, "GLUT", 4);
+  header.version_ = LUT_FILE_VERSION;
+  header.direction_ = direction;
+  header.size_ = LUT_SIZE;
+  bool status = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+                fwrite(lut.data(), 1, lut.size(), fp) == lut.size();
+  fclose(fp);
+  return status;
+}
+
+/*
+ * WriteCsv()
+ *    Text is formatted per red slice on worker threads, then written in order.
+ */
+static bool WriteCsv(const char* name, LUT_DIRECTION direction,
+                     const std::vector<uint8_t>& lut, uint32_t threadCount) {
+  FILE* fp = fopen(name, "w");
+  if (!fp) {
+    fprintf(stderr, "Cannot open %s\n", name);
+    return false;
+  }
+  fprintf(fp, direction == SRGB_TO_P3 ? "sR,sG,sB,pR,pG,pB\n"
+                                      : "pR,pG,pB,sR,sG,sB\n");
+  std::vector<std::string> text(LUT_SIZE);
+  for (uint32_t rBase = 0; rBase < LUT_SIZE; rBase += threadCount) {
+    std::vector<std::thread> workers;
+    for (uint32_t r = rBase; r < std::min(rBase + threadCount, (uint32_t)LUT_SIZE); r++) {
+      workers.emplace_back([&lut, &text, r]() {
+        std::string& out = text[r];
+        out.reserve(LUT_SIZE * LUT_SIZE * 24);
+        char line[32];
+        for (uint32_t g = 0; g < LUT_SIZE; g++) {
+          for (uint32_t b = 0; b < LUT_SIZE; b++) {
+            const uint8_t* v = &lut[((r * LUT_SIZE + g) * LUT_SIZE + b) * 3];
+            int len = snprintf(line, sizeof(line), "%u,%u,%u,%u,%u,%u\n",
+                               r, g, b, v[0], v[1], v[2]);
+            out.append(line, len);
+          }
+        }
+      });
+    }
+    for (auto& w : workers) {
+      w.join();
+    }
+    for (uint32_t r = rBase; r < std::min(rBase + threadCount, (uint32_t)LUT_SIZE); r++) {
+      fwrite(text[r].data(), 1, text[r].size(), fp);
+      std::string().swap(text[r]);
+    }
+  }
+  return fclose(fp) == 0;
+}
+
+static void Usage(const char* prog) {
+  fprintf(stderr,
+          "Usage: %s [--p3-to-srgb] [--threads N] [--bin FILE] [--csv FILE] [--diff]\n"
+          "  default direction is sRGB -> Display P3\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+  LUT_DIRECTION direction = SRGB_TO_P3;
+  uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+  const char* binName = nullptr;
+  const char* csvName = nullptr;
+  bool diff = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg == "--p3-to-srgb") {
+      direction = P3_TO_SRGB;
+    } else if (arg == "--threads" && i + 1 < argc) {
+      threadCount = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--bin" && i + 1 < argc) {
+      binName = argv[++i];
+    } else if (arg == "--csv" && i + 1 < argc) {
+      csvName = argv[++i];
+    } else if (arg == "--diff") {
+      diff = true;
+    } else {
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+  threadCount = std::min(threadCount, static_cast<uint32_t>(LUT_SIZE));
+
+  using android::Gamut;
+  Gamut srcGamut = (direction == SRGB_TO_P3) ? Gamut::SRGB : Gamut::DISPLAY_P3;
+  Gamut dstGamut = (direction == SRGB_TO_P3) ? Gamut::DISPLAY_P3 : Gamut::SRGB;
+
+  auto start = std::chrono::steady_clock::now();
+
+  LUT_CONFIG cfg;
+  cfg.direction_ = direction;
+  CreateGammaDecodeTable(2.2f, cfg.decode_);
+  CreateGammaEncodeTable(1.0f / 2.2f, cfg.encode_);
+  cfg.matrix_ = ToFixedMatrix(android::gamutTransform(srcGamut, dstGamut));
+
+  std::unique_ptr<android::ColorSpaceConnector> reference;
+  if (diff) {
+    reference.reset(new android::ColorSpaceConnector(
+        ReferenceSpace(srcGamut, true), ReferenceSpace(dstGamut, false)));
+  }
+
+  std::vector<uint8_t> lut(LUT_ENTRIES * 3);
+  std::vector<DIFF_STATS> stats(threadCount);
+  std::vector<std::thread> workers;
+  uint32_t sliceSize = (LUT_SIZE + threadCount - 1) / threadCount;
+  for (uint32_t t = 0; t < threadCount; t++) {
+    uint32_t rBegin = t * sliceSize;
+    uint32_t rEnd = std::min(rBegin + sliceSize, (uint32_t)LUT_SIZE);
+    workers.emplace_back(GenerateSlice, std::cref(cfg), reference.get(),
+                         rBegin, rEnd, lut.data(), &stats[t]);
+  }
+  for (auto& w : workers) {
+    w.join();
+  }
+
+  auto generated = std::chrono::steady_clock::now();
+  fprintf(stdout, "%s: %u entries with %u threads in %.1f ms\n",
+          direction == SRGB_TO_P3 ? "sRGB -> P3" : "P3 -> sRGB",
+          LUT_ENTRIES, threadCount,
+          std::chrono::duration<double, std::milli>(generated - start).count());
+
+  if (diff) {
+    DIFF_STATS total;
+    for (auto& s : stats) {
+      total.maxDiff_ = std::max(total.maxDiff_, s.maxDiff_);
+      total.sumDiff_ += s.sumDiff_;
+      for (uint32_t i = 0; i < LUT_SIZE; i++) {
+        total.histogram_[i] += s.histogram_[i];
+      }
+    }
+    fprintf(stdout, "diff vs float reference: max %u, mean %.4f, exact %.2f%%\n",
+            total.maxDiff_, static_cast<double>(total.sumDiff_) / LUT_ENTRIES,
+            100.0 * total.histogram_[0] / LUT_ENTRIES);
+    for (uint32_t i = 1; i <= total.maxDiff_; i++) {
+      if (total.histogram_[i]) {
+        fprintf(stdout, "  |diff| == %3u: %llu\n", i,
+                static_cast<unsigned long long>(total.histogram_[i]));
+      }
+    }
+  }
+
+  if (binName && !WriteBinary(binName, direction, lut)) {
+    return 1;
+  }
+  if (csvName && !WriteCsv(csvName, direction, lut, threadCount)) {
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Counts the GL calls a draw-bench frame makes: force included (-include)
+ * in every source of draw-bench, app sources included, so each call below
+ * bumps gGlCallCount on its way to GL. Covers what drawing a frame calls;
+ * setup calls are not counted.
+ */
+#ifndef __GL_CALL_COUNT_H__
+#define __GL_CALL_COUNT_H__
+
+#include <cstdint>
+#include <GLES3/gl32.h>
+
+extern uint64_t gGlCallCount;
+
+#define GL_COUNTED(call) (++gGlCallCount, call)
+
+#define glActiveTexture(...) GL_COUNTED(glActiveTexture(__VA_ARGS__))
+#define glBindBuffer(...) GL_COUNTED(glBindBuffer(__VA_ARGS__))
+#define glBindTexture(...) GL_COUNTED(glBindTexture(__VA_ARGS__))
+#define glBindVertexArray(...) GL_COUNTED(glBindVertexArray(__VA_ARGS__))
+#define glClear(...) GL_COUNTED(glClear(__VA_ARGS__))
+#define glClearColor(...) GL_COUNTED(glClearColor(__VA_ARGS__))
+#define glDrawArrays(...) GL_COUNTED(glDrawArrays(__VA_ARGS__))
+#define glEnableVertexAttribArray(...) \
+    GL_COUNTED(glEnableVertexAttribArray(__VA_ARGS__))
+#define glGetUniformLocation(...) GL_COUNTED(glGetUniformLocation(__VA_ARGS__))
+#define glUniform1f(...) GL_COUNTED(glUniform1f(__VA_ARGS__))
+#define glUniform1i(...) GL_COUNTED(glUniform1i(__VA_ARGS__))
+#define glUniform4fv(...) GL_COUNTED(glUniform4fv(__VA_ARGS__))
+#define glUniformMatrix3fv(...) GL_COUNTED(glUniformMatrix3fv(__VA_ARGS__))
+#define glUseProgram(...) GL_COUNTED(glUseProgram(__VA_ARGS__))
+#define glVertexAttribPointer(...) GL_COUNTED(glVertexAttribPointer(__VA_ARGS__))
+
+#endif // __GL_CALL_COUNT_H__
@@ -50,6 +50,8 @@ public class WideColorActivity extends NativeActivity {
     volatile PopupWindow _popupWindow;
     volatile boolean _dismissPending;
     Handler _handler;
+    TextView _memoryStats;
+    PopupWindow _memoryWindow;
 
     @Override
     protected void onCreate(Bundle savedInstanceState) {
@@ -72,6 +74,7 @@ public class WideColorActivity extends NativeActivity {
         _p3Image = (TextView)_popupView.findViewById(R.id.textViewP3);
         _sRGBImage = (TextView)_popupView.findViewById(R.id.textViewSRGB);
         _fileName = (TextView)_popupView.findViewById(R.id.textViewWelcome);
+        _memoryStats = (TextView)layoutInflater.inflate(R.layout.memory_overlay, null);
 
         _mainLayout = new LinearLayout(this);
         MarginLayoutParams params = new MarginLayoutParams(LayoutParams.MATCH_PARENT,
@@ -95,6 +98,22 @@ public class WideColorActivity extends NativeActivity {
         super.onPause();
     }
 
+    /**
+     * Native side releases its caches by level, see TrimMemoryPressure().
+     * The native method is registered once the native thread has started.
+     */
+    @Override
+    public void onTrimMemory(int level) {
+        super.onTrimMemory(level);
+        try {
+            nativeTrimMemory(level);
+        } catch (UnsatisfiedLinkError e) {
+            // too early, APP_CMD_LOW_MEMORY still covers the worst case
+        }
+    }
+
+    private native void nativeTrimMemory(int level);
+
     // Our popup window, you will call it from your C/C++ code later
     @TargetApi(26)
     void setImmersiveSticky() {
@@ -192,6 +211,34 @@ public class WideColorActivity extends NativeActivity {
         }});
     }
 
+    /**
+     * Debug overlay with the native memory statistics, in the top left
+     * corner until hidden.
+     * @param stats is the text to display, null hides the overlay
+     */
+    public void ShowMemoryStats(final String stats) {
+        this.runOnUiThread(new Runnable()  {
+            @Override
+            public void run() {
+                if (stats == null) {
+                    if (_memoryWindow != null) {
+                        _memoryWindow.dismiss();
+                        _memoryWindow = null;
+                    }
+                    return;
+                }
+                _memoryStats.setText(stats);
+                if (_memoryWindow == null) {
+                    _memoryWindow = new PopupWindow(
+                            _memoryStats,
+                            LayoutParams.WRAP_CONTENT,
+                            LayoutParams.WRAP_CONTENT);
+                    _memoryWindow.showAtLocation(_mainLayout, Gravity.TOP | Gravity.START, 0, 0);
+                }
+                _memoryWindow.update(LayoutParams.WRAP_CONTENT, LayoutParams.WRAP_CONTENT);
+            }});
+    }
+
     public int GetRotation() {
         int rotation = ((WindowManager) getSystemService(Context.WINDOW_SERVICE))
                 .getDefaultDisplay()